@@ -127,6 +127,24 @@ void Actuator::setI(float I) {
 	}
 }
 
+void Actuator::setV(float V) {
+	if (configData)
+		if (configData->actuatorType == STEPPER_ENCODER_TYPE)
+			configData->config.stepperArm.stepper.kV = V;
+}
+
+void Actuator::setA(float A) {
+	if (configData)
+		if (configData->actuatorType == STEPPER_ENCODER_TYPE)
+			configData->config.stepperArm.stepper.kA = A;
+}
+
+void Actuator::setDFilter(float filter) {
+	if (configData)
+		if (configData->actuatorType == STEPPER_ENCODER_TYPE)
+			configData->config.stepperArm.stepper.dFilter = filter;
+}
+
 void Actuator::setMaxSpeed(float maxSpeed) {
 	if (configData)
 		if (configData->actuatorType == STEPPER_ENCODER_TYPE) 
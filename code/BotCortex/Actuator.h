@@ -40,6 +40,12 @@ class Actuator
 		void changeAngle(float angle,uint32_t pDuration_ms) {
 			drive()->changeAngle(angle,pDuration_ms);
 		};
+		bool queueAngle(float angle,uint32_t pDuration_ms) {
+			return drive()->queueAngle(angle,pDuration_ms);
+		};
+		AngleMovementQueue<MOVEMENT_QUEUE_SIZE>& getMovement() {
+			return drive()->movement;
+		}
 		float getCurrentAngle() {
 			return drive()->getCurrentAngle();
 		}
@@ -69,6 +75,9 @@ class Actuator
 		void setD(float D);
 		void setP(float P);
 		void setI(float I);
+		void setV(float V);
+		void setA(float A);
+		void setDFilter(float filter);
 
 		void setMaxSpeed(float maxSpeed);
 		void setMaxAcc(float maxAcc);
@@ -38,6 +38,9 @@ void ActuatorConfig::setDefaults() {
 	wrist.config.stepperArm.stepper.kP= 0.55;
 	wrist.config.stepperArm.stepper.kD= 0.0;
 	wrist.config.stepperArm.stepper.kI= 0.0;
+	wrist.config.stepperArm.stepper.kV= 1.0;
+	wrist.config.stepperArm.stepper.kA= 1.0;
+	wrist.config.stepperArm.stepper.dFilter= 0.5;
 	wrist.config.stepperArm.stepper.sampleRate= 20;
 	wrist.config.stepperArm.stepper.microSteps = 8;
 	
@@ -55,6 +58,9 @@ void ActuatorConfig::setDefaults() {
 	ellbow.config.stepperArm.stepper.kP= 0.50;
 	ellbow.config.stepperArm.stepper.kD= 0.0;
 	ellbow.config.stepperArm.stepper.kI= 0.0;
+	ellbow.config.stepperArm.stepper.kV= 1.0;
+	ellbow.config.stepperArm.stepper.kA= 1.0;
+	ellbow.config.stepperArm.stepper.dFilter= 0.5;
 	ellbow.config.stepperArm.stepper.sampleRate= 20;
 	ellbow.config.stepperArm.stepper.microSteps = 4;
 	
@@ -72,6 +78,9 @@ void ActuatorConfig::setDefaults() {
 	forearm.config.stepperArm.stepper.kP= 0.3;
 	forearm.config.stepperArm.stepper.kD= 0.000;
 	forearm.config.stepperArm.stepper.kI= 0.0;
+	forearm.config.stepperArm.stepper.kV= 1.0;
+	forearm.config.stepperArm.stepper.kA= 1.0;
+	forearm.config.stepperArm.stepper.dFilter= 0.5;
 	forearm.config.stepperArm.stepper.sampleRate= 20;
 	forearm.config.stepperArm.stepper.microSteps = 8;
 
@@ -90,6 +99,9 @@ void ActuatorConfig::setDefaults() {
 	upperarm.config.stepperArm.stepper.kP= 0.5;
 	upperarm.config.stepperArm.stepper.kD= 0.000;
 	upperarm.config.stepperArm.stepper.kI= 0.0;
+	upperarm.config.stepperArm.stepper.kV= 1.0;
+	upperarm.config.stepperArm.stepper.kA= 1.0;
+	upperarm.config.stepperArm.stepper.dFilter= 0.5;
 	upperarm.config.stepperArm.stepper.sampleRate= 20;
 	upperarm.config.stepperArm.stepper.microSteps = 8;
 
@@ -107,6 +119,9 @@ void ActuatorConfig::setDefaults() {
 	hip.config.stepperArm.stepper.kP= 0.4;
 	hip.config.stepperArm.stepper.kD= 0.0;
 	hip.config.stepperArm.stepper.kI= 0.0;
+	hip.config.stepperArm.stepper.kV= 1.0;
+	hip.config.stepperArm.stepper.kA= 1.0;
+	hip.config.stepperArm.stepper.dFilter= 0.5;
 	hip.config.stepperArm.stepper.sampleRate= 20;
 	hip.config.stepperArm.stepper.microSteps = 8;
 }
@@ -182,6 +197,12 @@ void StepperConfig::print() {
 	logger->print(",");
 	logger->print(kD,2);
 	logger->print(")");
+	logger->print(F(" FF("));
+	logger->print(kV,2);
+	logger->print(",");
+	logger->print(kA,2);
+	logger->print(F(") DFilter="));
+	logger->print(dFilter,2);
 
 	logger->print(F(" maxSpeed="));
 	logger->print(maxSpeed,2);
@@ -21,16 +21,28 @@
 
 #define HERKULEX_BAUD_RATE 115200			// baud rate for connection to herkulex servos
 #define PRINTER_BAUD_RATE 9600				// baud rate for Adafruit Thermal Printer
+#define COMMAND_RX_BUFFER_SIZE 512			// [bytes] added to the receive buffer of the command UART, which is filled by the UART interrupt while the loop is busy
+#define LOGGER_TX_BUFFER_SIZE 256			// [bytes] added to the transmit buffer of the log UART, holds a telemetry frame plus a log line, so writing them does not wait for the UART
 
 #define MOTOR_KNOB_SAMPLE_RATE (56)		// every [ms] the potentiometer is sampled
 
 #define SERVO_SAMPLE_RATE  56				// every [ms] the motors get a new position. 11.2ms is the unit Herkulex servos are working with, sample rate should be a multiple of that
 #define SERVO_MOVE_DURATION 12				// herkulex servos have their own PID controller, so we need to add some time to a sample to make the movement smooth.
 #define PIBOT_PULSE_WIDTH_US 2				// pulse width of one step which can be recognized by PiBot Driver (I tried this out)
+#ifndef STEPPER_ISR_TICK_US
+#define STEPPER_ISR_TICK_US 20				// [us] tick of the timer interrupt generating the step impulses, max step rate is half the tick frequency. 0 generates the impulses in the main loop
+#endif
+#ifndef STEPPER_FIXED_POINT
+#define STEPPER_FIXED_POINT 0				// 1 computes the steppers' PI controller and trajectory in Q16.16 instead of float, for CPUs without FPU. Requires the step generator
+#endif
+#if STEPPER_FIXED_POINT && (STEPPER_ISR_TICK_US == 0)
+#error "STEPPER_FIXED_POINT requires STEPPER_ISR_TICK_US > 0"
+#endif
 
 #define I2C_BUS_RATE I2C_RATE_300			// frequency of i2c bus (1MHz KHz)
 #define I2C_BUS_TYPE I2C_OP_MODE_ISR		// I2C library is using interrupts
-#define ENCODER_FILTER_RESPONSE_TIME 5		// complementary filter of rotary encoder has this response time in [ms]
+#define ENCODER_ESTIMATOR_ALPHA 0.5			// weight of the encoder's angle against the angle predicted by the counted steps
+#define ENCODER_ESTIMATOR_BETA 0.1			// weight of the encoder's angle when estimating the difference of commanded and real speed
 
 #define HAND_HERKULEX_MOTOR_ID    0xFD		// this is the HERKULEX_BROADCAST_ID used for all servos
 #define GRIPPER_HERKULEX_MOTOR_ID 0xFC		// this ID has been programmed into the gripper servo explicitly
@@ -137,6 +149,9 @@ struct StepperConfig {
 	float kP;				// PID controller
 	float kD;				// PID controller
 	float kI;				// PID controller
+	float kV;				// feed-forward of the trajectory's speed, 1.0 = full speed
+	float kA;				// feed-forward of the trajectory's acceleration, 1.0 = full acceleration
+	float dFilter;			// low pass of the D term, weight of the latest error derivative (1.0 = not filtered)
 	float maxAcc;			// maximum acceleration in rpm/s
 	float maxSpeed;			// maximum speed in rpm
 	int   sampleRate;		// current sample rate of closed-loop
@@ -11,11 +11,13 @@
 #include "Controller.h"
 #include <I2CPortScanner.h>
 #include "GearedStepperDrive.h"
+#include "StepGenerator.h"
 #include "RotaryEncoder.h"
 #include "watchdog.h"
 #include "core.h"
 #include "limits.h"
 #include "LightsController.h"
+#include "Profiler.h"
 
 Controller controller;
 TimePassedBy servoLoopTimer;
@@ -41,6 +43,10 @@ Controller::Controller()
 	numberOfSteppers = 0;				// number of steppers that have been initialized
 	setuped= false;						// flag to indicate a finished setup (used in stepperloop())
 	enabled = false;					// motors are disabled until explicitly enabled
+	for (int i = 0;i<MAX_ENCODERS;i++)
+		encoderDue[i] = false;
+	encoderOnBus[0] = -1;				// no encoder is read currently
+	encoderOnBus[1] = -1;
 }
 
 void Controller::enable() {
@@ -154,6 +160,10 @@ bool Controller::setup(bool force /* =false */) {
 	numberOfSteppers = 0;
 	numberOfEncoders = 0;
 	numberOfServos = 0;
+	for (int i = 0;i<MAX_ENCODERS;i++)
+		encoderDue[i] = false;
+	encoderOnBus[0] = -1;
+	encoderOnBus[1] = -1;
 
 	if (memory.persMem.logSetup) {
 		logger->println(F("--- I2C initialization"));
@@ -367,6 +377,7 @@ void Controller::switchServoPowerSupply(bool on) {
 
 
 void Controller::stepperLoop() {
+	ProfileScope scope(PROFILE_STEPPER);
 	if (isSetup()) {
 		for (int currentStepper = 0;currentStepper<numberOfSteppers;currentStepper++)
 			steppers[currentStepper].loop();
@@ -412,14 +423,41 @@ void Controller::loop(uint32_t now) {
 		}
 	};
 
-	// update the servo position
+	// update the servo position, all servos move with one packet
 	if (servoLoopTimer.isDue_ms(SERVO_SAMPLE_RATE,now)) {
-		servos[0].loop(millis());
-		stepperLoop(); // meanwhile, send impulses to steppers
-		servos[1].loop(millis());
+		ProfileScope scope(PROFILE_SERVO);
+		for (int i = 0;i<numberOfServos;i++)
+			servos[i].loop(millis());
+		HerkulexServoDrive::sendMoves(SERVO_SAMPLE_RATE + SERVO_MOVE_DURATION);
+		for (int i = 0;i<numberOfServos;i++)
+			servos[i].requestFeedback();
 	}
 
 	// fetch the angles from the encoders and tell the stepper controller
+	{
+		ProfileScope scope(PROFILE_ENCODER);
+		sampleEncoders(now);
+	}
+
+	if (memory.persMem.logEncoder)
+		logAngles();
+}
+
+// give the stepper of that encoder the angle that has been read
+void Controller::setMeasuredAngle(uint8_t encoderIdx, bool angleFromEncoderIsOk) {
+	GearedStepperDrive& stepper = getActuator(encoders[encoderIdx].getConfig().id)->getStepper();
+	if (angleFromEncoderIsOk) {
+		float currentAngle = encoders[encoderIdx].getAngle();
+		stepper.setMeasuredAngle(currentAngle,millis());		// set current angle and adapt speed
+	} else {
+		float currentAngle = stepper.getCurrentAngle();
+		stepper.setMeasuredAngle(currentAngle,millis());		// set current angle and adapt speed
+	}
+	stepperLoop(); 											// send impulses to steppers immediately in case a correction has to happen
+}
+
+void Controller::sampleEncoders(uint32_t now) {
+	// mark the encoders whose stepper is due
 	for (int encoderIdx = 0;encoderIdx<numberOfEncoders;encoderIdx++) {
 		// find corresponding actuator of this encoder
 		ActuatorIdentifier actuatorID = encoders[encoderIdx].getConfig().id;
@@ -434,26 +472,43 @@ void Controller::loop(uint32_t now) {
 					logger->print(stepper.getConfig().id);
 					logFatal(F("wrong stepper identified"));
 				}
-				bool angleFromEncoderIsOk = false;
+				encoderDue[encoderIdx] = true;
+			}
+		}
+	}
+
+	// each bus reads one encoder at a time, both buses work in parallel
+	bool busy = false;
+	for (int bus = 0;bus<2;bus++) {
+		int8_t encoderIdx = encoderOnBus[bus];
+		if (encoderIdx >= 0) {
+			if (!encoders[encoderIdx].isReadingDone()) {
+				busy = true;
+				continue;
+			}
+			encoderOnBus[bus] = -1;
+			setMeasuredAngle(encoderIdx, encoders[encoderIdx].finishReading());
+		}
+
+		// kick off the next due encoder of this bus
+		for (encoderIdx = 0;encoderIdx<numberOfEncoders;encoderIdx++) {
+			if (encoderDue[encoderIdx] && (encoders[encoderIdx].i2CBusNo() == bus)) {
+				encoderDue[encoderIdx] = false;
 				if (encoders[encoderIdx].isOk()) {
-					// encoders needs some delay between being asked, otherwise
-					// many communication failure happen
-					angleFromEncoderIsOk = encoders[encoderIdx].readNewAngleFromSensor(); // measure the encoder's angle
-				}
-				if (angleFromEncoderIsOk) {
-					float currentAngle = encoders[encoderIdx].getAngle();
-					stepper.setMeasuredAngle(currentAngle,now);		// set current angle and adapt speed
-				} else {
-					float currentAngle = stepper.getCurrentAngle();
-					stepper.setMeasuredAngle(currentAngle,now);		// set current angle and adapt speed
+					encoders[encoderIdx].startReading();
+					encoderOnBus[bus] = encoderIdx;
+					busy = true;
+					break;
 				}
-				stepperLoop(); 									// send impulses to steppers immediately in case a correction has to happen
+				// encoder does not work, the stepper goes on with the angle it computed by itself
+				setMeasuredAngle(encoderIdx, false);
 			}
 		}
 	}
 
-	if (memory.persMem.logEncoder)
-		logAngles();
+	// segments planned by the steppers start with the same tick, once all due encoders are read
+	if (!busy)
+		stepGenerator.start();
 }
 
 void Controller::logAngles() {
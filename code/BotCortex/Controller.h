@@ -64,6 +64,10 @@ class Controller {
 		void switchServoPowerSupply(bool on);
 
 	private:
+		// read the encoders of due steppers, both i2c buses in parallel without waiting
+		void sampleEncoders(uint32_t now);
+		void setMeasuredAngle(uint8_t encoderIdx, bool angleFromEncoderIsOk);
+
 		HerkulexServoDrive	servos[MAX_SERVOS];
 		GearedStepperDrive	steppers[MAX_STEPPERS];
 		RotaryEncoder		encoders[MAX_ENCODERS];
@@ -74,6 +78,9 @@ class Controller {
 		uint8_t numberOfSteppers;  // number of steppers that have been setup successfully
 		uint8_t numberOfServos;	   // number of servos that have been setup successfully
 
+		bool encoderDue[MAX_ENCODERS];		// stepper of this encoder needs a new angle
+		int8_t encoderOnBus[2];				// encoder whose angle is read on that i2c bus, -1 if bus is free
+
 		Actuator* currentMotor;				// currently set motor used for interaction
 		TimePassedBy manualControlTimer;	// used for measuring sample rate of manual motor control by knob
 		bool setuped = false;
@@ -47,7 +47,13 @@ void GearedStepperDrive::setup(	StepperConfig* pConfigData, ActuatorConfiguratio
 	pinMode(getPinClock(), OUTPUT);
 	pinMode(getPinDirection(), OUTPUT);
 	pinMode(getPinEnable(), OUTPUT);
+#if STEPPER_ISR_TICK_US > 0
+	// impulses and direction PIN are set by the step generator's interrupt
+	stepChannel = stepGenerator.attach(getPinClock(), getPinDirection(), setupData->direction?LOW:HIGH);
+	stepPosition = stepGenerator.getPosition(stepChannel);
+#else
 	direction(!currentDirection); // force setting the PIN by setting the other direction than the current one
+#endif
 
 	// no movement currently
 	movement.setNull();
@@ -57,6 +63,9 @@ void GearedStepperDrive::setup(	StepperConfig* pConfigData, ActuatorConfiguratio
 	accel.setup(this, forwardstep, backwardstep);
 	accel.setMaxSpeed(getMaxStepsPerSecond());
 	accel.setAcceleration(getMaxStepAccPerSecond());
+#if STEPPER_FIXED_POINT
+	setupFixedPoint();
+#endif
 
 	if (memory.persMem.logSetup) {
 		logger->print(F("   "));
@@ -101,6 +110,16 @@ void GearedStepperDrive::setAngle(float pAngle,uint32_t pAngleTargetDuration) {
 	}
 }
 
+// same as setAngle, but the movement starts when the queued movements are done
+bool GearedStepperDrive::queueAngle(float pAngle,uint32_t pAngleTargetDuration) {
+	if (currentAngleAvailable) {
+		pAngle = constrain(pAngle, configData->minAngle,configData->maxAngle);
+		uint32_t now = millis();
+		return movement.add(movement.getCurrentAngle(now), pAngle, now, pAngleTargetDuration);
+	}
+	return true;
+}
+
 void GearedStepperDrive::performStep() {
 	uint8_t clockPIN = getPinClock();
 	// This LOW to HIGH change is what creates the step
@@ -108,14 +127,17 @@ void GearedStepperDrive::performStep() {
 	delayMicroseconds(PIBOT_PULSE_WIDTH_US);
 	digitalWrite(clockPIN, LOW);
 
-	
-	// adapt last motor position according the step, if motor is enabled
+	countStep(currentDirection);
+}
+
+// adapt last motor position according the step, if motor is enabled. The direction of
+// the motor's wiring has been considered when setting the direction PIN already
+void GearedStepperDrive::countStep(bool forward) {
 	if (enabled) { 
-		bool direction = currentDirection;	// currently selected direction
-		float diffAngle = anglePerMicroStep;
-		if (direction != setupData->direction)
-			diffAngle = -diffAngle;
-		currentAngle += diffAngle;
+		if (forward)
+			currentAngle += anglePerMicroStep;
+		else
+			currentAngle -= anglePerMicroStep;
 	}
 }
 
@@ -136,6 +158,13 @@ void GearedStepperDrive::direction(bool forward) {
 void GearedStepperDrive::enable() {
 	enableDriver(true);
 	integral = 0.0;
+	errorDerivative = 0.0;
+#if STEPPER_FIXED_POINT
+	// configuration might have changed since setup
+	setupFixedPoint();
+	integralFixed = 0;
+	errorDerivativeFixed = 0;
+#endif
 }
 
 bool GearedStepperDrive::isEnabled() {
@@ -149,6 +178,16 @@ void GearedStepperDrive::disable() {
 void GearedStepperDrive::enableDriver(bool ok) {
 	enabled = ok; // do this first to switch off the stepper loop, otherwise ticks happens
 
+#if STEPPER_ISR_TICK_US > 0
+	stepGenerator.stop(stepChannel);
+	stepsPerSample = 0;
+	stepRemainder = 0;
+#if STEPPER_FIXED_POINT
+	stepsPerSampleFixed = 0;
+	stepRemainderFixed = 0;
+#endif
+#endif
+
 	// set the clock to low to avoid switch-on-tick due to low/high impulse
 	digitalWrite(getPinClock(), LOW);
 	delayMicroseconds(100);
@@ -163,8 +202,18 @@ void GearedStepperDrive::loop(uint32_t) {
 
 // called very often to execute one stepper step. Dont do complex operations here.
 void GearedStepperDrive::loop() {
+#if STEPPER_ISR_TICK_US > 0
+	// the interrupt did the steps meanwhile, count them
+	int32_t position = stepGenerator.getPosition(stepChannel);
+	while (stepPosition != position) {
+		bool forward = (position > stepPosition);
+		stepPosition += forward?1:-1;
+		countStep(forward);
+	}
+#else
 	if (accel.runSpeed())
 		accel.computeNewSpeed();
+#endif
 }
 
 // returns angle that has been measured lately
@@ -174,16 +223,29 @@ float GearedStepperDrive::getCurrentAngle() {
 
 void GearedStepperDrive::setCurrentAngle(float angle) {
 	currentAngle = angle;
+	estimator.reset(angle);
 }
 
 void GearedStepperDrive::setMeasuredAngle(float pMeasuredActuatorAngle, uint32_t now) { 
-	currentAngle = pMeasuredActuatorAngle;
 	if (!currentAngleAvailable) {
+		estimator.reset(pMeasuredActuatorAngle);
+		currentAngle = pMeasuredActuatorAngle;
 		lastToBeAngle = pMeasuredActuatorAngle;
 		currentAngleAvailable = true;
+	} else {
+		// the counted steps moved the current angle since the last estimation, that's the prediction
+		float stepAngle = currentAngle - estimator.getAngle();
+		currentAngle = estimator.update(pMeasuredActuatorAngle, stepAngle, float(now - lastMeasurementTime)*(1.0/1000.0),
+										ENCODER_ESTIMATOR_ALPHA, ENCODER_ESTIMATOR_BETA);
 	}
+	lastMeasurementTime = now;
 
 	if (!movement.isNull()) {
+		movement.setTime(now);
+#if STEPPER_FIXED_POINT
+		planSampleFixed(now);
+#else
+
 		// compute steps resulting from trajectorys speed and the
 		// error when comparing the to-be position with the measured position
 		float dT = sampleTime();
@@ -198,17 +260,44 @@ void GearedStepperDrive::setMeasuredAngle(float pMeasuredActuatorAngle, uint32_t
 		float nextStepsPerSample = getMicroStepsByAngle(nextAnglePerSample);
 		float stepErrorPerSample = getMicroStepsByAngle(toBeAngle  - currentAngle);		// current error, i.e. to-be-angle compared with encoder's angle
 
-		// the step error is going through a PI-controller and added to the to-be speed (=stepsPerSample)
+		// feed-forward of the trajectory: steps of the next sample at the current speed, and the steps
+		// coming from the acceleration within the next sample (a*T^2/2)
+		float sampleRate = configData->sampleRate;
+		float speed = movement.getCurrentSpeed(now);
+		float velocityFF = getMicroStepsByAngle(speed*sampleRate);
+		float accelerationFF = getMicroStepsByAngle((movement.getCurrentSpeed(now + configData->sampleRate) - speed)*sampleRate*0.5);
+
+		// the step error is going through a PID-controller and added to the feed-forward
 		float maxAcc = getMaxStepAccPerSecond();
 
+		// change of the error within one sample by the estimated speed, low pass filtered since noise is amplified
+		float errorChange = getMicroStepsByAngle(speed*sampleRate - estimator.getSpeed()*dT);
+		errorDerivative += configData->dFilter*(errorChange - errorDerivative);
+
 		float Pout = configData->kP * stepErrorPerSample;
 		integral += stepErrorPerSample * dT;
 		float Iout = configData->kI * integral;
-		float PIDoutput = Pout + Iout;
+		float Dout = configData->kD * errorDerivative;
+		float PIDoutput = Pout + Iout + Dout;
 		float accelerationPerSample = PIDoutput;
 
-		float distanceToNextSample = accelerationPerSample + currStepsPerSample;
-
+		float distanceToNextSample = accelerationPerSample + configData->kV*velocityFF + configData->kA*accelerationFF;
+
+#if STEPPER_ISR_TICK_US > 0
+		// speed changes by maxAcc at most within one sample, and is limited by maxSpeed
+		float maxStepChange = maxAcc*dT*dT;
+		float maxStepsPerSample = getMaxStepsPerSecond()*dT;
+		distanceToNextSample = constrain(distanceToNextSample, stepsPerSample - maxStepChange, stepsPerSample + maxStepChange);
+		distanceToNextSample = constrain(distanceToNextSample, -maxStepsPerSample, maxStepsPerSample);
+		stepsPerSample = distanceToNextSample;
+
+		// the step generator distributes the steps evenly over the sample, the fraction goes into the next sample
+		stepRemainder += distanceToNextSample;
+		int32_t steps = (int32_t)stepRemainder;
+		stepRemainder -= steps;
+		if (enabled)
+			stepGenerator.plan(stepChannel, steps, configData->sampleRate);
+#else
 		// compute the acceleration used in this sample
 		float sampleAcc = (currStepsPerSample-nextStepsPerSample + stepErrorPerSample)*frequency;
 
@@ -222,6 +311,7 @@ void GearedStepperDrive::setMeasuredAngle(float pMeasuredActuatorAngle, uint32_t
 
 		accel.setAcceleration(fabs(sampleAcc));
 		accel.move(distanceToNextSample);
+#endif
 
 		/*
 		if ((configData->id == 4) && memory.persMem.logStepper) {
@@ -248,9 +338,51 @@ void GearedStepperDrive::setMeasuredAngle(float pMeasuredActuatorAngle, uint32_t
 		}
 		*/
 		lastToBeAngle = toBeAngle;
+#endif
 	}
 }
 
+#if STEPPER_FIXED_POINT
+void GearedStepperDrive::setupFixedPoint() {
+	float dT = sampleTime();
+	microStepsPerDegreeFixed = floatToFixed(getMicroStepsByAngle(1.0));
+	sampleTimeFixed = floatToFixed(dT);
+	maxStepChangeFixed = floatToFixed(getMaxStepAccPerSecond()*dT*dT);
+	maxStepsPerSampleFixed = floatToFixed(getMaxStepsPerSecond()*dT);
+}
+
+void GearedStepperDrive::planSampleFixed(uint32_t now) {
+	fixed_t toBeAngle = movement.getCurrentAngleFixed(now);
+	fixed_t stepErrorPerSample = fixedMul(toBeAngle - floatToFixed(currentAngle), microStepsPerDegreeFixed);
+
+	int32_t sampleRate = configData->sampleRate;
+	fixed_t speed = movement.getCurrentSpeedFixed(now);
+	fixed_t velocityFF = fixedMul(speed*sampleRate, microStepsPerDegreeFixed);
+	fixed_t accelerationFF = fixedMul((movement.getCurrentSpeedFixed(now + sampleRate) - speed)*sampleRate/2, microStepsPerDegreeFixed);
+
+	// gains can be changed any time by the host, their conversion is the only float operation left
+	fixed_t errorChange = fixedMul(speed*sampleRate - fixedMul(floatToFixed(estimator.getSpeed()), sampleTimeFixed), microStepsPerDegreeFixed);
+	errorDerivativeFixed += fixedMul(floatToFixed(configData->dFilter), errorChange - errorDerivativeFixed);
+	integralFixed += fixedMul(stepErrorPerSample, sampleTimeFixed);
+	fixed_t distanceToNextSample = fixedMul(floatToFixed(configData->kP), stepErrorPerSample)
+								 + fixedMul(floatToFixed(configData->kI), integralFixed)
+								 + fixedMul(floatToFixed(configData->kD), errorDerivativeFixed)
+								 + fixedMul(floatToFixed(configData->kV), velocityFF)
+								 + fixedMul(floatToFixed(configData->kA), accelerationFF);
+
+	// speed changes by maxAcc at most within one sample, and is limited by maxSpeed
+	distanceToNextSample = constrain(distanceToNextSample, stepsPerSampleFixed - maxStepChangeFixed, stepsPerSampleFixed + maxStepChangeFixed);
+	distanceToNextSample = constrain(distanceToNextSample, -maxStepsPerSampleFixed, maxStepsPerSampleFixed);
+	stepsPerSampleFixed = distanceToNextSample;
+
+	stepRemainderFixed += distanceToNextSample;
+	int32_t steps = fixedToInt(stepRemainderFixed);
+	stepRemainderFixed -= intToFixed(steps);
+	if (enabled)
+		stepGenerator.plan(stepChannel, steps, configData->sampleRate);
+}
+#endif
+
 
 
 
@@ -16,6 +16,8 @@
 #include "ActuatorProperty.h"
 #include "TimePassedBy.h"
 #include "RotaryEncoder.h"
+#include "StepGenerator.h"
+#include "AngleEstimator.h"
 
 class GearedStepperDrive : public MotorBase
 {
@@ -31,11 +33,24 @@ public:
 	void setup(StepperConfig* config, ActuatorConfiguration* pActuatorConfig, StepperSetupData* setupData, RotaryEncoder* encoder);
 	void setAngle(float pAngle,uint32_t pAngleTargetDuration);
 	void changeAngle(float pAngleChange,uint32_t pAngleTargetDuration);
+	bool queueAngle(float pAngle,uint32_t pAngleTargetDuration);
 	void setCurrentAngle(float angle);
 
 	void loop(uint32_t now);
 	void loop();
 	float getCurrentAngle();
+	float getEstimatedSpeed() { return estimator.getSpeed(); };	// [degree/s]
+	// integral of the PI controller, used for telemetry
+#if STEPPER_FIXED_POINT
+	float getIntegral() { return fixedToFloat(integralFixed); };
+	float getStepsPerSecond() { return fixedToFloat(stepsPerSampleFixed)*sampleFrequency(); };
+#elif STEPPER_ISR_TICK_US > 0
+	float getIntegral() { return integral; };
+	float getStepsPerSecond() { return stepsPerSample*sampleFrequency(); };
+#else
+	float getIntegral() { return integral; };
+	float getStepsPerSecond() { return accel.speed(); };
+#endif
 	void setMeasuredAngle(float pMeasuredAngle, uint32_t now);
 	StepperConfig& getConfig() { return *configData;}
 	void direction(bool forward);
@@ -120,6 +135,17 @@ private:
 	// set the Pibot Stepper Drivers enable PIN
 	void enableDriver(bool on);
 
+	// adapt the current angle by one step
+	void countStep(bool forward);
+
+#if STEPPER_FIXED_POINT
+	// compute the constants of the fixed point controller from the configuration
+	void setupFixedPoint();
+
+	// same as the float controller in setMeasuredAngle, but in Q16.16
+	void planSampleFixed(uint32_t now);
+#endif
+
 
 	StepperSetupData* setupData = NULL;
 	ActuatorConfiguration* actuatorConfig = NULL;
@@ -132,8 +158,25 @@ private:
 	float currentAngle;					// current actuator angle (not the motor angle!)
 	bool enabled = false;				// set the setEnable
 	float integral; 					// for PID controller
+	float errorDerivative = 0;			// low pass filtered change of the error per sample [microsteps]
+	AngleEstimator estimator;			// fuses encoder and counted steps
+	uint32_t lastMeasurementTime = 0;	// [ms]
 	float lastToBeAngle = 0;			// last to-be angle coming from to-be trajectory
 	float anglePerMicroStep = 0;
+	uint8_t stepChannel = 0;			// channel of the step generator
+	int32_t stepPosition = 0;			// position of the step generator that has been counted already
+	float stepsPerSample = 0;			// planned steps of the current sample
+	float stepRemainder = 0;			// fraction of a step not yet planned
+#if STEPPER_FIXED_POINT
+	fixed_t integralFixed = 0;			// [microsteps*s]
+	fixed_t errorDerivativeFixed = 0;	// [microsteps]
+	fixed_t stepsPerSampleFixed = 0;	// [microsteps]
+	fixed_t stepRemainderFixed = 0;		// [microsteps]
+	fixed_t microStepsPerDegreeFixed = 0;
+	fixed_t sampleTimeFixed = 0;		// [s]
+	fixed_t maxStepChangeFixed = 0;		// [microsteps] change of steps per sample by max acceleration
+	fixed_t maxStepsPerSampleFixed = 0;	// [microsteps] steps per sample at max speed
+#endif
 	float frequency = 0;
 	float stepsPerDegree = 0;
 	TimePassedBy timer;
@@ -7,6 +7,7 @@
 #include "pins.h"
 
 bool HerkulexServoDrive::communicationEstablished = false; // communication is shared across all servos
+uint8_t HerkulexServoDrive::movesToSend = 0;
 
 bool HerkulexServoDrive::setup(ServoConfig* pConfigData, ServoSetupData* pSetupData) {
 	if (!communicationEstablished) {
@@ -97,7 +98,10 @@ void HerkulexServoDrive::enable() {
 		toBeAngle = movement.getCurrentAngle(millis()+SERVO_SAMPLE_RATE);
 		float asIsAngle = movement.getCurrentAngle(millis());
 
-		moveToAngle(toBeAngle, SERVO_SAMPLE_RATE, false, abs(toBeAngle-asIsAngle)/SERVO_SAMPLE_RATE); // stay at same position after this movement
+		fetchFeedback();
+		moveToAngle(toBeAngle, false, abs(toBeAngle-asIsAngle)/SERVO_SAMPLE_RATE); // stay at same position after this movement
+		sendMoves(SERVO_SAMPLE_RATE);
+		requestFeedback();
 	}
 
 	// now servo is in a valid angle range. Set this angle as starting point
@@ -149,12 +153,20 @@ void HerkulexServoDrive::setAngle(float pAngle,uint32_t pAngleTargetDuration) {
 	movement.set(movement.getCurrentAngle(now), pAngle, now, pAngleTargetDuration);
 }
 
+// same as setAngle, but the movement starts when the queued movements are done
+bool HerkulexServoDrive::queueAngle(float pAngle,uint32_t pAngleTargetDuration) {
+	uint32_t now = millis();
+	pAngle = constrain(pAngle, configData->minAngle,configData->maxAngle);
+	return movement.add(movement.getCurrentAngle(now), pAngle, now, pAngleTargetDuration);
+}
+
 void HerkulexServoDrive::setNullAngle(float pRawAngle /* uncalibrated */) {
 	if (configData)
 		configData->nullAngle = pRawAngle;
 }
 
-void HerkulexServoDrive::moveToAngle(float pAngle, uint32_t pDuration_ms, bool limitRange, float speed /* degrees per ms */) {
+// add the servo to the next S_JOG packet sent by sendMoves
+void HerkulexServoDrive::moveToAngle(float pAngle, bool limitRange, float speed /* degrees per ms */) {
 	if (memory.persMem.logServo) {
 		float actualAngle = readCurrentAngle();
 
@@ -165,8 +177,6 @@ void HerkulexServoDrive::moveToAngle(float pAngle, uint32_t pDuration_ms, bool l
 			logger->print(F(") ang="));
 			logger->print(pAngle);
 			logger->print(",");
-			logger->print(pDuration_ms);
-			logger->print(",");
 			logger->print(actualAngle);
 			logger->print(" ");
 		}
@@ -175,17 +185,15 @@ void HerkulexServoDrive::moveToAngle(float pAngle, uint32_t pDuration_ms, bool l
 	if (limitRange) 
 		calibratedAngle = constrain(calibratedAngle, configData->minAngle,configData->maxAngle) ;
 		
-	// add one sample slot to the time, otherwise the servo does not run smooth but in steps	
-	Herkulex.moveOneAngle(setupData->herkulexMotorId, (calibratedAngle + configData->nullAngle)-torqueExceededAngleCorr, pDuration_ms, LED_BLUE);
+	Herkulex.moveAllAngle(setupData->herkulexMotorId, (calibratedAngle + configData->nullAngle)-torqueExceededAngleCorr, LED_BLUE);
+	movesToSend++;
 	currentAngle = calibratedAngle;
 
 	bool maxTorqueReached = false;
 	if ((getConfig().id == GRIPPER)) 	{
-
-		// read torque via direct communication to servo
+		// torque has been fetched by fetchFeedback and is one sample old
 		// (unfortunately this is actually not torque but the
 		// PWM value which is kind of proportional to torque)
-		torque = readServoTorque();
 
 		// if torque is too high, release it
 		maxTorqueReached = (abs(torque) > maxTorque);
@@ -265,14 +273,43 @@ float HerkulexServoDrive::getRawAngle() {
 }
 
 void HerkulexServoDrive::loop(uint32_t now) {
+	fetchFeedback();
 	if (!movement.isNull()) {
+		movement.setTime(now);
 		float toBeAngle = movement.getCurrentAngle(now+SERVO_SAMPLE_RATE);
 		float asIsAngle = movement.getCurrentAngle(now);
 
 		float speed = (toBeAngle-asIsAngle)/SERVO_SAMPLE_RATE;
 
 		currentAngle = toBeAngle;
-		moveToAngle(toBeAngle, (SERVO_SAMPLE_RATE + SERVO_MOVE_DURATION), true, speed); // stay at same position after this movement
+		moveToAngle(toBeAngle, true, speed); // stay at same position after this movement
+	}
+}
+
+// send the movements of all servos collected by moveToAngle in one S_JOG packet
+void HerkulexServoDrive::sendMoves(uint32_t pDuration_ms) {
+	if (movesToSend > 0) {
+		Herkulex.actionAll(pDuration_ms);
+		movesToSend = 0;
+	}
+}
+
+// send the request for the servo's feedback without waiting for the reply. The reply
+// comes in while the loop continues and is fetched with the next sample.
+// Only the gripper needs feedback, so there is one reply at most on the bus.
+void HerkulexServoDrive::requestFeedback() {
+	if (isConnected() && (getConfig().id == GRIPPER)) {
+		Herkulex.requestPWM(setupData->herkulexMotorId);
+		feedback = TORQUE_REQUESTED;
+	}
+}
+
+void HerkulexServoDrive::fetchFeedback() {
+	if (feedback == TORQUE_REQUESTED) {
+		// a reply that did not come in within one sample is dropped, the next request will clear it
+		if (Herkulex.isReplyAvailable(HERKULEX_REGISTER_REPLY_SIZE))
+			torque = float(Herkulex.readPWM()); // pwm is proportional to torque
+		feedback = NO_FEEDBACK_REQUESTED;
 	}
 }
 
@@ -291,8 +328,3 @@ void HerkulexServoDrive::readFeedback(float &angle, float &torque /* [Nm) */, bo
 	torque = float (pwm);	
 }
 
-float HerkulexServoDrive::readServoTorque(){
-	int16_t pwm = Herkulex.getPWM(setupData->herkulexMotorId); // pwm is proportional to torque
-	float torque = float (pwm);
-	return torque;
-}
@@ -32,9 +32,12 @@ public:
 		torqueExceededAngleCorr = 0.0;
 		connected = false;
 		enabled = false;
+		torque = 0;
+		feedback = NO_FEEDBACK_REQUESTED;
 	}
 	void setAngle(float angle,uint32_t pDuration_ms);
 	void changeAngle(float pAngleChange,uint32_t pAngleTargetDuration);
+	bool queueAngle(float pAngle,uint32_t pAngleTargetDuration);
 	
 	bool setup( ServoConfig* config, ServoSetupData* setupData);
 	void loop(uint32_t now);
@@ -51,6 +54,10 @@ public:
 	
 	ServoConfig& getConfig() { return *configData;}
 	static void setupCommunication( );
+
+	// movements are collected by loop and sent to all servos in one packet
+	static void sendMoves(uint32_t pDuration_ms);
+	void requestFeedback();
 	void enable();
 	void disable();
 	bool isEnabled();
@@ -58,8 +65,8 @@ public:
 
 
 private:	
-	float readServoTorque();
-	void moveToAngle(float angle, uint32_t pDuration_ms, bool limitRange, float speed);
+	void moveToAngle(float angle, bool limitRange, float speed);
+	void fetchFeedback();
 	bool beforeFirstMove;
 
 	float currentAngle;
@@ -69,6 +76,7 @@ private:
 	ServoSetupData* setupData;
 	float lastAngle;						 // angle of previous run
 	static boolean communicationEstablished; // true if communication to herkulex Servo via Serial1 has been established
+	static uint8_t movesToSend;				 // number of servos in the next S_JOG packet
 	uint32_t startTime;						 // time when servos have been initialized. Required to start sending commands not too early
 	
 	float torqueExceededAngleCorr;			 // correction of angle due to overload of torque
@@ -76,6 +84,7 @@ private:
 	float torque;							 // current Torque
 	bool connected;							 // connected
 	bool enabled;
+	enum { NO_FEEDBACK_REQUESTED, TORQUE_REQUESTED } feedback; // state of the non-blocking feedback
 }; //MotorDriver
 
 #endif //__MOTORDRIVER_HERKULEX_IMPL_H__
@@ -15,6 +15,7 @@
 #include "core.h"
 #include "LightsController.h"
 #include "Printer.h"
+#include "Profiler.h"
 
 HostCommunication hostComm;
 extern Controller controller;
@@ -23,25 +24,98 @@ extern BotMemory botMemory;
 extern void setCortexBoardLED(bool onOff);
 extern void setLEDPattern();
 
+// with sequence numbers, the reply tells which command it belongs to
+void printSeqNo() {
+	if (hostComm.sCmd.getSeqNo() != 0) {
+		cmdSerial->print(F(" #"));
+		cmdSerial->print(hostComm.sCmd.getSeqNo());
+	}
+}
+
 void replyOk() {
-	cmdSerial->println(F(">ok"));
+	hostComm.sCmd.storeResult(ABSOLUTELY_NO_ERROR);
+	cmdSerial->print(F(">ok"));
+	printSeqNo();
+	cmdSerial->println();
 	cmdSerial->print(F(">"));
 }
 
 void replyError(int errorCode) {
+	// the host repeated a command that has been executed already, since the reply got lost. Reply the same again.
+	uint8_t repeatedResult;
+	if (hostComm.sCmd.isRepetition(repeatedResult)) {
+		if (repeatedResult == ABSOLUTELY_NO_ERROR) {
+			replyOk();
+			return;
+		}
+		errorCode = repeatedResult;
+	}
+
 	int patchedErrorCode = errorCode;
 	if (errorCode == PARAM_NUMBER_WRONG) {
 		if (hostComm.sCmd.getErrorCode() != 0) {
 			patchedErrorCode = hostComm.sCmd.getErrorCode();
 		}
 	}
+	hostComm.sCmd.storeResult(patchedErrorCode);
 	cmdSerial->print(F(">nok("));
 	cmdSerial->print(patchedErrorCode);
-	cmdSerial->println(")");
+	cmdSerial->print(")");
+	printSeqNo();
+	cmdSerial->println();
 	cmdSerial->print(F(">"));
 }
 
 
+// send a binary frame, same layout as frames sent by the host
+void sendFrame(HardwareSerial* serial, uint8_t command, uint8_t* payload, uint8_t length) {
+	uint8_t frame[FRAME_TELEMETRY_LENGTH];
+	int len = 0;
+	frame[len++] = FRAME_SYNC_BYTE;
+	frame[len++] = length+1;
+	frame[len++] = command;
+	memcpy(&frame[len], payload, length);
+	len += length;
+	uint16_t crc = crc16(&frame[1], len-1);
+	frame[len++] = crc & 0xFF;
+	frame[len++] = (crc >> 8) & 0xFF;
+	serial->write(frame, len);
+}
+
+// send a binary frame as part of a reply, followed by replyOk
+void replyFrame(uint8_t command, uint8_t* payload, uint8_t length) {
+	sendFrame(cmdSerial, command, payload, length);
+}
+
+// measure the time the checksums of a MOVETO command take, logged by LOG crc on
+void logChecksumThroughput() {
+	char line[] = "MOVETO -12.34 56.78 -90.12 34.56 -78.90 12.34 56.78 100 seq=123";
+	const int runs = 1000;
+	const int length = strlen(line);
+
+	uint32_t start = micros();
+	uint8_t hash = 0;
+	for (int i = 0;i<runs;i++)
+		hostComm.sCmd.computeChecksum(line, hash);
+	uint32_t hashTime = micros() - start;
+
+	start = micros();
+	uint16_t crc = 0;
+	for (int i = 0;i<runs;i++)
+		crc ^= crc16((uint8_t*)line, length);
+	uint32_t crcTime = micros() - start;
+
+	logger->print(F("checksum of "));
+	logger->print(runs*length);
+	logger->print(F(" bytes: hash="));
+	logger->print(hashTime);
+	logger->print(F("us crc16="));
+	logger->print(crcTime);
+	logger->print(F("us ("));
+	logger->print(hash ^ crc); // keeps the loops from being optimized away
+	logger->println(F(")"));
+}
+
 void cmdLOG() {
 	char* logClass= NULL;
 	char* onOff= NULL;
@@ -94,11 +168,24 @@ void cmdLOG() {
 			replyOk();
 			return;
 		}
+		if (onOffSet && (strncasecmp(logClass, "crc", 3) == 0)) {
+			if (onOffFlag)
+				logChecksumThroughput();
+			valueOK = true;
+			replyOk();
+			return;
+		}
 		if (onOffSet && (strncasecmp(logClass, "test", 5) == 0)) {
 			valueOK = true;
 			replyOk();
 			return;
 		}
+		if (onOffSet && (strncasecmp(logClass, "profile", 7) == 0)) {
+			profiler.enable(onOffFlag);
+			valueOK = true;
+			replyOk();
+			return;
+		}
 		if (onOffSet && (strncasecmp(logClass, "loop", 5) == 0)) {
 			memory.persMem.logLoop = onOffFlag;
 
@@ -225,6 +312,10 @@ void cmdCHECKSUM() {
 			hostComm.sCmd.useChecksum(false);
 			valueOK = true;
 		}
+		if (strncasecmp(onoff, "crc", 3) == 0) {
+			hostComm.sCmd.useChecksum(true, true);
+			valueOK = true;
+		}
 		if (valueOK) {
 			replyOk();
 		}
@@ -254,6 +345,7 @@ void cmdECHO() {
 
 void cmdPRINT() {
 	bool saveUseChecksum = hostComm.sCmd.isChecksum();
+	bool saveUseCRC = hostComm.sCmd.isCRC();
 	hostComm.sCmd.useChecksum(false);
 	bool paramsOK = true;
 	char* param = 0;
@@ -291,7 +383,7 @@ void cmdPRINT() {
 					printer.println();
 					printer.println();
 				} else {
-					if (strncasecmp(param, "chk", 3) != 0)
+					if ((strncasecmp(param, "chk", 3) != 0) && (strncasecmp(param, "crc=", 4) != 0) && (strncasecmp(param, "seq=", 4) != 0))
 						printer.print(param);
 					else {
 						paramsOK = false;
@@ -303,7 +395,7 @@ void cmdPRINT() {
 	};
 	paramsOK = true;
 	paramsOK = hostComm.sCmd.endOfParams() && paramsOK;
-	hostComm.sCmd.useChecksum(saveUseChecksum);
+	hostComm.sCmd.useChecksum(saveUseChecksum, saveUseCRC);
 
 
 	if (paramsOK) {
@@ -316,6 +408,7 @@ void cmdPRINT() {
 
 void cmdPRINTLN() {
 	bool saveUseChecksum = hostComm.sCmd.isChecksum();
+	bool saveUseCRC = hostComm.sCmd.isCRC();
 	hostComm.sCmd.useChecksum(false);
 
 	bool paramsOK = true;
@@ -328,7 +421,7 @@ void cmdPRINTLN() {
 				first = false;
 			else
 				printer.print(" ");
-			if (strncasecmp(param, "chk", 3) != 0)
+			if ((strncasecmp(param, "chk", 3) != 0) && (strncasecmp(param, "crc=", 4) != 0) && (strncasecmp(param, "seq=", 4) != 0))
 				printer.print(param);
 			else {
 				paramsOK = false;
@@ -339,7 +432,7 @@ void cmdPRINTLN() {
 	paramsOK = true;
 	paramsOK = hostComm.sCmd.endOfParams() && paramsOK;
 	paramsOK = hostComm.sCmd.endOfParams() && paramsOK;
-	hostComm.sCmd.useChecksum(saveUseChecksum);
+	hostComm.sCmd.useChecksum(saveUseChecksum, saveUseCRC);
 
 	if (paramsOK) {
 		printer.println();
@@ -514,10 +607,35 @@ void cmdSTEP() {
 }
 
 
+// set min, max and null angle of an actuator and store it in the persistent memory
+void setActuatorMinAngle(int actuatorNo, float minValue) {
+	controller.getActuator(actuatorNo)->setMinAngle(minValue);
+	if (memory.persMem.armConfig[actuatorNo].actuatorType  == STEPPER_ENCODER_TYPE) 
+		memory.persMem.armConfig[actuatorNo].config.stepperArm.stepper.minAngle= minValue;
+	else
+		memory.persMem.armConfig[actuatorNo].config.servoArm.servo.minAngle= minValue;
+}
+
+void setActuatorMaxAngle(int actuatorNo, float maxValue) {
+	controller.getActuator(actuatorNo)->setMaxAngle(maxValue);
+	if (memory.persMem.armConfig[actuatorNo].actuatorType  == STEPPER_ENCODER_TYPE)
+		memory.persMem.armConfig[actuatorNo].config.stepperArm.stepper.maxAngle= maxValue;
+	else
+		memory.persMem.armConfig[actuatorNo].config.servoArm.servo.maxAngle= maxValue;
+}
+
+void setActuatorNullAngle(int actuatorNo, float nullValue) {
+	controller.getActuator(actuatorNo)->setNullAngle(nullValue);
+	if (memory.persMem.armConfig[actuatorNo].actuatorType  == STEPPER_ENCODER_TYPE)
+		memory.persMem.armConfig[actuatorNo].config.stepperArm.encoder.nullAngle= nullValue;
+	else
+		memory.persMem.armConfig[actuatorNo].config.servoArm.servo.nullAngle= nullValue;
+}
+
 void cmdSET() {
 	int16_t actuatorNo = 0;
-	float maxSpeed,maxAcc,P,D, I, minValue, maxValue, nullValue = 0, sampleRate = 0;
-	bool maxSpeedSet, maxAccSet, PSet,DSet, ISet, minValueSet, maxValueSet, nullValueSet, sampleRateSet = false;
+	float maxSpeed,maxAcc,P,D, I, V, A, DFilter, minValue, maxValue, nullValue = 0, sampleRate = 0;
+	bool maxSpeedSet, maxAccSet, PSet,DSet, ISet, VSet, ASet, DFilterSet, minValueSet, maxValueSet, nullValueSet, sampleRateSet = false;
 
 	bool paramsOK = hostComm.sCmd.getParamInt(actuatorNo);	
 	paramsOK = hostComm.sCmd.getNamedParamFloat("min",minValue,minValueSet) && paramsOK;
@@ -528,6 +646,9 @@ void cmdSET() {
 	paramsOK = hostComm.sCmd.getNamedParamFloat("P",P,PSet)&& paramsOK;
 	paramsOK = hostComm.sCmd.getNamedParamFloat("I",I,ISet)&& paramsOK;
 	paramsOK = hostComm.sCmd.getNamedParamFloat("D",D,DSet)&& paramsOK;
+	paramsOK = hostComm.sCmd.getNamedParamFloat("V",V,VSet)&& paramsOK;
+	paramsOK = hostComm.sCmd.getNamedParamFloat("A",A,ASet)&& paramsOK;
+	paramsOK = hostComm.sCmd.getNamedParamFloat("DF",DFilter,DFilterSet)&& paramsOK;
 
 	paramsOK = hostComm.sCmd.endOfParams() && paramsOK;
 	
@@ -538,31 +659,17 @@ void cmdSET() {
 
 			valueOK = false;
 			if ((minValueSet) && (abs(minValue) < 180)) {
-				actuator->setMinAngle(minValue);
-				if (memory.persMem.armConfig[actuatorNo].actuatorType  == STEPPER_ENCODER_TYPE) 
-					memory.persMem.armConfig[actuatorNo].config.stepperArm.stepper.minAngle= minValue;
-				else
-					memory.persMem.armConfig[actuatorNo].config.servoArm.servo.minAngle= minValue;
-
+				setActuatorMinAngle(actuatorNo, minValue);
 				valueOK = true;
 			} 
 
 			if ((maxValueSet) && (abs(maxValue) < 180)) {
-				actuator->setMaxAngle(maxValue);
-				if (memory.persMem.armConfig[actuatorNo].actuatorType  == STEPPER_ENCODER_TYPE)
-					memory.persMem.armConfig[actuatorNo].config.stepperArm.stepper.maxAngle= maxValue;
-				else
-					memory.persMem.armConfig[actuatorNo].config.servoArm.servo.maxAngle= maxValue;
-
+				setActuatorMaxAngle(actuatorNo, maxValue);
 				valueOK = true;
 			}
 
 			if ((nullValueSet) && (abs(nullValue) < 360)) {
-				actuator->setNullAngle(nullValue);
-				if (memory.persMem.armConfig[actuatorNo].actuatorType  == STEPPER_ENCODER_TYPE)
-					memory.persMem.armConfig[actuatorNo].config.stepperArm.encoder.nullAngle= nullValue;
-				else
-					memory.persMem.armConfig[actuatorNo].config.servoArm.servo.nullAngle= nullValue;
+				setActuatorNullAngle(actuatorNo, nullValue);
 				valueOK = true;
 			}
 
@@ -604,6 +711,27 @@ void cmdSET() {
 				valueOK = true;
 			}
 
+			if ((VSet) && (V >= 0.0) && (V <= 2.0)) {
+				actuator->setV(V);
+				if (memory.persMem.armConfig[actuatorNo].actuatorType  == STEPPER_ENCODER_TYPE)
+					memory.persMem.armConfig[actuatorNo].config.stepperArm.stepper.kV= V;
+				valueOK = true;
+			}
+
+			if ((ASet) && (A >= 0.0) && (A <= 2.0)) {
+				actuator->setA(A);
+				if (memory.persMem.armConfig[actuatorNo].actuatorType  == STEPPER_ENCODER_TYPE)
+					memory.persMem.armConfig[actuatorNo].config.stepperArm.stepper.kA= A;
+				valueOK = true;
+			}
+
+			if ((DFilterSet) && (DFilter > 0.0) && (DFilter <= 1.0)) {
+				actuator->setDFilter(DFilter);
+				if (memory.persMem.armConfig[actuatorNo].actuatorType  == STEPPER_ENCODER_TYPE)
+					memory.persMem.armConfig[actuatorNo].config.stepperArm.stepper.dFilter= DFilter;
+				valueOK = true;
+			}
+
 			if ((sampleRateSet) && ((sampleRate > 5) && fabs(sampleRate) <= 1000.0)) {
 				actuator->setD(D);
 				if (memory.persMem.armConfig[actuatorNo].actuatorType  == STEPPER_ENCODER_TYPE)
@@ -624,6 +752,96 @@ void cmdSET() {
 		replyError(PARAM_NUMBER_WRONG);
 }
 
+// torque and flags of an actuator as reported by STATUS
+void getActuatorHealth(Actuator* actuator, int16_t& torque, uint8_t& flags) {
+	torque = 0;
+	flags = 0;
+	if (actuator->hasServo()) {
+		torque = actuator->getServo().getTorque();
+		if (actuator->getServo().isOk())
+			flags |= FRAME_STATUS_OK;
+		if (actuator->getServo().isEnabled())
+			flags |= FRAME_STATUS_ENABLED;
+	}
+	if (actuator->hasStepper()) {
+		if (actuator->hasEncoder() && actuator->getEncoder().isOk())
+			flags |= FRAME_STATUS_OK;
+		if (actuator->getStepper().isEnabled())
+			flags |= FRAME_STATUS_ENABLED;
+	}
+}
+
+void cmdSTATUS() {
+	bool paramsOK = hostComm.sCmd.endOfParams();
+	if (paramsOK) {
+		if (controller.isSetup()) {
+			for (int i = 0;i<MAX_ACTUATORS;i++) {
+				Actuator* actuator = controller.getActuator(i);
+				int16_t torque;
+				uint8_t flags;
+				getActuatorHealth(actuator, torque, flags);
+				cmdSerial->print(F(" n="));
+				cmdSerial->print(i);
+				cmdSerial->print(F(" ang="));
+				cmdSerial->print(actuator->getCurrentAngle(),2);
+				cmdSerial->print(F(" min="));
+				cmdSerial->print(actuator->getMinAngle(),2);
+				cmdSerial->print(F(" max="));
+				cmdSerial->print(actuator->getMaxAngle(),2);
+				cmdSerial->print(F(" null="));
+				cmdSerial->print(actuator->getNullAngle(),2);
+				cmdSerial->print(F(" torque="));
+				cmdSerial->print(torque);
+				cmdSerial->print(F(" flags="));
+				cmdSerial->print(flags);
+			}
+			replyOk();
+		} else
+			replyError(CORTEX_SETUP_MISSING);
+	}
+	else
+		replyError(PARAM_NUMBER_WRONG);
+}
+
+// angle as int16 in 1/100 degree, little endian
+void putFrameAngle(uint8_t* &p, float angle) {
+	int16_t value = constrain(angle*FRAME_ANGLE_SCALE, -32767.0, 32767.0);
+	*p++ = value & 0xFF;
+	*p++ = (value >> 8) & 0xFF;
+}
+
+// binary STATUS, reply is a frame with 7 x <int16 angle> <int16 min> <int16 max> <int16 null> <int16 torque> <uint8 flags>
+void binSTATUS(uint8_t* payload, uint8_t length) {
+	bool paramsOK = (length == 0);
+	paramsOK = hostComm.sCmd.endOfFrame() && paramsOK;
+	if (!paramsOK) {
+		replyError(PARAM_NUMBER_WRONG);
+		return;
+	}
+	if (!controller.isSetup()) {
+		replyError(CORTEX_SETUP_MISSING);
+		return;
+	}
+
+	uint8_t status[FRAME_STATUS_PAYLOAD_LENGTH];
+	uint8_t* p = status;
+	for (int i = 0;i<MAX_ACTUATORS;i++) {
+		Actuator* actuator = controller.getActuator(i);
+		int16_t torque;
+		uint8_t flags;
+		getActuatorHealth(actuator, torque, flags);
+		putFrameAngle(p, actuator->getCurrentAngle());
+		putFrameAngle(p, actuator->getMinAngle());
+		putFrameAngle(p, actuator->getMaxAngle());
+		putFrameAngle(p, actuator->getNullAngle());
+		*p++ = torque & 0xFF;
+		*p++ = (torque >> 8) & 0xFF;
+		*p++ = flags;
+	}
+	replyFrame(CommDefType::STATUS_CMD, status, FRAME_STATUS_PAYLOAD_LENGTH);
+	replyOk();
+}
+
 void cmdGET() {
 	int actuatorNo = -1;
 	bool isAll = false;
@@ -696,6 +914,27 @@ void cmdGET() {
 }
 
 
+// move all actuators to the passed angles within duration [ms]. Used by text and binary MOVETO
+void moveTo(float angle[], int16_t duration) {
+	if (memory.persMem.logLoop) {
+		logger->print(F("moveTo "));
+	}
+	for (int i = 0;i<7;i++) {
+		lights.setPoseSample();
+		controller.getActuator(i)->setAngle(angle[i],duration);
+		if (memory.persMem.logLoop) {
+			if (i>0)
+				logger->print(",");
+			logger->print(angle[i]);
+		}
+	}
+	if (memory.persMem.logLoop) {
+		logger->print(",");
+		logger->print(duration);
+		logger->println();
+	}
+}
+
 void cmdMOVETO() {
 	float angle[7] = {0,0,0,0,0,0,0};
 	bool paramsOK = true;
@@ -707,29 +946,226 @@ void cmdMOVETO() {
 	paramsOK = hostComm.sCmd.endOfParams() && paramsOK;
 	
 	if (paramsOK) {
-		if (memory.persMem.logLoop) {
-			logger->print(F("moveTo "));
-		}
-		for (int i = 0;i<7;i++) {
-			lights.setPoseSample();
-			controller.getActuator(i)->setAngle(angle[i],duration);
-			if (memory.persMem.logLoop) {
-				if (i>0)
-					logger->print(",");
-				logger->print(angle[i]);
-			}
+		moveTo(angle, duration);
+		replyOk();
+	}
+	else
+		replyError(PARAM_NUMBER_WRONG);
+}
+
+// binary MOVETO, payload is <7 x int16 angle in 1/100 degree> <uint16 duration>
+void binMOVETO(uint8_t* payload, uint8_t length) {
+	float angle[7];
+	bool paramsOK = (length == FRAME_MOVETO_PAYLOAD_LENGTH);
+	paramsOK = hostComm.sCmd.endOfFrame() && paramsOK;
+	if (paramsOK) {
+		for (int i = 0;i<7;i++)
+			angle[i] = ((int16_t)(payload[i*2] | (payload[i*2+1] << 8))) / (float)FRAME_ANGLE_SCALE;
+		int16_t duration = payload[14] | (payload[15] << 8);
+		paramsOK = (duration <= 9999) && (duration>=20);
+		if (paramsOK) {
+			moveTo(angle, duration);
+			replyOk();
+			return;
 		}
+	}
+	replyError(PARAM_NUMBER_WRONG);
+}
+
+// append one sample to the movement queues of all actuators. Returns false if one queue is full
+bool queueSample(float angle[], int16_t duration) {
+	if (memory.persMem.logLoop) {
+		logger->print(F("queue "));
+	}
+	bool ok = true;
+	for (int i = 0;i<7;i++) {
+		ok = controller.getActuator(i)->queueAngle(angle[i],duration) && ok;
 		if (memory.persMem.logLoop) {
-			logger->print(",");
-			logger->print(duration);
-			logger->println();
+			if (i>0)
+				logger->print(",");
+			logger->print(angle[i]);
 		}
-		replyOk();
+	}
+	if (memory.persMem.logLoop) {
+		logger->print(",");
+		logger->print(duration);
+		logger->println();
+	}
+	lights.setPoseSample();
+	return ok;
+}
+
+// true, if all movement queues can take the passed number of samples
+bool queueHasSpace(int samples) {
+	uint32_t now = millis();
+	for (int i = 0;i<7;i++) {
+		if (controller.getActuator(i)->getMovement().getFill(now) + samples > MOVEMENT_QUEUE_SIZE)
+			return false;
+	}
+	return true;
+}
+
+// print the state of the fullest movement queue, used by the host for flow control
+void printQueueState() {
+	uint32_t now = millis();
+	int fill = 0;
+	uint32_t ahead = 0;
+	for (int i = 0;i<7;i++) {
+		AngleMovementQueue<MOVEMENT_QUEUE_SIZE>& queue = controller.getActuator(i)->getMovement();
+		fill = max(fill, queue.getFill(now));
+		ahead = max(ahead, queue.getTimeAhead(now));
+	}
+	cmdSerial->print(F("fill="));
+	cmdSerial->print(fill);
+	cmdSerial->print(F(" ahead="));
+	cmdSerial->print(ahead);
+}
+
+void cmdCHUNK() {
+	float angle[7] = {0,0,0,0,0,0,0};
+	bool paramsOK = true;
+	int16_t duration = 0;
+	for (int i = 0;i<7;i++)
+		paramsOK = hostComm.sCmd.getParamFloat(angle[i]) && (abs(angle[i]) <= 360.0) && paramsOK;
+
+	paramsOK = hostComm.sCmd.getParamInt(duration) && (duration <= 9999) && (duration>=1) && paramsOK;
+	paramsOK = hostComm.sCmd.endOfParams() && paramsOK;
+
+	if (paramsOK) {
+		if (queueHasSpace(1) && queueSample(angle, duration)) {
+			printQueueState();
+			replyOk();
+		}
+		else
+			replyError(CORTEX_QUEUE_FULL);
 	}
 	else
 		replyError(PARAM_NUMBER_WRONG);
 }
 
+// binary CHUNK, payload is <uint8 number of samples> (<7 x int16 angle in 1/100 degree> <uint16 duration>)*
+// Samples are queued only if all of them fit into the queue
+void binCHUNK(uint8_t* payload, uint8_t length) {
+	uint8_t samples = (length > 0)?payload[0]:0;
+	bool paramsOK = (samples > 0) && (samples <= FRAME_CHUNK_MAX_SAMPLES) && (length == 1+samples*FRAME_CHUNK_SAMPLE_LENGTH);
+	paramsOK = hostComm.sCmd.endOfFrame() && paramsOK;
+	if (paramsOK) {
+		for (int s = 0;s<samples;s++) {
+			uint8_t* sample = &payload[1+s*FRAME_CHUNK_SAMPLE_LENGTH];
+			int16_t duration = sample[14] | (sample[15] << 8);
+			paramsOK = (duration <= 9999) && (duration>=1) && paramsOK;
+		}
+	}
+	if (!paramsOK) {
+		replyError(PARAM_NUMBER_WRONG);
+		return;
+	}
+	if (!queueHasSpace(samples)) {
+		replyError(CORTEX_QUEUE_FULL);
+		return;
+	}
+
+	bool ok = true;
+	for (int s = 0;s<samples;s++) {
+		float angle[7];
+		uint8_t* sample = &payload[1+s*FRAME_CHUNK_SAMPLE_LENGTH];
+		for (int i = 0;i<7;i++)
+			angle[i] = ((int16_t)(sample[i*2] | (sample[i*2+1] << 8))) / (float)FRAME_ANGLE_SCALE;
+		int16_t duration = sample[14] | (sample[15] << 8);
+		ok = queueSample(angle, duration) && ok;
+	}
+	if (ok) {
+		printQueueState();
+		replyOk();
+	} else
+		replyError(CORTEX_QUEUE_FULL);
+}
+
+void cmdTELEMETRY() {
+	int16_t period = 0;
+	bool paramsOK = hostComm.sCmd.getParamInt(period);
+	paramsOK = hostComm.sCmd.endOfParams() && paramsOK;
+
+	if (paramsOK) {
+		// limit the rate such that the log port is not saturated
+		if ((period == 0) || ((period >= TELEMETRY_MIN_PERIOD) && (period <= 10000))) {
+			hostComm.setTelemetryPeriod(period);
+			replyOk();
+		}
+		else
+			replyError(PARAM_WRONG);
+	} else {
+		replyError(PARAM_NUMBER_WRONG);
+	}
+}
+
+void cmdBINARY() {
+	char* onoff = 0;
+	bool paramsOK = hostComm.sCmd.getParamString(onoff);
+	paramsOK = hostComm.sCmd.endOfParams() && paramsOK;
+
+	if (paramsOK) {
+		bool valueOK = false;
+		if (strncasecmp(onoff, "on", 2) == 0) {
+			hostComm.sCmd.useBinaryFrames(true);
+			valueOK = true;
+		}
+		if (strncasecmp(onoff, "off", 3) == 0) {
+			hostComm.sCmd.useBinaryFrames(false);
+			valueOK = true;
+		}
+		if (valueOK) {
+			replyOk();
+		}
+		else
+			replyError(PARAM_WRONG);
+	} else {
+			replyError(PARAM_NUMBER_WRONG);
+	}
+}
+
+void cmdSEQ() {
+	char* onoff = 0;
+	bool paramsOK = hostComm.sCmd.getParamString(onoff);
+	paramsOK = hostComm.sCmd.endOfParams() && paramsOK;
+
+	if (paramsOK) {
+		bool valueOK = false;
+		if (strncasecmp(onoff, "on", 2) == 0) {
+			hostComm.sCmd.useSequenceNumbers(true);
+			valueOK = true;
+		}
+		if (strncasecmp(onoff, "off", 3) == 0) {
+			hostComm.sCmd.useSequenceNumbers(false);
+			valueOK = true;
+		}
+		if (valueOK) {
+			replyOk();
+		}
+		else
+			replyError(PARAM_WRONG);
+	} else {
+			replyError(PARAM_NUMBER_WRONG);
+	}
+}
+
+// called when a binary frame has been received. The command id is the same as in CommDef
+void binaryCommand(uint8_t command, uint8_t* payload, uint8_t length) {
+	switch (command) {
+		case CommDefType::MOVETO_CMD:
+			binMOVETO(payload, length);
+			break;
+		case CommDefType::CHUNK_CMD:
+			binCHUNK(payload, length);
+			break;
+		case CommDefType::STATUS_CMD:
+			binSTATUS(payload, length);
+			break;
+		default:
+			replyError(UNRECOGNIZED_CMD);
+	}
+}
+
 // This gets set as the default handler, and gets called when no other command matches.
 void cmdUnrecognized(const char *command) {
 	cmdSerial->print(command);
@@ -748,13 +1184,18 @@ void cmdHELP() {
 		cmdSerial->println(F("\tPOWER <on|off>"));
 		cmdSerial->println(F("\tKNOB <ActuatorNo>"));
 		cmdSerial->println(F("\tSTEP <ActuatorNo> <incr>"));
-		cmdSerial->println(F("\tCHECKSUM <on|off>"));
+		cmdSerial->println(F("\tCHECKSUM <on|crc|off>"));
 		cmdSerial->println(F("\tMEM (<reset>|<list>)"));
-		cmdSerial->println(F("\tSET <ActuatorNo> [min=<min>] [max=<max>] [null=<nullvalue>] [speed=x][acc=x] [P=x][D=x] [res=speed]"));
+		cmdSerial->println(F("\tSET <ActuatorNo> [min=<min>] [max=<max>] [null=<nullvalue>] [speed=x][acc=x] [P=x][D=x] [V=x][A=x][DF=x] [res=speed]"));
 		cmdSerial->println(F("\tGET <ActuatorNo> : n=<name> ang=<angle> min=<min> max=<max> null=<null>"));
 		cmdSerial->println(F("\tGET all : (i=<no> n=<name> ang=<angle> min=<min> max=<max> null=<null>)"));
+		cmdSerial->println(F("\tSTATUS : (n=<no> ang=<angle> min=<min> max=<max> null=<null> torque=<torque> flags=<flags>)"));
 		cmdSerial->println(F("\tMOVETO <angle1> <angle2> ... <angle7> <durationMS>"));
-		cmdSerial->println(F("\tLOG <setup|servo|stepper|encoder|loop> <on|off>"));
+		cmdSerial->println(F("\tCHUNK <angle1> <angle2> ... <angle7> <durationMS>"));
+		cmdSerial->println(F("\tBINARY <on|off>"));
+		cmdSerial->println(F("\tSEQ <on|off>"));
+		cmdSerial->println(F("\tTELEMETRY <periodMS|0>"));
+		cmdSerial->println(F("\tLOG <setup|servo|stepper|encoder|loop|crc|profile> <on|off>"));
 		cmdSerial->println(F("\tINFO"));
 
 		replyOk();
@@ -773,15 +1214,67 @@ HostCommunication::HostCommunication()
 void HostCommunication::setup() {
 	// Setup callbacks for SerialCommand commands
 	for (int i = 0;i<CommDefType::NumberOfCommands;i++) {
-		sCmd.addCommand(commDef[i].name, commDef[i].cmdFunction);
+		sCmd.addCommand(commDef[i].name, commDef[i].cmdFunction, commDef[i].idempotent);
 	}
 	sCmd.setDefaultHandler(cmdUnrecognized);   // Handler for command that isn't matched  (says "What?")
+	sCmd.setBinaryHandler(binaryCommand);      // Handler for binary frames, switched on by BINARY on
 
 	sCmd.useChecksum(false);
+	sCmd.useBinaryFrames(false);
+	sCmd.useSequenceNumbers(false);
 }
 
 void HostCommunication::loop(uint32_t now) {
 	sCmd.readSerial();     // We don't do much, just process serial commands
+
+	// a frame waits for the next pass if the log UART's transmit buffer has no room for it, writing would block the loop
+	if ((telemetryPeriod > 0) && (now - lastTelemetry >= telemetryPeriod) && (logger->availableForWrite() >= FRAME_TELEMETRY_LENGTH)) {
+		// keep the period, unless we are too late already
+		if (now - lastTelemetry < 2*telemetryPeriod)
+			lastTelemetry += telemetryPeriod;
+		else
+			lastTelemetry = now;
+		sendTelemetry(now);
+	}
+}
+
+// float as 4 bytes, little endian like the host
+void putFrameFloat(uint8_t* &p, float value) {
+	memcpy(p, &value, 4);
+	p += 4;
+}
+
+// emit one telemetry frame on the log port, see CommDef.h for the layout
+void HostCommunication::sendTelemetry(uint32_t now) {
+	if (!controller.isSetup())
+		return;
+
+	uint8_t telemetry[FRAME_TELEMETRY_PAYLOAD_LENGTH];
+	uint8_t* p = telemetry;
+	for (int i = 0;i<4;i++)
+		*p++ = (now >> (i*8)) & 0xFF;
+	for (int i = 0;i<MAX_ACTUATORS;i++) {
+		Actuator* actuator = controller.getActuator(i);
+		AngleMovementQueue<MOVEMENT_QUEUE_SIZE>& movement = actuator->getMovement();
+		float setpoint = movement.isNull()?actuator->getCurrentAngle():movement.getCurrentAngle(now);
+		float integral = 0;
+		float speed = 0;
+		int16_t torque = 0;
+		if (actuator->hasStepper()) {
+			integral = actuator->getStepper().getIntegral();
+			speed = actuator->getStepper().getStepsPerSecond();
+		}
+		if (actuator->hasServo())
+			torque = actuator->getServo().getTorque();
+
+		putFrameAngle(p, setpoint);
+		putFrameAngle(p, actuator->getCurrentAngle());
+		putFrameFloat(p, integral);
+		putFrameFloat(p, speed);
+		*p++ = torque & 0xFF;
+		*p++ = (torque >> 8) & 0xFF;
+	}
+	sendFrame(logger, CommDefType::TELEMETRY_CMD, telemetry, FRAME_TELEMETRY_PAYLOAD_LENGTH);
 }
 
 
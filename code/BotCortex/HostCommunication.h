@@ -21,7 +21,15 @@ public:
 	void setup();
 	void loop(uint32_t now);
 
+	// emit telemetry frames on the log port every period [ms], 0 switches it off
+	void setTelemetryPeriod(uint16_t period_ms) { telemetryPeriod = period_ms; };
+
 	SerialCommand sCmd;
+private:
+	void sendTelemetry(uint32_t now);
+
+	uint16_t telemetryPeriod = 0;
+	uint32_t lastTelemetry = 0;
 }; //HostCommunication
 
 #endif //__HOSTCOMMUNICATION_H__
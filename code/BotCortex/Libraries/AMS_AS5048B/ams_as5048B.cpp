@@ -27,16 +27,23 @@
     Constructor
 */
 /**************************************************************************/
+// states of the non-blocking request of the angle
+#define REQUEST_IDLE 0
+#define REQUEST_ADDRESSING 1
+#define REQUEST_READING 2
+
 AMS_AS5048B::AMS_AS5048B(void)
 {
 	_chipAddress = AS5048_ADDRESS;
 	_debugFlag = false;
+	_requestState = REQUEST_IDLE;
 }
 
 AMS_AS5048B::AMS_AS5048B(uint8_t chipAddress)
 {
 	_chipAddress = chipAddress;
 	_debugFlag = false;
+	_requestState = REQUEST_IDLE;
 }
 
 void AMS_AS5048B::setI2CAddress(uint8_t chipAddress)
@@ -319,6 +326,73 @@ double AMS_AS5048B::angleR(int unit = U_RAW, boolean newVal = true) {
 	return AMS_AS5048B::convertAngle(unit, angleRaw);
 }
 
+/**************************************************************************/
+/*!
+    @brief  starts reading the angle register by a non-blocking transmission,
+			isRequestDone() continues the request. The angle is returned
+			by angleR(unit, false) afterwards.
+
+    @params[in]
+				none
+	@returns
+				none
+*/
+/**************************************************************************/
+void AMS_AS5048B::requestAngle(void) {
+
+	_bus->beginTransmission(_chipAddress);
+	_bus->write(AS5048B_ANGLMSB_REG);
+	_bus->sendTransmission(I2C_NOSTOP);
+	_requestState = REQUEST_ADDRESSING;
+}
+
+/**************************************************************************/
+/*!
+    @brief  continues a request started by requestAngle() without waiting
+
+    @params[in]
+				none
+	@returns
+				true, if the angle has been received or the request failed,
+				endTransmissionStatus() tells which one
+*/
+/**************************************************************************/
+boolean AMS_AS5048B::isRequestDone(void) {
+
+	switch (_requestState) {
+		case REQUEST_ADDRESSING:
+			if (!_bus->done())
+				return false;
+			requestResult = _bus->getError();
+			if (requestResult != 0) {
+				_requestState = REQUEST_IDLE;
+				return true;
+			}
+			_bus->sendRequest(_chipAddress, (size_t)2, I2C_STOP);
+			_requestState = REQUEST_READING;
+			return false;
+		case REQUEST_READING: {
+			if (!_bus->done())
+				return false;
+			requestResult = _bus->getError();
+			if ((requestResult == 0) && (_bus->available() < 2))
+				requestResult = 4;
+			if (requestResult == 0) {
+				byte readArray0 = _bus->read();
+				byte readArray1 = _bus->read();
+				uint16_t readValue = (((uint16_t) readArray0) << 6) + (readArray1 & 0x3F);
+				if (_clockWise)
+					readValue = 0b11111111111111 - readValue;
+				_lastAngleRaw = (double) readValue;
+			}
+			_requestState = REQUEST_IDLE;
+			return true;
+		}
+		default:
+			return true;
+	}
+}
+
 /**************************************************************************/
 /*!
     @brief  Performs an exponential moving average on the angle.
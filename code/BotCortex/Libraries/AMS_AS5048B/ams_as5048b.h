@@ -119,6 +119,8 @@ class AMS_AS5048B {
 	uint8_t		diagR(void); //read diagnostic register
 	uint16_t	magnitudeR(void); //read current mangnitude
 	double		angleR(int unit, boolean newVal); //Read current angle or get last measure with unit conversion : RAW, TRN, DEG, RAD, GRAD, MOA, SOA, MILNATO, MILSE, MILRU
+	void		requestAngle(void); //start reading the angle without waiting for the bus
+	boolean		isRequestDone(void); //continue the request, true when the angle has been received or the request failed
 	uint8_t		getAutoGain(void);
 	uint8_t		getDiagReg(void);
 
@@ -142,6 +144,7 @@ class AMS_AS5048B {
 	int			_movingAvgCountLoop;
 	i2c_t3*		_bus;
 	byte requestResult;
+	uint8_t		_requestState; //state of non-blocking request of the angle
 
 	//methods
 	uint8_t		readReg8(uint8_t address);
@@ -543,8 +543,14 @@ void HerkulexClass::setLed(int servoID, int valueLed)
 
 // get the speed for one servo - values between -1023 <--> 1023
 int HerkulexClass::getPWM(int servoID) {
-  int speedy  = 0;
+  clearBuffer();
+  requestPWM(servoID);
+  delay(2);
+  return readPWM();
+}
 
+// send the request of the PWM register without clearing the buffer or waiting for the reply
+void HerkulexClass::requestPWM(int servoID) {
   pSize = 0x09;               // 3.Packet size 7-58
   pID   = servoID;     	   	  // 4. Servo ID 
   cmd   = HRAMREAD;           // 5. CMD
@@ -566,11 +572,19 @@ int HerkulexClass::getPWM(int servoID) {
   dataEx[7] = data[0]; 	    // Address  
   dataEx[8] = data[1]; 		// Length
 
-  sendData(dataEx, pSize);
+  serial->write(dataEx, pSize);
+}
 
-  delay(1);
-  readData(13);
+// true if a reply of that size is in the serial buffer
+bool HerkulexClass::isReplyAvailable(int size) {
+  return serial->available() >= size;
+}
+
+// parse the reply of requestPWM
+int HerkulexClass::readPWM() {
+  int speedy  = 0;
 
+  readData(HERKULEX_REGISTER_REPLY_SIZE);
 
   pSize = dataEx[2];           // 3.Packet size 7-58
   pID   = dataEx[3];           // 4. Servo ID
@@ -855,9 +869,9 @@ void HerkulexClass::readData(int size)
        		delay(1);
 	}      	
 	while (serial->available() > 0){
-     		byte inchar = (byte)Serial1.read();
+     		byte inchar = (byte)serial->read();
 		//printHexByte(inchar);
-       	if ( (inchar == 0xFF) & ((byte)Serial1.peek() == 0xFF) ){
+       	if ( (inchar == 0xFF) & ((byte)serial->peek() == 0xFF) ){
 					beginsave=1;
 					i=0; 						
             }
@@ -52,6 +52,7 @@
 #define DATA_SIZE	 30		// buffer for input data
 #define DATA_MOVE  	 50		// max 10 servos <---- change this for more servos!
 #define TIME_OUT     5   	//timeout serial communication
+#define HERKULEX_REGISTER_REPLY_SIZE 13	// size of the reply when reading a two byte register
 
 // SERVO HERKULEX COMMAND - See Manual p40
 #define HEEPWRITE    0x01 	//Rom write
@@ -113,6 +114,12 @@ public:
   int   getPosition(int servoID);
   float getAngle(int servoID);
   int   getPWM(int servoID);
+
+  // non-blocking variant of getPWM: requestPWM sends the request without waiting,
+  // once isReplyAvailable is true, readPWM returns the value
+  void  requestPWM(int servoID);
+  bool  isReplyAvailable(int size);
+  int   readPWM();
   		
   void  reboot(int servoID);
   void  setLed(int servoID, int valueLed);
@@ -11,6 +11,7 @@
 #define __MOTOR_BASE_H__
 
 #include "Space.h"
+#include "CommDef.h"
 
 class MotorBase {
 	public:
@@ -21,13 +22,14 @@ class MotorBase {
 	// the following methods are redefined in GearedStepperDrive and HerkulexServoDrive
 	virtual void setAngle(float pAngle,uint32_t pAngleTargetDuration_ms) = 0;
 	virtual void changeAngle(float pAngleChange,uint32_t pAngleTargetDuration_ms) = 0;
+	virtual bool queueAngle(float pAngle,uint32_t pAngleTargetDuration_ms) = 0;
 	virtual void loop(uint32_t now_ms) = 0;
 	virtual float getCurrentAngle() = 0;
 	virtual void enable() = 0;
 	virtual void disable() = 0;
 	virtual bool isEnabled() = 0;
 	
-	AngleMovement movement;
+	AngleMovementQueue<MOVEMENT_QUEUE_SIZE> movement;
 };
 
 
@@ -3,6 +3,8 @@
 #include "BotMemory.h"
 #include "utilities.h"
 
+RotaryEncoder* RotaryEncoder::busOwner[2] = { NULL, NULL };
+
 void RotaryEncoder::setup(ActuatorConfiguration* pActuatorConfig, RotaryEncoderConfig* pConfigData, RotaryEncoderSetupData* pSetupData)
 {
 	configData = pConfigData;
@@ -83,8 +85,37 @@ float RotaryEncoder::getLastRawSensorAngle() {
 	return currentSensorAngle;
 }
 
+// a non-blocking transfer of another encoder on the same bus has to be done before
+void RotaryEncoder::waitForBus() {
+	RotaryEncoder* owner = busOwner[setupData->I2CBusNo];
+	while ((owner != NULL) && !owner->isReadingDone())
+		yield();
+}
+
 bool RotaryEncoder::readNewAngleFromSensor() {
-	float rawAngle = sensor.angleR(U_DEG, true); // returns angle between 0..360
+	waitForBus();
+	return setRawSensorAngle(sensor.angleR(U_DEG, true)); // returns angle between 0..360
+}
+
+void RotaryEncoder::startReading() {
+	waitForBus();
+	busOwner[setupData->I2CBusNo] = this;
+	sensor.requestAngle();
+}
+
+bool RotaryEncoder::isReadingDone() {
+	if (!sensor.isRequestDone())
+		return false;
+	if (busOwner[setupData->I2CBusNo] == this)
+		busOwner[setupData->I2CBusNo] = NULL;
+	return true;
+}
+
+bool RotaryEncoder::finishReading() {
+	return setRawSensorAngle(sensor.angleR(U_DEG, false));
+}
+
+bool RotaryEncoder::setRawSensorAngle(float rawAngle) {
 	float nulledRawAngle = rawAngle - getNullAngle();
 	if (nulledRawAngle> 180.0)
 		nulledRawAngle -= 360.0;
@@ -101,29 +132,15 @@ bool RotaryEncoder::readNewAngleFromSensor() {
 	} else {
 		failedReadingCounter = 0;
 	}
-	
-	// apply first order low pass to filter sensor noise
-	if (filterAngle) {
-		uint32_t now = millis();
-		float duration_s = float(now - lastSensorRead) * (1.0/1000.0);
-		lastSensorRead = now;
-
-		const float reponseTime = float(ENCODER_FILTER_RESPONSE_TIME)/1000.0;	// signal changes shorter than 2 samples are filtered out
-		float complementaryFilter = reponseTime/(reponseTime + duration_s);
-		float antiComplementaryFilter = 1.0 - complementaryFilter;
-		currentSensorAngle = antiComplementaryFilter*nulledRawAngle + complementaryFilter*currentSensorAngle;
-	}
-	else {
-		currentSensorAngle = nulledRawAngle;
-	}
+
+	// noise is filtered by the stepper's estimator, which knows the steps done in between
+	currentSensorAngle = nulledRawAngle;
 
 	return true;
 }
 
 
 bool RotaryEncoder::fetchSample(uint8_t no, float sample[], float& avr, float &variance) {
-	avr = 0.;
-	filterAngle = false;
 	avr = 0;
 	for (int check = 0;check<no;check++) {
 		if (check > 0) {
@@ -135,7 +152,6 @@ bool RotaryEncoder::fetchSample(uint8_t no, float sample[], float& avr, float &v
 		sample[check] = x;
 		avr += x;
 	}
-	filterAngle = true;
 
 	avr = avr/float(no);
 	// compute average and variance, and check if values are reasonable;
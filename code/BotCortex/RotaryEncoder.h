@@ -48,6 +48,13 @@ public:
 	// fetch new angle from sensor
 	bool readNewAngleFromSensor();
 
+	// fetch new angle from sensor without waiting for the i2c bus: startReading kicks off
+	// the transfer, isReadingDone continues it until it is done, then finishReading
+	// takes the angle like readNewAngleFromSensor.
+	void startReading();
+	bool isReadingDone();
+	bool finishReading();
+
 	// fetch a couple of samples and compute variance (used to check if sensor works ok)
 	bool fetchSample(float& avr, float& variance);
 
@@ -73,9 +80,14 @@ public:
 
 	uint8_t i2CAddress() {	return setupData->I2CAddress;}
 	i2c_t3* i2CBus() {	return Wires[setupData->I2CBusNo];}
+	uint8_t i2CBusNo() { return setupData->I2CBusNo;}
 
 private:
 	bool fetchSample(uint8_t no, float sample[], float& avr, float& variance);
+	bool setRawSensorAngle(float rawAngle);
+	void waitForBus();
+
+	static RotaryEncoder* busOwner[2];	// encoder whose non-blocking transfer is running on the bus
 	bool isClockwise() {return setupData->clockwise;}
 
 	AMS_AS5048B sensor;
@@ -86,8 +98,6 @@ private:
 	bool passedCheck;
 	bool communicationWorks;
 	uint8_t failedReadingCounter;
-	uint32_t lastSensorRead = 0;
-	bool filterAngle = true;
 }; //RotaryEncode
 
 #endif //__ROTARYENCODE_H__
@@ -0,0 +1,127 @@
+/*
+* StepGenerator.cpp
+*
+* Author: JochenAlt
+*/
+
+#include "StepGenerator.h"
+
+StepGenerator stepGenerator;
+
+void stepGeneratorISR() {
+	stepGenerator.tick();
+}
+
+StepGenerator::StepGenerator() {
+	numberOfChannels = 0;
+}
+
+void StepGenerator::setup() {
+#if STEPPER_ISR_TICK_US > 0
+	timer.begin(stepGeneratorISR, STEPPER_ISR_TICK_US);
+	timer.priority(64); // above i2c and serial, impulses must not wait for communication
+#endif
+}
+
+uint8_t StepGenerator::attach(uint8_t clockPin, uint8_t directionPin, uint8_t forwardLevel) {
+	// setup is called again with each SETUP command, reuse the channel of the same stepper
+	uint8_t channel = 0;
+	while ((channel < numberOfChannels) && (channels[channel].clockPin != clockPin))
+		channel++;
+
+	noInterrupts();
+	Channel& c = channels[channel];
+	c.clockPin = clockPin;
+	c.directionPin = directionPin;
+	c.forwardLevel = forwardLevel;
+	c.forward = true;
+	c.directionPinForward = true;
+	c.clockHigh = false;
+	c.steps = 0;
+	c.ticks = 0;
+	c.ticksToGo = 0;
+	c.error = 0;
+	c.planned = false;
+	digitalWriteFast(clockPin, LOW);
+	digitalWriteFast(directionPin, forwardLevel);
+	if (channel == numberOfChannels)
+		numberOfChannels++;
+	interrupts();
+
+	return channel;
+}
+
+void StepGenerator::plan(uint8_t channel, int32_t steps, uint32_t duration_ms) {
+#if STEPPER_ISR_TICK_US > 0
+	Channel& c = channels[channel];
+	uint32_t ticks = max(duration_ms*1000/STEPPER_ISR_TICK_US, 2U);
+	c.plannedForward = (steps >= 0);
+	c.plannedSteps = min((uint32_t)abs(steps), ticks/2);
+	c.plannedTicks = ticks;
+	c.planned = true;
+#endif
+}
+
+void StepGenerator::start() {
+	noInterrupts();
+	for (uint8_t i = 0;i<numberOfChannels;i++) {
+		Channel& c = channels[i];
+		if (c.planned) {
+			// a running movement keeps its phase, a new one has its steps in the middle of their slot
+			if ((c.ticksToGo == 0) || (c.forward != c.plannedForward) || (c.ticks != c.plannedTicks))
+				c.error = c.plannedTicks/2;
+			c.forward = c.plannedForward;
+			c.steps = c.plannedSteps;
+			c.ticks = c.plannedTicks;
+			// a late next segment should not lead to a gap, so keep on going for another sample
+			c.ticksToGo = (c.steps > 0)?2*c.ticks:0;
+			c.planned = false;
+		}
+	}
+	interrupts();
+}
+
+void StepGenerator::stop(uint8_t channel) {
+	noInterrupts();
+	channels[channel].ticksToGo = 0;
+	channels[channel].planned = false;
+	interrupts();
+}
+
+// runs every STEPPER_ISR_TICK_US, keep it short
+void StepGenerator::tick() {
+#if STEPPER_ISR_TICK_US > 0
+	for (uint8_t i = 0;i<numberOfChannels;i++) {
+		Channel& c = channels[i];
+
+		// end the impulse of the previous tick
+		if (c.clockHigh) {
+			digitalWriteFast(c.clockPin, LOW);
+			c.clockHigh = false;
+		}
+
+		if (c.ticksToGo == 0)
+			continue;
+
+		// change the direction one tick ahead of the impulse to give the driver its setup time
+		if (c.forward != c.directionPinForward) {
+			digitalWriteFast(c.directionPin, c.forward?c.forwardLevel:!c.forwardLevel);
+			c.directionPinForward = c.forward;
+			continue;
+		}
+
+		// since steps <= ticks/2, there is always a tick without step in between
+		c.ticksToGo--;
+		c.error += c.steps;
+		if (c.error >= c.ticks) {
+			c.error -= c.ticks;
+			digitalWriteFast(c.clockPin, HIGH);
+			c.clockHigh = true;
+			if (c.forward)
+				c.position++;
+			else
+				c.position--;
+		}
+	}
+#endif
+}
@@ -0,0 +1,78 @@
+/*
+* StepGenerator.h
+*
+* Generates the impulses of all steppers in a timer interrupt every STEPPER_ISR_TICK_US.
+* The PI controller of each stepper plans the number of steps of the next sample, the steps
+* are distributed evenly over the sample's ticks by Bresenham's algorithm, i.e. with integer
+* arithmetics only. Segments planned in the same loop are started with the same tick, so
+* the axes move synchronously.
+* A step raises the clock pin and the next tick drops it again, so there is no busy waiting
+* for the pulse width, and impulses continue while the loop is busy with serial or i2c
+* communication.
+*
+* Author: JochenAlt
+*/
+
+#ifndef __STEPGENERATOR_H__
+#define __STEPGENERATOR_H__
+
+#include "Arduino.h"
+#include "Config.h"
+
+class StepGenerator {
+public:
+	StepGenerator();
+
+	// start the timer interrupt
+	void setup();
+
+	// assign a channel to the stepper with that clock pin. forwardLevel is the
+	// direction pin's level when going forward. Returns the channel.
+	uint8_t attach(uint8_t clockPin, uint8_t directionPin, uint8_t forwardLevel);
+
+	// plan the steps (negative is backwards) to be done within the next duration_ms.
+	// Segment becomes active with start(), at most one step every other tick.
+	void plan(uint8_t channel, int32_t steps, uint32_t duration_ms);
+
+	// start all planned segments with the same tick
+	void start();
+
+	// stop the channel immediately
+	void stop(uint8_t channel);
+
+	// steps forward minus steps backward done by the interrupt
+	int32_t getPosition(uint8_t channel) { return channels[channel].position; };
+
+	// called by the timer interrupt
+	void tick();
+private:
+	struct Channel {
+		uint8_t clockPin;
+		uint8_t directionPin;
+		uint8_t forwardLevel;
+		bool forward;						// to-be direction
+		bool directionPinForward;			// direction the pin is set to
+		bool clockHigh;						// impulse is going on and ends with next tick
+
+		// current segment, steps <= ticks/2
+		uint32_t steps;
+		uint32_t ticks;
+		uint32_t ticksToGo;
+		uint32_t error;						// Bresenham's error term
+		volatile int32_t position;
+
+		// segment that is started by start()
+		bool planned;
+		bool plannedForward;
+		uint32_t plannedSteps;
+		uint32_t plannedTicks;
+	};
+
+	Channel channels[MAX_STEPPERS];
+	volatile uint8_t numberOfChannels;
+	IntervalTimer timer;
+};
+
+extern StepGenerator stepGenerator;
+
+#endif
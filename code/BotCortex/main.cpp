@@ -9,11 +9,13 @@
 #include <pins.h>
 #include "hostCommunication.h"
 #include "Controller.h"
+#include "StepGenerator.h"
 #include "BotMemory.h"
 #include "AMS_AS5048B.h"
 #include "core.h"
 #include "LightsController.h"
 #include "Printer.h"
+#include "Profiler.h"
 
 // global variables declared in pins.h
 HardwareSerial* cmdSerial = &Serial5; 		// UART used to communicate with Cerebellum
@@ -21,6 +23,9 @@ HardwareSerial* logger = &Serial4;			// UART used to log
 HardwareSerial* servoComm = &Serial1;		// UART used to communicate with the HerkuleX servos
 HardwareSerial* printerComm = &Serial6;		// UART used to control the thermal printer
 
+static uint8_t cmdRxBuffer[COMMAND_RX_BUFFER_SIZE];	// enlarges the receive buffer of cmdSerial
+static uint8_t logTxBuffer[LOGGER_TX_BUFFER_SIZE];	// enlarges the transmit buffer of logger
+
 // rotary encoders are connected via I2C
 i2c_t3* Wires[2] = { &Wire, &Wire1 };		// we have two I2C buses due to conflicting sensor addresses
 
@@ -49,6 +54,10 @@ void setLEDPattern() {
 
 // emergency method, that resets the I2C bus in case something went wrong (i.e. arbitration lost)
 void resetI2CWhenNecessary(int ic2no) {
+	// a running non-blocking transfer is fine, it ends with an error status if it times out
+	if (!Wires[ic2no]->done())
+		return;
+
 	if (Wires[ic2no]->status() != I2C_WAITING) {
 		logger->println();
 
@@ -192,12 +201,16 @@ void setup() {
 		digitalWrite(stepperSetup[i].enablePIN, LOW);
 	}
 
-	// establish serial output and say hello
+	// establish serial output and say hello. The core's receive buffer of 64 bytes holds
+	// one MOVETO only, so commands coming in while the loop is busy would get lost
 	cmdSerial->begin(CORTEX_COMMAND_BAUD_RATE);
+	cmdSerial->addMemoryForRead(cmdRxBuffer, sizeof(cmdRxBuffer));
 	cmdSerial->println("WALTER's Cortex");
 
-	// establish logging output
+	// establish logging output. The core's transmit buffer of 40 bytes would let each telemetry
+	// frame block the loop for several ms
 	logger->begin(CORTEX_LOGGER_BAUD_RATE);
+	logger->addMemoryForWrite(logTxBuffer, sizeof(logTxBuffer));
 	logger->println("--- logging ---");
 
 	resetI2CWhenNecessary(0);	// check if I2c bus is fine. Restart if not.
@@ -217,7 +230,9 @@ void setup() {
 	hostComm.setup();
 	memory.setup();
 
+	stepGenerator.setup();
 	controller.setup();
+	profiler.setup();
 
 	setWatchdogTimeout(2000);
 
@@ -235,11 +250,23 @@ void setup() {
 void loop() {
 	watchdogReset();
 	uint32_t now = millis();
+	profiler.loop(now);			// report of the profiler, not part of the measured loop
+
+	ProfileScope loopScope(PROFILE_LOOP);
 	ledBlinker.loop(now);    	// LED on Teensy board
-	hostComm.loop(now);			// wait for commands via serial interface
+	{
+		ProfileScope scope(PROFILE_HOSTCOMM);
+		hostComm.loop(now);		// wait for commands via serial interface
+	}
 	memory.loop(now);			// check if something has to be written to EEPROM
-	controller.loop(millis());	// run the actuators
-	lights.loop(now);			// run the lights console
+	{
+		ProfileScope scope(PROFILE_CONTROLLER);
+		controller.loop(millis());	// run the actuators
+	}
+	{
+		ProfileScope scope(PROFILE_LIGHTS);
+		lights.loop(now);		// run the lights console
+	}
 
 	if (controller.isSetup()) {
 		resetI2CWhenNecessary(0);	// check if I2c bus is fine. Restart if not.
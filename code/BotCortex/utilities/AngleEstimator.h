@@ -0,0 +1,56 @@
+/*
+ * AngleEstimator.h
+ *
+ * Alpha-beta estimator of a stepper joint's angle and speed. The prediction is the angle
+ * the stepper moved by its counted steps since the last measurement, so unlike a low pass
+ * the estimate has no phase lag when the joint moves fast. The encoder's measurement
+ * corrects the prediction by alpha, beta tracks the difference between the commanded
+ * and the real speed (lost steps, elasticity of the gear).
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef ANGLEESTIMATOR_H_
+#define ANGLEESTIMATOR_H_
+
+class AngleEstimator {
+	public:
+	AngleEstimator() {
+		reset(0);
+	}
+
+	void reset(float pAngle) {
+		angle = pAngle;
+		speed = 0;
+		drift = 0;
+	}
+
+	// fuse a measured angle with the angle done by steps within the passed dT [s]
+	float update(float measuredAngle, float stepAngle, float dT, float alpha, float beta) {
+		if (dT <= 0)
+			return angle;
+		float predictedAngle = angle + stepAngle + drift*dT;
+		float residual = measuredAngle - predictedAngle;
+		angle = predictedAngle + alpha*residual;
+		drift += beta*residual/dT;
+		speed = stepAngle/dT + drift;
+		return angle;
+	}
+
+	// estimated angle []
+	float getAngle() {
+		return angle;
+	}
+
+	// estimated speed [/s]
+	float getSpeed() {
+		return speed;
+	}
+
+	private:
+	float angle;
+	float speed;
+	float drift;		// real speed minus speed of the steps [/s]
+};
+
+#endif /* ANGLEESTIMATOR_H_ */
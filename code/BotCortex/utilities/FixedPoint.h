@@ -0,0 +1,59 @@
+/*
+ * FixedPoint.h
+ *
+ * Q16.16 fixed point numbers used by the closed loop of the steppers instead of float.
+ * Angles are in [°], steps in [microsteps], both are far below the range of 32768.
+ * Multiplication saturates instead of overflowing. Results are rounded, truncation would let
+ * the integral of the controller drift away from the float variant.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef FIXEDPOINT_H_
+#define FIXEDPOINT_H_
+
+#include "Arduino.h"
+
+typedef int32_t fixed_t;
+
+#define FIXED_ONE 65536
+#define FIXED_MAX ((fixed_t)0x7FFFFFFF)
+#define FIXED_MIN (-FIXED_MAX-1)
+
+inline fixed_t floatToFixed(float x) {
+	float scaled = x*float(FIXED_ONE);
+	if (scaled >= float(FIXED_MAX))
+		return FIXED_MAX;
+	if (scaled <= float(FIXED_MIN))
+		return FIXED_MIN;
+	return (fixed_t)(scaled + ((x >= 0)?0.5:-0.5));
+}
+
+inline float fixedToFloat(fixed_t x) {
+	return float(x)*(1.0/float(FIXED_ONE));
+}
+
+inline fixed_t intToFixed(int32_t x) {
+	return x*FIXED_ONE;
+}
+
+// integer part, rounded towards zero like a cast of a float
+inline int32_t fixedToInt(fixed_t x) {
+	return x/FIXED_ONE;
+}
+
+inline fixed_t fixedMul(fixed_t a, fixed_t b) {
+	int64_t product = ((int64_t)a*b + (FIXED_ONE/2)) >> 16;
+	if (product > FIXED_MAX)
+		return FIXED_MAX;
+	if (product < FIXED_MIN)
+		return FIXED_MIN;
+	return (fixed_t)product;
+}
+
+// ratio a/b of two positive integers as Q16.16
+inline fixed_t fixedRatio(int32_t a, int32_t b) {
+	return (fixed_t)((((int64_t)a << 16) + b/2)/b);
+}
+
+#endif /* FIXEDPOINT_H_ */
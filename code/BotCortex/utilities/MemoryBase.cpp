@@ -10,7 +10,7 @@
 #include "EEPROM.h"
 #include "utilities.h"
 
-#define EEMEM_MAGICNUMBER 1583 					// thats my birthday, used to check if eeprom has been initialized
+#define EEMEM_MAGICNUMBER 1584 					// my birthday plus the number of layout changes, used to check if eeprom has been initialized with the current layout
 void* magicMemoryNumberAddress = (void*)0;  	// my birthday is stored at this address
 void* memoryAddress = (void*)sizeof(int16_t);	// address of user-defined EEPROM area
 
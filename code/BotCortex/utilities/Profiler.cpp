@@ -0,0 +1,115 @@
+/*
+ * Profiler.cpp
+ *
+ * Author: JochenAlt
+ */
+
+#include "Profiler.h"
+#include "utilities.h"
+
+#ifdef ARM_DWT_CYCCNT
+// cycle counter of the Cortex-M4's debug unit, started in setup
+static uint32_t defaultClock() {
+	return ARM_DWT_CYCCNT;
+}
+#define DEFAULT_TICKS_PER_US (F_CPU/1000000)
+#else
+#include <time.h>
+static uint32_t defaultClock() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint32_t)t.tv_sec*1000000000UL + t.tv_nsec;
+}
+#define DEFAULT_TICKS_PER_US 1000
+#endif
+
+Profiler profiler;
+
+Profiler::Profiler() {
+	clock = defaultClock;
+	ticksPerUs = DEFAULT_TICKS_PER_US;
+	enabled = false;
+	reportSection = NumberOfProfileSections;
+	reportTime = 0;
+	reset();
+}
+
+void Profiler::setup() {
+#ifdef ARM_DWT_CYCCNT
+	ARM_DEMCR |= ARM_DEMCR_TRCENA;
+	ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+}
+
+void Profiler::setClock(ProfilerClock pClock, uint32_t pTicksPerUs) {
+	clock = pClock;
+	ticksPerUs = pTicksPerUs;
+	reset();
+}
+
+void Profiler::enable(bool onOff) {
+	reset();
+	reportSection = NumberOfProfileSections;
+	reportTime = millis();
+	enabled = onOff;
+}
+
+void Profiler::reset() {
+	memset(current, 0, sizeof(current));
+}
+
+void Profiler::add(ProfileSection section, uint32_t ticks) {
+	Statistics& stat = current[section];
+	if ((stat.count == 0) || (ticks < stat.min))
+		stat.min = ticks;
+	if (ticks > stat.max)
+		stat.max = ticks;
+	stat.sum += ticks;
+	stat.count++;
+
+	// bin is the number of binary digits of the duration in [us]
+	uint32_t us = ticks/ticksPerUs;
+	int bin = (us == 0)?0:min(32-__builtin_clz(us), PROFILE_HISTOGRAM_BINS-1);
+	stat.histogram[bin]++;
+}
+
+void Profiler::loop(uint32_t now) {
+	if (!enabled)
+		return;
+
+	if (reportSection < NumberOfProfileSections) {
+		if (logger->availableForWrite() < PROFILE_LINE_LENGTH)
+			return;
+		print((ProfileSection)reportSection, report[reportSection]);
+		reportSection++;
+		return;
+	}
+
+	if (now - reportTime >= PROFILE_REPORT_PERIOD) {
+		reportTime = now;
+		memcpy(report, current, sizeof(report));
+		reset();
+		reportSection = 0;
+	}
+}
+
+void Profiler::print(ProfileSection section, const Statistics& stat) {
+	float us = 1.0/float(ticksPerUs);
+	logger->print(F(PROFILE_LOG_PREFIX));
+	logger->print(profileSectionName[section]);
+	logger->print(F(" n="));
+	logger->print(stat.count);
+	logger->print(F(" min="));
+	logger->print(stat.min*us,1);
+	logger->print(F(" avg="));
+	logger->print((stat.count > 0)?float(stat.sum)/float(stat.count)*us:0.0,1);
+	logger->print(F(" max="));
+	logger->print(stat.max*us,1);
+	logger->print(F(" hist="));
+	for (int i = 0;i<PROFILE_HISTOGRAM_BINS;i++) {
+		if (i > 0)
+			logger->print(',');
+		logger->print(stat.histogram[i]);
+	}
+	logger->println();
+}
@@ -0,0 +1,87 @@
+/*
+ * Profiler.h
+ *
+ * Measures how long the sections of the loop take. A ProfileScope measures from its declaration
+ * until the end of its block, the profiler keeps count, min, max, average and a histogram per section
+ * and reports them on the log port in the format described in CommDef.h. Switched on by LOG profile on,
+ * when off, a scope costs the check of a flag only.
+ * The clock is pluggable, default is the cycle counter on the Teensy and clock_gettime on a host.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "Arduino.h"
+#include "CommDef.h"
+
+// a report line is written only if the log UART's transmit buffer has that much room, so it does not block the loop.
+// Usual lines have 80-90 bytes
+#define PROFILE_LINE_LENGTH 128
+
+// returns ticks of a free running counter, wrapping around is fine as long as a section is shorter
+typedef uint32_t (*ProfilerClock)();
+
+class Profiler {
+public:
+	Profiler();
+
+	// start the cycle counter
+	void setup();
+
+	void setClock(ProfilerClock clock, uint32_t ticksPerUs);
+	uint32_t ticks() { return (*clock)(); };
+
+	// switching on starts with empty statistics
+	void enable(bool onOff);
+	bool isEnabled() { return enabled; };
+
+	// add the duration of one pass of a section
+	void add(ProfileSection section, uint32_t ticks);
+
+	// every PROFILE_REPORT_PERIOD the statistics are taken over into a report and start anew.
+	// The report is written one section per call, once the log UART has room for it
+	void loop(uint32_t now);
+private:
+	struct Statistics {
+		uint32_t count;
+		uint32_t min;					// [ticks]
+		uint32_t max;					// [ticks]
+		uint64_t sum;					// [ticks]
+		uint32_t histogram[PROFILE_HISTOGRAM_BINS];
+	};
+	void reset();
+	void print(ProfileSection section, const Statistics& stat);
+
+	ProfilerClock clock;
+	uint32_t ticksPerUs;
+	bool enabled;
+	Statistics current[NumberOfProfileSections];
+	Statistics report[NumberOfProfileSections];
+	uint8_t reportSection;				// section to be written next, NumberOfProfileSections if report is done
+	uint32_t reportTime;				// [ms] time of the latest report
+};
+
+extern Profiler profiler;
+
+// measures the block it is declared in
+class ProfileScope {
+public:
+	ProfileScope(ProfileSection pSection) {
+		section = pSection;
+		active = profiler.isEnabled();
+		if (active)
+			start = profiler.ticks();
+	}
+	~ProfileScope() {
+		if (active)
+			profiler.add(section, profiler.ticks() - start);
+	}
+private:
+	ProfileSection section;
+	bool active;
+	uint32_t start;
+};
+
+#endif /* PROFILER_H_ */
@@ -40,17 +40,78 @@ SerialCommand::SerialCommand()
   : commandList(NULL),
     commandCount(0),
     defaultHandler(NULL),
-    term('\r'),           // default terminator for commands, newline character
-    last(NULL),
-	savelast(NULL)
+    binaryHandler(NULL),
+    term('\r')           // default terminator for commands, newline character
 {
 	withChecksum = false;
-	strcpy(delim, " "); // strtok_r needs a null-terminated string
+	withCRC = false;
+	lineCRC = 0;
+	withBinaryFrames = false;
+	frameState = NO_FRAME;
+	framePos = 0;
+	useSequenceNumbers(false);
+	for (int i = 0;i<SERIALCOMMAND_HASHSIZE;i++)
+		commandHash[i] = -1;
+	tokenCount = 0;
+	tokenPos = 0;
+	lastTokenPos = 0;
 	clearBuffer();
 }
 
-void SerialCommand::useChecksum(bool really) {
+void SerialCommand::useChecksum(bool really, bool crc) {
 	withChecksum = really;
+	withCRC = really && crc;
+}
+
+void SerialCommand::useBinaryFrames(bool really) {
+	withBinaryFrames = really;
+	frameState = NO_FRAME;
+}
+
+// switching on forgets all previous commands, since the host starts numbering anew
+void SerialCommand::useSequenceNumbers(bool really) {
+	withSequenceNumbers = really;
+	seqNo = 0;
+	idempotentCommand = true;
+	repetition = false;
+	for (int i = 0;i<SEQUENCE_HISTORY;i++)
+		historySeqNo[i] = 0;
+	historyPos = 0;
+}
+
+// true, if the current command has been executed already and must not be executed again
+bool SerialCommand::isNewCommand() {
+	repetition = false;
+	if ((seqNo == 0) || idempotentCommand)
+		return true;
+	for (int i = 0;i<SEQUENCE_HISTORY;i++) {
+		if (historySeqNo[i] == seqNo) {
+			repetition = true;
+			repeatedResult = historyResult[i];
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SerialCommand::isRepetition(uint8_t &result) {
+	result = repeatedResult;
+	return repetition;
+}
+
+// remember the result of the current command in case the host repeats it
+void SerialCommand::storeResult(uint8_t result) {
+	if (seqNo == 0)
+		return;
+	for (int i = 0;i<SEQUENCE_HISTORY;i++) {
+		if (historySeqNo[i] == seqNo) {
+			historyResult[i] = result;
+			return;
+		}
+	}
+	historySeqNo[historyPos] = seqNo;
+	historyResult[historyPos] = result;
+	historyPos = (historyPos + 1) % SEQUENCE_HISTORY;
 }
 
 /**
@@ -58,7 +119,7 @@ void SerialCommand::useChecksum(bool really) {
  * This is used for matching a found token in the buffer, and gives the pointer
  * to the handler function to deal with it.
  */
-void SerialCommand::addCommand(const char *command, void (*function)()) {
+void SerialCommand::addCommand(const char *command, void (*function)(), bool idempotent) {
   #ifdef SERIALCOMMAND_DEBUG
     cmdSerial->print("Adding command (");
     cmdSerial->print(commandCount);
@@ -66,12 +127,79 @@ void SerialCommand::addCommand(const char *command, void (*function)()) {
     cmdSerial->println(command);
   #endif
 
+  // keep a free slot in the hash table, otherwise lookup would not terminate
+  if (commandCount >= SERIALCOMMAND_HASHSIZE-1)
+	  return;
+
   commandList = (SerialCommandCallback *) realloc(commandList, (commandCount + 1) * sizeof(SerialCommandCallback));
   strncpy(commandList[commandCount].command, command, SERIALCOMMAND_MAXCOMMANDLENGTH);
+  commandList[commandCount].command[SERIALCOMMAND_MAXCOMMANDLENGTH] = '\0';
   commandList[commandCount].function = function;
+  commandList[commandCount].idempotent = idempotent;
+
+  // open addressing with linear probing
+  uint8_t slot = hashCommand(command);
+  while (commandHash[slot] >= 0)
+	  slot = (slot + 1) & (SERIALCOMMAND_HASHSIZE-1);
+  commandHash[slot] = commandCount;
   commandCount++;
 }
 
+// case insensitive hash * 33 + c over the significant characters of a command
+uint8_t SerialCommand::hashCommand(const char* command) {
+	uint16_t hash = 5381;
+	for (int i = 0;(i<SERIALCOMMAND_MAXCOMMANDLENGTH) && (command[i] != '\0');i++)
+		hash = ((hash << 5) + hash) + tolower(command[i]);
+	return hash & (SERIALCOMMAND_HASHSIZE-1);
+}
+
+// index of the command in commandList, -1 if unknown
+int SerialCommand::findCommand(const char* command) {
+	uint8_t slot = hashCommand(command);
+	while (commandHash[slot] >= 0) {
+		int idx = commandHash[slot];
+		if (strncasecmp(command, commandList[idx].command, SERIALCOMMAND_MAXCOMMANDLENGTH) == 0)
+			return idx;
+		slot = (slot + 1) & (SERIALCOMMAND_HASHSIZE-1);
+	}
+	return -1;
+}
+
+// split the line at its blanks in one pass, named parameters get their value right away.
+// The checksum covers all tokens but a trailing chk=, same as the host computes it.
+void SerialCommand::tokenize() {
+	tokenCount = 0;
+	tokenPos = 0;
+	lastTokenPos = 0;
+	char* p = buffer;
+	while (tokenCount < SERIALCOMMAND_MAXTOKENS) {
+		while (*p == ' ')
+			p++;
+		if (*p == '\0')
+			break;
+		Token& token = tokens[tokenCount++];
+		token.str = p;
+		token.value = NULL;
+		token.nameLength = 0;
+		while ((*p != ' ') && (*p != '\0')) {
+			if ((*p == '=') && (token.value == NULL)) {
+				token.nameLength = p - token.str;
+				token.value = p+1;
+			}
+			p++;
+		}
+		if (*p != '\0')
+			*p++ = '\0';
+	}
+
+	checksum = 0;
+	uint8_t hashedTokens = tokenCount;
+	if ((hashedTokens > 0) && (tokens[hashedTokens-1].nameLength == 3) && (strncasecmp(tokens[hashedTokens-1].str, "chk", 3) == 0))
+		hashedTokens--;
+	for (int i = 0;i<hashedTokens;i++)
+		computeChecksum(tokens[i].str, checksum);
+}
+
 /**
  * This sets up a handler to be called in the event that the receveived command string
  * isn't in the list of commands.
@@ -81,6 +209,63 @@ void SerialCommand::setDefaultHandler(void (*function)(const char *)) {
 }
 
 
+/**
+ * This sets up a handler to be called when a complete binary frame has been received.
+ */
+void SerialCommand::setBinaryHandler(void (*function)(uint8_t command, uint8_t* payload, uint8_t length)) {
+  binaryHandler = function;
+}
+
+/**
+ * Collects the bytes of a binary frame after its sync byte. When complete, the binary handler is called
+ * which has to check the crc by endOfFrame. With sequence numbers, the byte after the command id is
+ * the sequence number, which is not passed to the handler.
+ */
+void SerialCommand::readFrameByte(uint8_t inByte) {
+	frame[framePos++] = inByte;
+	if (frameState == FRAME_LENGTH) {
+		if ((inByte < (withSequenceNumbers?2:1)) || (inByte > FRAME_MAX_LENGTH))
+			frameState = NO_FRAME; // invalid length, wait for next sync byte
+		else
+			frameState = FRAME_DATA;
+		return;
+	}
+
+	// frame is complete when length byte, command, payload and crc16 are there
+	if (framePos == frame[0]+3) {
+		frameState = NO_FRAME;
+		if (binaryHandler != NULL) {
+			errorCode = NO_ERROR;
+			repetition = false;
+			CommDefType* comm = CommDefType::get((CommDefType::CommandType)frame[1]);
+			idempotentCommand = (comm == NULL) || comm->idempotent;
+			if (withSequenceNumbers) {
+				seqNo = frame[2];
+				(*binaryHandler)(frame[1], &frame[3], frame[0]-2);
+			} else {
+				seqNo = 0;
+				(*binaryHandler)(frame[1], &frame[2], frame[0]-1);
+			}
+			resetError();
+		}
+	}
+}
+
+bool SerialCommand::endOfFrame() {
+	uint8_t length = frame[0];
+	uint16_t frameCrc = frame[length+1] | (frame[length+2] << 8);
+	uint16_t crc = crc16(frame, length+1);
+	if (crc != frameCrc) {
+		cmdSerial->print(F("crc!="));
+		cmdSerial->print(crc);
+		errorCode = CHECKSUM_WRONG;
+		seqNo = 0; // cannot be trusted
+		return false;
+	}
+	errorCode = NO_ERROR;
+	return isNewCommand();
+}
+
 /**
  * This checks the Serial stream for characters, and assembles them into a buffer.
  * When the terminator character (default '\n') is seen, it starts parsing the
@@ -89,6 +274,19 @@ void SerialCommand::setDefaultHandler(void (*function)(const char *)) {
 void SerialCommand::readSerial() {
   while (cmdSerial->available() > 0) {
     char inChar = cmdSerial->read();   // Read single available character, there may be more waiting
+
+    // binary frame in progress
+    if (frameState != NO_FRAME) {
+      readFrameByte(inChar);
+      continue;
+    }
+
+    // sync byte starts a binary frame, but only in between text commands
+    if (withBinaryFrames && ((uint8_t)inChar == FRAME_SYNC_BYTE) && (bufPos == 0)) {
+      frameState = FRAME_LENGTH;
+      framePos = 0;
+      continue;
+    }
 	
     if (inChar == term) {     // Check for the terminator (default '\r') meaning end of command
       #ifdef SERIALCOMMAND_DEBUG
@@ -96,46 +294,35 @@ void SerialCommand::readSerial() {
         cmdSerial->println(buffer);
       #endif
 
-	  savelast = last;
-	  checksum = 0;
-      char *command = strtok_r(buffer, delim, &last);   // Search for command at start of buffer
+	  if (withCRC) {
+		// crc covers the line up to the last " crc=", before tokenize replaces the blanks
+		char* crcParam = NULL;
+		for (char* p = strstr(buffer, " " CHECKSUM_CRC_PARAM); p != NULL; p = strstr(p+1, " " CHECKSUM_CRC_PARAM))
+			crcParam = p;
+		lineCRC = (crcParam != NULL)?crc16((uint8_t*)buffer, crcParam-buffer):0;
+	  }
+	  seqNo = 0;
+	  repetition = false;
+	  tokenize();
+      char *command = next();   // command is the first token
       if (command != NULL) {
-		computeChecksum(command,checksum);
-        boolean matched = false;
-        for (int i = 0; i < commandCount; i++) {
+        int i = findCommand(command);
+        if (i >= 0) {
           #ifdef SERIALCOMMAND_DEBUG
-            cmdSerial->print("Comparing [");
-            cmdSerial->print(command);
-            cmdSerial->print("] to [");
-            cmdSerial->print(commandList[i].command);
-            cmdSerial->println("]");
+            cmdSerial->print("Matched Command: ");
+            cmdSerial->println(command);
           #endif
 
-          // Compare the found command against the list of known commands for a match
-          if (strncasecmp(command, commandList[i].command, SERIALCOMMAND_MAXCOMMANDLENGTH) == 0) {
-             #ifdef SERIALCOMMAND_DEBUG
-             cmdSerial->print("Matched Command: ");
-             cmdSerial->println(command);
-             #endif
-			 
-
 			errorCode = NO_ERROR;
-      #ifdef SERIALCOMMAND_DEBUG
-      cmdSerial->print("Received: ");
-      cmdSerial->println(buffer);
-      #endif
+			idempotentCommand = commandList[i].idempotent;
 
-			
             // Execute the stored handler function for the command
 			// Within the handler, endOfParams has to be called that checks the checksum (if set
             (*commandList[i].function)();
 
             resetError();
-            matched = true;
-            break;
-          }
         }
-        if (!matched && (defaultHandler != NULL)) {
+        else if (defaultHandler != NULL) {
           (*defaultHandler)(command);
         }
       }
@@ -160,6 +347,8 @@ void SerialCommand::readSerial() {
 void SerialCommand::clearBuffer() {
   buffer[0] = '\0';
   bufPos = 0;
+  tokenCount = 0;
+  tokenPos = 0;
 }
 
 /**
@@ -167,16 +356,14 @@ void SerialCommand::clearBuffer() {
  * Returns NULL if no more tokens exist.
  */
 char *SerialCommand::next() {
-  savelast = last;
-  char* nextParam = strtok_r(NULL, delim, &last);
-  if (nextParam != NULL)
-	computeChecksum(nextParam,checksum);
-
-  return nextParam;
+	lastTokenPos = tokenPos;
+	if (tokenPos < tokenCount)
+		return tokens[tokenPos++].str;
+	return NULL;
 }
 
 void SerialCommand::unnext() {
-	last = savelast;
+	tokenPos = lastTokenPos;
 }
 
 
@@ -206,43 +393,21 @@ bool SerialCommand::getParamFloat(float &param) {
 	return false;
 }
 
+// name and value have been split by tokenize already, so only the name is compared
 bool SerialCommand::getNamedParam(const char* paramName, char* &paramValue) {
-	char* arg = next();
-	/*
-	cmdSerial->print("getnamedParam(");
-	cmdSerial->print(paramName);
-	cmdSerial->print(":");
-	cmdSerial->print(arg);
-	cmdSerial->println();
-	*/
 	paramValue = NULL;
-
-	if (arg != NULL) {
-		// extract name
-		char* intstr = NULL;
-		char* name = strtok_r(arg, "=", &intstr);
-		/*
-		cmdSerial->print("2:");
-		cmdSerial->print(arg);
-		cmdSerial->println();
-		*/
-		// extract param
-		if (name != NULL)
-			paramValue = strtok_r(NULL, delim, &intstr);
-		
-		// check if name is the right one
-		if ((name != NULL) && (paramValue != NULL) && (strncasecmp(name, paramName, SERIALCOMMAND_MAXCOMMANDLENGTH) == 0)) {
-			return true;
-		} else {
-			// no, param has wrong name or is invalid, push argument back
-			if (name != 0)
-				arg[strlen(name)] = '='; // strtok replaced = by 0, so replace it back to continue parsing
-
-			unnext();
-			paramValue = NULL;
-			return false;
-		}
+	if (tokenPos >= tokenCount)
+		return false;
+
+	Token& token = tokens[tokenPos];
+	if ((token.value != NULL) && (token.value[0] != '\0') &&
+		(token.nameLength == strlen(paramName)) && (strncasecmp(token.str, paramName, token.nameLength) == 0)) {
+		next();
+		paramValue = token.value;
+		return true;
 	}
+
+	// param has wrong name or is invalid, leave it for the next call
 	return false;
 }
 
@@ -279,6 +444,36 @@ bool SerialCommand::getNamedParamString(const char* paramName,  char* &param,
 }
 
 bool SerialCommand::endOfParams() {
+	if (withSequenceNumbers) {
+		// sequence number is the last parameter before the checksum
+		int16_t paramSeqNo = 0;
+		bool seqNoSet = false;
+		getNamedParamInt("seq",paramSeqNo, seqNoSet);
+		if (seqNoSet)
+			seqNo = paramSeqNo;
+	}
+	if (withCRC) {
+		errorCode = NO_ERROR;
+		char* paramCRC = NULL;
+		bool crcSet = false;
+		getNamedParamString("crc",paramCRC, crcSet);
+		if (crcSet) {
+			if ((uint16_t)strtoul(paramCRC, NULL, 16) == lineCRC) {
+				return isNewCommand();
+			}
+			else {
+				cmdSerial->print(F("crc!="));
+				cmdSerial->print(lineCRC, HEX);
+				errorCode = CHECKSUM_WRONG;
+				seqNo = 0; // cannot be trusted
+				return false;
+			}
+		}
+		cmdSerial->print(F("crc expected"));
+		errorCode = CHECKSUM_EXPECTED;
+		seqNo = 0;
+		return false;
+	}
 	if (withChecksum) {
 		// compute checksum of command and all params
 		errorCode = NO_ERROR;
@@ -289,7 +484,7 @@ bool SerialCommand::endOfParams() {
 		if (chksumSet) {
 			
 			if (paramCheckSum == saveCheckSum) {
-				return true;
+				return isNewCommand();
 			}
 			else {
 				cmdSerial->print(F("chk!="));
@@ -297,14 +492,16 @@ bool SerialCommand::endOfParams() {
 
 				cmdSerial->print(F(")"));
 				errorCode = CHECKSUM_WRONG;
+				seqNo = 0; // cannot be trusted
 				return false;
 			}
 		}
 		cmdSerial->print(F("chksum expected"));
 		errorCode = CHECKSUM_EXPECTED;
+		seqNo = 0;
 		return false;		
 	} else {
-		return true;
+		return isNewCommand();
 	}
 }
 
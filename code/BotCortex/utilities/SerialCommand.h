@@ -34,10 +34,15 @@
 #include <string.h>
 
 #include "utilities.h"
+#include "CommDef.h"
 // Size of the input buffer in bytes (maximum length of one command plus arguments)
 #define SERIALCOMMAND_BUFFER 128
 // Maximum length of a command excluding the terminating null
 #define SERIALCOMMAND_MAXCOMMANDLENGTH 8
+// Maximum number of tokens of one line, i.e. command plus parameters
+#define SERIALCOMMAND_MAXTOKENS 24
+// Slots of the hash table of commands, power of 2 and more than the number of commands
+#define SERIALCOMMAND_HASHSIZE 64
 
 // Uncomment the next line to run the library in debug mode (verbose messages)
 // #define SERIALCOMMAND_DEBUG
@@ -46,8 +51,9 @@
 class SerialCommand {
   public:
     SerialCommand();      // Constructor
-    void addCommand(const char *command, void(*function)());  // Add a command to the processing dictionary.
+    void addCommand(const char *command, void(*function)(), bool idempotent = true);  // Add a command to the processing dictionary.
     void setDefaultHandler(void (*function)(const char *));   // A handler to call when no valid command received.
+    void setBinaryHandler(void (*function)(uint8_t command, uint8_t* payload, uint8_t length)); // A handler to call when a binary frame has been received.
 
     void readSerial();    // Main entry point.
     void clearBuffer();   // Clears the input buffer.
@@ -64,36 +70,88 @@ class SerialCommand {
 
 	void computeChecksum(char *str, uint8_t &checksum);
 	bool endOfParams();
-	void useChecksum(bool really);
-	bool isChecksum() { return checksum; };
+	// with crc, text commands end with crc=<crc16 of the line in hex> instead of chk=<hash>
+	void useChecksum(bool really, bool crc = false);
+	bool isChecksum() { return withChecksum; };
+	bool isCRC() { return withCRC; };
+
+	// binary frames are accepted only if switched on. Within the binary handler, endOfFrame
+	// has to be called to check the crc, same as endOfParams for text commands
+	void useBinaryFrames(bool really);
+	bool isBinaryFrames() { return withBinaryFrames; };
+	bool endOfFrame();
+
+	// with sequence numbers, endOfParams and endOfFrame return false if the command has been executed already
+	// and must not be executed twice. Then isRepetition returns true and the result of the first execution.
+	// The result of every command is stored by storeResult when the reply is sent.
+	void useSequenceNumbers(bool really);
+	bool isSequenceNumbers() { return withSequenceNumbers; };
+	uint8_t getSeqNo() { return seqNo; };	// sequence number of the current command, 0 if none
+	bool isRepetition(uint8_t &result);
+	void storeResult(uint8_t result);
 
 	uint8_t getErrorCode() { return errorCode;};
 
 	enum errorCode { NO_ERROR = 0, CHECKSUM_EXPECTED = 1, CHECKSUM_WRONG = 2 };
   private:
 	bool getNamedParam(const char* name,    char* &paramValue);
+	void readFrameByte(uint8_t inByte);
+	bool isNewCommand();
+	void tokenize();
+	uint8_t hashCommand(const char* command);
+	int findCommand(const char* command);
 
     // Command/handler dictionary
     struct SerialCommandCallback {
       char command[SERIALCOMMAND_MAXCOMMANDLENGTH + 1];
       void (*function)();
+      bool idempotent;
     };                                    // Data structure to hold Command/Handler function key-value pairs
     SerialCommandCallback *commandList;   // Actual definition for command/handler array
     byte commandCount;
+	int8_t commandHash[SERIALCOMMAND_HASHSIZE];	// index in commandList by hash of the command, -1 if empty
 
     // Pointer to the default handler function
     void (*defaultHandler)(const char *);
+    // Pointer to the handler of binary frames
+    void (*binaryHandler)(uint8_t command, uint8_t* payload, uint8_t length);
 
-    char delim[2]; // null-terminated list of character to be used as delimeters for tokenizing (default " ")
     char term;     // Character that signals end of command (default '\n')
 
     char buffer[SERIALCOMMAND_BUFFER + 1]; // Buffer of stored characters while waiting for terminator character
     byte bufPos;                        // Current position in the buffer
-    char *last;                         // State variable used by strtok_r during processing
-    char *savelast;                         // State variable used by strtok_r during processing
+
+	// tokens of the current line, the line is split once when its terminator comes in
+	struct Token {
+		char* str;							// points into buffer, null terminated
+		char* value;						// behind the '=' of a named parameter, NULL if there is none
+		uint8_t nameLength;					// length of the name in front of the '='
+	};
+	Token tokens[SERIALCOMMAND_MAXTOKENS];
+	uint8_t tokenCount;
+	uint8_t tokenPos;					// token returned by the next call of next()
+	uint8_t lastTokenPos;				// tokenPos before the last call of next(), restored by unnext()
 	
 	bool withChecksum;
 	uint8_t checksum;
+	bool withCRC;
+	uint16_t lineCRC;					// crc16 of the current command in front of " crc="
+
+	enum FrameStateType { NO_FRAME, FRAME_LENGTH, FRAME_DATA };
+	FrameStateType frameState;
+	uint8_t frame[FRAME_MAX_LENGTH+3];	// length, command, payload, crc16
+	uint8_t framePos;
+	bool withBinaryFrames;
+
+	bool withSequenceNumbers;
+	uint8_t seqNo;						// sequence number of the current command
+	bool idempotentCommand;			// current command can be executed twice
+	bool repetition;					// current command has been executed already
+	uint8_t repeatedResult;				// result of its first execution
+	uint8_t historySeqNo[SEQUENCE_HISTORY];	// sequence numbers and results of the latest commands
+	uint8_t historyResult[SEQUENCE_HISTORY];
+	uint8_t historyPos;
+
 	uint8_t errorCode;
 };
 
@@ -12,7 +12,11 @@
 
 #include "Arduino.h"
 #include "utilities.h"
+#include "FixedPoint.h"
 
+// movement from one angle to another within a given time. The angle is interpolated
+// by a cubic Hermite spline, so the speed at start and end can be set to the speed of
+// the previous and next movement to avoid speed jumps in between.
 class AngleMovement {
 	public:
 		AngleMovement () {
@@ -21,7 +25,12 @@ class AngleMovement {
 			startTime = 0;
 			endTime = 0;
 			timeDiffRezi = 0;	
-
+			startSpeed = 0;
+			endSpeed = 0;
+			angleStartFixed = 0;
+			angleEndFixed = 0;
+			startTangentFixed = 0;
+			endTangentFixed = 0;
 		}
 		
 
@@ -37,6 +46,13 @@ class AngleMovement {
 			angleEnd = p.angleEnd;
 			startTime = p.startTime;
 			endTime = p.endTime;
+			timeDiffRezi = p.timeDiffRezi;
+			startSpeed = p.startSpeed;
+			endSpeed = p.endSpeed;
+			angleStartFixed = p.angleStartFixed;
+			angleEndFixed = p.angleEndFixed;
+			startTangentFixed = p.startTangentFixed;
+			endTangentFixed = p.endTangentFixed;
 		}
 		
 		void print(uint8_t no) {
@@ -77,6 +93,24 @@ class AngleMovement {
 				endTime=startTime+1;
 
 			timeDiffRezi = 1.0/float(endTime-startTime);
+			startSpeed = 0;
+			endSpeed = 0;
+			angleStartFixed = floatToFixed(angleStart);
+			angleEndFixed = floatToFixed(angleEnd);
+			startTangentFixed = 0;
+			endTangentFixed = 0;
+		}
+
+		// speed [degree/ms] at start and end of the movement, zero by default
+		void setSpeed(float pStartSpeed, float pEndSpeed) {
+			startSpeed = pStartSpeed;
+			startTangentFixed = floatToFixed(startSpeed*float(endTime - startTime));
+			setEndSpeed(pEndSpeed);
+		}
+
+		void setEndSpeed(float pEndSpeed) {
+			endSpeed = pEndSpeed;
+			endTangentFixed = floatToFixed(endSpeed*float(endTime - startTime));
 		}
 		
 		bool isNull() {
@@ -88,6 +122,12 @@ class AngleMovement {
 			angleEnd = 0;
 			endTime = 0;
 			timeDiffRezi = 0;
+			startSpeed = 0;
+			endSpeed = 0;
+			angleStartFixed = 0;
+			angleEndFixed = 0;
+			startTangentFixed = 0;
+			endTangentFixed = 0;
 		}
 		
 		float getRatioDone (uint32_t now) {
@@ -102,11 +142,73 @@ class AngleMovement {
 				position = angleEnd;
 			else {
 				float t = float(now - startTime)*timeDiffRezi; // ratio in time, 0..1
-				position = angleStart + t*(angleEnd-angleStart); 				
+				float t2 = t*t;
+				float t3 = t2*t;
+				float duration = float(endTime - startTime);
+
+				// cubic Hermite basis functions
+				float h00 = 2.0*t3 - 3.0*t2 + 1.0;
+				float h10 = t3 - 2.0*t2 + t;
+				float h01 = -2.0*t3 + 3.0*t2;
+				float h11 = t3 - t2;
+				position = h00*angleStart + h10*duration*startSpeed + h01*angleEnd + h11*duration*endSpeed;
 			}
 		
 			return position;
 		}
+
+		// same as getCurrentAngle in Q16.16
+		fixed_t getCurrentAngleFixed(uint32_t now) {
+			if (now>=endTime)
+				return angleEndFixed;
+			if (now<=startTime)
+				return angleStartFixed;
+			fixed_t t = fixedRatio(now - startTime, endTime - startTime);
+			fixed_t t2 = fixedMul(t, t);
+			fixed_t t3 = fixedMul(t2, t);
+
+			// cubic Hermite basis functions, tangents are speed*duration
+			fixed_t h00 = 2*t3 - 3*t2 + FIXED_ONE;
+			fixed_t h10 = t3 - 2*t2 + t;
+			fixed_t h01 = -2*t3 + 3*t2;
+			fixed_t h11 = t3 - t2;
+			return fixedMul(h00, angleStartFixed) + fixedMul(h10, startTangentFixed) + fixedMul(h01, angleEndFixed) + fixedMul(h11, endTangentFixed);
+		}
+
+		// speed [degree/ms] at the passed time, i.e. derivation of getCurrentAngle
+		float getCurrentSpeed(uint32_t now) {
+			if (now>=endTime)
+				return endSpeed;
+			float t = float(now - startTime)*timeDiffRezi;
+			float t2 = t*t;
+			float d00 = 6.0*t2 - 6.0*t;
+			float d10 = 3.0*t2 - 4.0*t + 1.0;
+			float d01 = -6.0*t2 + 6.0*t;
+			float d11 = 3.0*t2 - 2.0*t;
+			return (d00*angleStart + d01*angleEnd)*timeDiffRezi + d10*startSpeed + d11*endSpeed;
+		}
+
+		// same as getCurrentSpeed in Q16.16
+		fixed_t getCurrentSpeedFixed(uint32_t now) {
+			int32_t duration = endTime - startTime;
+			if (now>=endTime)
+				return endTangentFixed/duration;
+			fixed_t t = (now<=startTime)?0:fixedRatio(now - startTime, duration);
+			fixed_t t2 = fixedMul(t, t);
+			fixed_t d00 = 6*t2 - 6*t;
+			fixed_t d10 = 3*t2 - 4*t + FIXED_ONE;
+			fixed_t d01 = -6*t2 + 6*t;
+			fixed_t d11 = 3*t2 - 2*t;
+
+			// derivative along t is the angle per duration
+			fixed_t anglePerDuration = fixedMul(d00, angleStartFixed) + fixedMul(d10, startTangentFixed) + fixedMul(d01, angleEndFixed) + fixedMul(d11, endTangentFixed);
+			return anglePerDuration/duration;
+		}
+
+		// average speed [degree/ms]
+		float getAverageSpeed() {
+			return (angleEnd-angleStart)*timeDiffRezi;
+		}
 		bool isForward() {
 			return angleEnd>angleStart;
 		}
@@ -121,90 +223,175 @@ class AngleMovement {
 		float angleStart;
 		float angleEnd;
 		float timeDiffRezi;
+		float startSpeed;
+		float endSpeed;
 		uint32_t startTime;
 		uint32_t endTime;
 
+		// fixed point copies of angles and tangents used by getCurrentAngleFixed
+		fixed_t angleStartFixed;
+		fixed_t angleEndFixed;
+		fixed_t startTangentFixed;
+		fixed_t endTangentFixed;
 };
 
-/*
+// ring buffer of movements played one after the other. Used to stream a trajectory ahead of time,
+// so that the host can send samples in chunks and its jitter does not show up in the movement.
+// The last movement is kept after being played to hold its end angle.
+// When a movement is added, the speed at the junction to the previous one is set such that the speed
+// is continuous. This requires the next movement to be known before the previous one starts,
+// otherwise the previous movement ends with speed 0.
+template<int Size>
 class AngleMovementQueue {
 	public:
-		void print() {
-			cmdSerial->print(F("move{"));
-			if (!movement.isNull()) {
-				cmdSerial->print(F("1["));
-				cmdSerial->print(movement.angleStart);
-				cmdSerial->print("(");
-				cmdSerial->print(movement.startTime);
-				cmdSerial->print(F(")..."));
-				cmdSerial->print(movement.angleEnd);
-				cmdSerial->print("(");
-				cmdSerial->print(movement.endTime);
-				cmdSerial->print(")]");
+		AngleMovementQueue () {
+			setNull();
+		}
+
+		void print(uint8_t no) {
+			logger->print(F("queue("));
+			logger->print(count);
+			logger->print(F(")"));
+			for (int i = 0;i<count;i++)
+				at(i).print(no);
+		}
+
+		// replace all movements by one movement starting now with the current speed
+		void set(float pStartAngle, float pEndAngle, uint32_t now, uint32_t pDurationMs) {
+			float currentSpeed = isNull()?0:getCurrentSpeed(now);
+			head = 0;
+			count = 1;
+			queue[0].set(pStartAngle, pEndAngle, now, pDurationMs);
+			queue[0].setSpeed(limitSpeed(currentSpeed, queue[0].getAverageSpeed()), 0);
+		}
+
+		// append a movement that starts when the last one ends. If the queue ran dry, the movement
+		// starts now at the passed current angle. Returns false if the queue is full
+		bool add(float pCurrentAngle, float pEndAngle, uint32_t now, uint32_t pDurationMs) {
+			if (count == Size) {
+				// a movement that has been played already can be overwritten
+				if (queue[head].endTime >= now)
+					return false;
+				head = (head+1) % Size;
+				count--;
+			}
+			AngleMovement& next = queue[(head+count) % Size];
+			if ((count == 0) || (last().endTime < now))
+				next.set(pCurrentAngle, pEndAngle, now, pDurationMs);
+			else {
+				AngleMovement& prev = last();
+				next.set(prev.angleEnd, pEndAngle, prev.endTime, pDurationMs);
+
+				// changing the end speed of a movement in progress would let the angle jump
+				if (prev.startTime > now) {
+					float speed = (next.angleEnd - prev.angleStart)/float(next.endTime - prev.startTime);
+					speed = limitSpeed(speed, prev.getAverageSpeed());
+					speed = limitSpeed(speed, next.getAverageSpeed());
+					prev.setEndSpeed(speed);
+				}
+				next.setSpeed(prev.endSpeed, 0);
+			}
+			count++;
+			return true;
+		}
+
+		// remove all movements that are completely played, except the last one
+		void setTime(uint32_t now) {
+			while ((count > 1) && (queue[head].endTime < now)) {
+				head = (head+1) % Size;
+				count--;
 			}
-			if (!nextMovement.isNull()) {
-				cmdSerial->print("2[");
-				cmdSerial->print(nextMovement.angleStart);
-				cmdSerial->print("(");
-				cmdSerial->print(nextMovement.startTime);
-				cmdSerial->print(")...");
-				cmdSerial->print(nextMovement.angleEnd);
-				cmdSerial->print("(");
-				cmdSerial->print(nextMovement.endTime);
-				cmdSerial->print(")]");
+		}
+
+		// an empty queue behaves like a null movement
+		float getCurrentAngle(uint32_t now) {
+			if (isNull())
+				return 0;
+			for (int i = 0;i<count-1;i++) {
+				if (now <= at(i).endTime)
+					return at(i).getCurrentAngle(now);
 			}
-			cmdSerial->print("}");
-		}
-		void set(float currentAngle,  float endAngle, uint32_t now, uint32_t pDurationTime) {
-			if (movement.isNull()) {
-				movement.set(currentAngle, endAngle, now, pDurationTime);
-			} else {
-				// if new position is earlier than the current movement, overwrite
-				if (movement.endTime>= now+pDurationTime) {
-					movement.set(currentAngle, endAngle, now, pDurationTime);
-					nextMovement.setNull();
-				} else {
-					// end point is later, add next movement
-					nextMovement.set(movement.angleEnd, endAngle, movement.endTime, pDurationTime+now-movement.endTime);
-				}				
+			return last().getCurrentAngle(now);
+		}
+
+		fixed_t getCurrentAngleFixed(uint32_t now) {
+			if (isNull())
+				return 0;
+			for (int i = 0;i<count-1;i++) {
+				if (now <= at(i).endTime)
+					return at(i).getCurrentAngleFixed(now);
 			}
+			return last().getCurrentAngleFixed(now);
 		}
-		
+
+		float getCurrentSpeed(uint32_t now) {
+			if (isNull())
+				return 0;
+			for (int i = 0;i<count-1;i++) {
+				if (now <= at(i).endTime)
+					return at(i).getCurrentSpeed(now);
+			}
+			return last().getCurrentSpeed(now);
+		}
+
+		fixed_t getCurrentSpeedFixed(uint32_t now) {
+			if (isNull())
+				return 0;
+			for (int i = 0;i<count-1;i++) {
+				if (now <= at(i).endTime)
+					return at(i).getCurrentSpeedFixed(now);
+			}
+			return last().getCurrentSpeedFixed(now);
+		}
+
 		bool isNull() {
-			return movement.isNull();
+			return count == 0;
 		}
-		
+
+		void setNull() {
+			head = 0;
+			count = 0;
+		}
+
 		bool timeInMovement(uint32_t now) {
-			if (movement.timeInMovement(now)) 
-				return true;
-			else 
-				return nextMovement.timeInMovement(now);
+			if (!isNull())
+				return last().timeInMovement(now);
+			else
+				return false;
 		}
 
-		void setTime(uint32_t now) {
-			if (!movement.isNull()) {
-				if (movement.endTime< now) {
-					if (!nextMovement.isNull()) {
-						movement = nextMovement;
-						if (nextMovement.endTime < now)
-							nextMovement.setNull();
-					} else 
-						movement.setNull();
-				}
-			}
+		// number of movements not yet completely played
+		int getFill(uint32_t now) {
+			int fill = 0;
+			for (int i = 0;i<count;i++)
+				if (at(i).endTime >= now)
+					fill++;
+			return fill;
 		}
-		
-		float getCurrentAngle(uint32_t now) {
-			float result = 0;
-			if (movement.timeInMovement(now))
-				result  = movement.getCurrentAngle(now);
-			if (nextMovement.timeInMovement(now))
-				result  = nextMovement.getCurrentAngle(now);
-	
-			return result;
-		}
-		AngleMovement movement;	
-		AngleMovement nextMovement;
+
+		// time [ms] until the last movement ends
+		uint32_t getTimeAhead(uint32_t now) {
+			if (timeInMovement(now))
+				return last().endTime - now;
+			return 0;
+		}
+
+	private:
+		// limit the speed at a junction such that the spline does not overshoot, i.e. the movement
+		// does not change direction and does not go beyond its target (Fritsch-Carlson)
+		static float limitSpeed(float speed, float averageSpeed) {
+			if (speed*averageSpeed <= 0)
+				return 0;
+			if (fabs(speed) > 3.0*fabs(averageSpeed))
+				return 3.0*averageSpeed;
+			return speed;
+		}
+
+		AngleMovement& at(int i) { return queue[(head+i) % Size]; };
+		AngleMovement& last() { return at(count-1); };
+
+		AngleMovement queue[Size];
+		int head;
+		int count;
 };
-*/
 #endif
@@ -0,0 +1,676 @@
+/*
+ * CortexEmulator.cpp
+ *
+ * Author: JochenAlt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/stat.h>
+#include <sstream>
+#include <algorithm>
+
+#include "CortexEmulator.h"
+#include "Util.h"
+#include "logger.h"
+
+CortexEmulator::CortexEmulator() {
+	cmdMaster = -1;
+	cmdSlave = -1;
+	logMaster = -1;
+	logSlave = -1;
+	thread = NULL;
+	running = false;
+	replyDelay_us = 0;
+	dropRate = 0;
+	errorRate = 0;
+	withChecksum = false;
+	withCRC = false;
+	withBinaryFrames = false;
+	withSequenceNumbers = false;
+	seqNo = 0;
+	dropReply = false;
+	powered = false;
+	setuped = false;
+	enabled = false;
+	telemetryPeriod = 0;
+	lastTelemetry = 0;
+	for (int i = 0;i<EMULATOR_ACTUATORS;i++) {
+		actuator[i].angle = 0;
+		actuator[i].minAngle = -180;
+		actuator[i].maxAngle = 180;
+		actuator[i].nullAngle = 0;
+	}
+}
+
+CortexEmulator::~CortexEmulator() {
+	stop();
+	close();
+}
+
+void CortexEmulator::configure(const EmulatorConfig& config) {
+	replyDelay_us = config.replyDelay_us;
+	dropRate = config.dropRate;
+	errorRate = config.errorRate;
+}
+
+bool CortexEmulator::openPty(const string& device, int& masterHandle, int& slaveHandle) {
+	masterHandle = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((masterHandle < 0) || (grantpt(masterHandle) < 0) || (unlockpt(masterHandle) < 0)) {
+		LOG(ERROR) << "creating pseudo terminal failed (" << strerror(errno) << ")";
+		return false;
+	}
+	// never block when the host does not read
+	fcntl(masterHandle, F_SETFL, fcntl(masterHandle, F_GETFL) | O_NONBLOCK);
+
+	// keep the slave open, otherwise the master gets a hangup whenever the host disconnects
+	string slaveName = ptsname(masterHandle);
+	slaveHandle = ::open(slaveName.c_str(), O_RDWR | O_NOCTTY);
+	if (slaveHandle < 0) {
+		LOG(ERROR) << "opening " << slaveName << " failed (" << strerror(errno) << ")";
+		return false;
+	}
+	struct termios config;
+	tcgetattr(slaveHandle, &config);
+	cfmakeraw(&config);
+	tcsetattr(slaveHandle, TCSANOW, &config);
+
+	// the host looks for the cortex in /dev, so the pseudo terminal gets the name of the cortex' device.
+	// A real device is never replaced.
+	struct stat deviceStat;
+	if (lstat(device.c_str(), &deviceStat) == 0) {
+		if (!S_ISLNK(deviceStat.st_mode)) {
+			LOG(ERROR) << device << " is a real device, disconnect the cortex first";
+			return false;
+		}
+		unlink(device.c_str());
+	}
+	if (symlink(slaveName.c_str(), device.c_str()) < 0) {
+		LOG(ERROR) << "linking " << device << " to " << slaveName << " failed (" << strerror(errno) << ")";
+		return false;
+	}
+	LOG(INFO) << device << " -> " << slaveName;
+	return true;
+}
+
+bool CortexEmulator::open(const EmulatorConfig& config) {
+	configure(config);
+	cmdDevice = string("/dev/") + CORTEX_COMMAND_SERIAL_PORT;
+	logDevice = string("/dev/") + CORTEX_LOGGER_SERIAL_PORT;
+	bool ok = openPty(cmdDevice, cmdMaster, cmdSlave) && openPty(logDevice, logMaster, logSlave);
+	if (!ok)
+		close();
+	return ok;
+}
+
+void CortexEmulator::close() {
+	int* handles[] = { &cmdMaster, &cmdSlave, &logMaster, &logSlave };
+	for (unsigned i = 0;i<sizeof(handles)/sizeof(handles[0]);i++) {
+		if (*handles[i] >= 0)
+			::close(*handles[i]);
+		*handles[i] = -1;
+	}
+	if (!cmdDevice.empty())
+		unlink(cmdDevice.c_str());
+	if (!logDevice.empty())
+		unlink(logDevice.c_str());
+	cmdDevice = "";
+	logDevice = "";
+}
+
+void CortexEmulator::start() {
+	if (thread == NULL) {
+		running = true;
+		thread = new std::thread(&CortexEmulator::run, this);
+	}
+}
+
+void CortexEmulator::stop() {
+	running = false;
+	if (thread != NULL) {
+		thread->join();
+		delete thread;
+		thread = NULL;
+	}
+}
+
+void CortexEmulator::run() {
+	running = true;
+	while (running) {
+		struct pollfd fds[2];
+		fds[0].fd = cmdMaster;
+		fds[0].events = POLLIN;
+		fds[1].fd = logMaster;
+		fds[1].events = POLLIN;
+
+		// wake up regularly to emit telemetry and to check if we have to stop
+		poll(fds, 2, 10);
+		if (fds[0].revents & POLLIN)
+			receive();
+		if (fds[1].revents & POLLIN) {
+			// nothing is sent to the log port, drop it
+			char buffer[256];
+			while (read(logMaster, buffer, sizeof(buffer)) > 0);
+		}
+
+		uint32_t now = millis();
+		if ((telemetryPeriod > 0) && (now - lastTelemetry >= (uint32_t)telemetryPeriod)) {
+			lastTelemetry = now;
+			sendTelemetry(now);
+		}
+	}
+}
+
+// split incoming data in text commands and binary frames
+void CortexEmulator::receive() {
+	char buffer[256];
+	int bytesRead;
+	while ((bytesRead = read(cmdMaster, buffer, sizeof(buffer))) > 0)
+		received.append(buffer, bytesRead);
+
+	while (!received.empty()) {
+		seqNo = 0;
+		dropReply = false;
+		if (withBinaryFrames && ((uint8_t)received[0] == FRAME_SYNC_BYTE)) {
+			// <sync> <length> <command id> [<seqNo>] <payload> <crc16>
+			if (received.length() < 2)
+				return;
+			int length = (uint8_t)received[1];
+			int headerLength = withSequenceNumbers?2:1;
+			if ((length < headerLength) || (length > FRAME_MAX_LENGTH)) {
+				received.erase(0,1); // invalid length, wait for next sync byte
+				continue;
+			}
+			if ((int)received.length() < length+4)
+				return;
+			const uint8_t* frame = (const uint8_t*)received.data();
+			uint16_t crc = frame[2+length] | (frame[3+length] << 8);
+			statistics.frames++;
+			if (crc == crc16(&frame[1], length+1)) {
+				if (!injectFault()) {
+					if (withSequenceNumbers)
+						seqNo = frame[3];
+					if (!isRepetition(CommDefType::get((CommDefType::CommandType)frame[2]))) {
+						string payload = received.substr(2+headerLength, length-headerLength);
+						processFrame(frame[2], (const uint8_t*)payload.data(), length-headerLength);
+					}
+				}
+			}
+			else
+				replyError(CHECKSUM_WRONG);
+			received.erase(0, length+4);
+			continue;
+		}
+
+		size_t endOfLineIdx = received.find('\r');
+		if (endOfLineIdx == string::npos)
+			return;
+		string line = received.substr(0, endOfLineIdx);
+		received.erase(0, endOfLineIdx+1);
+		trim(line);
+		if (!line.empty()) {
+			statistics.commands++;
+			if (!injectFault())
+				processLine(line);
+		}
+	}
+}
+
+// returns true if the command has been garbled on purpose and is not executed. Besides that,
+// the reply of an executed command might get lost
+bool CortexEmulator::injectFault() {
+	if (replyDelay_us > 0)
+		delay_us(replyDelay_us);
+
+	float dice = randomFloat(0.0,1.0);
+	if (dice < dropRate) {
+		statistics.dropped++;
+		dropReply = true;
+		return false;
+	}
+	if (dice < dropRate + errorRate) {
+		statistics.errors++;
+		replyError(CHECKSUM_WRONG);
+		return true;
+	}
+	return false;
+}
+
+// true, if the command has been executed already and must not be executed twice. Then the result
+// of the first execution is replied again
+bool CortexEmulator::isRepetition(const CommDefType* comm) {
+	if ((seqNo == 0) || (comm == NULL) || comm->idempotent)
+		return false;
+	for (unsigned i = 0;i<history.size();i++) {
+		if (history[i].seqNo == seqNo) {
+			statistics.repeated++;
+			if (history[i].result == ABSOLUTELY_NO_ERROR)
+				reply("");
+			else
+				replyError(history[i].result);
+			return true;
+		}
+	}
+	return false;
+}
+
+void CortexEmulator::send(const string& str) {
+	if (dropReply)
+		return;
+	if (write(cmdMaster, str.c_str(), str.length()) < 0)
+		LOG(WARNING) << "reply lost (" << strerror(errno) << ")";
+}
+
+void CortexEmulator::storeResult(ErrorCodeType result) {
+	if (seqNo == 0)
+		return;
+	for (unsigned i = 0;i<history.size();i++) {
+		if (history[i].seqNo == seqNo) {
+			history[i].result = result;
+			return;
+		}
+	}
+	SeqNoResult entry;
+	entry.seqNo = seqNo;
+	entry.result = result;
+	history.push_back(entry);
+	if (history.size() > SEQUENCE_HISTORY)
+		history.pop_front();
+}
+
+// with sequence numbers, replies end with the number of their command
+string CortexEmulator::seqNoStr() {
+	return (seqNo != 0)?" #" + int_to_string(seqNo):"";
+}
+
+void CortexEmulator::reply(const string& payload) {
+	storeResult(ABSOLUTELY_NO_ERROR);
+	send(payload + ">ok" + seqNoStr() + "\r\n>");
+}
+
+void CortexEmulator::replyError(ErrorCodeType error) {
+	storeResult(error);
+	send(">nok(" + int_to_string(error) + ")" + seqNoStr() + "\r\n>");
+}
+
+string CortexEmulator::composeFrame(uint8_t command, const uint8_t* payload, int length) {
+	string frame;
+	frame += (char)FRAME_SYNC_BYTE;
+	frame += (char)(length+1);
+	frame += (char)command;
+	frame.append((const char*)payload, length);
+	uint16_t crc = crc16((const uint8_t*)frame.data()+1, length+2);
+	frame += (char)(crc & 0xFF);
+	frame += (char)((crc >> 8) & 0xFF);
+	return frame;
+}
+
+void CortexEmulator::log(const string& line) {
+	string str = line + "\r\n";
+	if (write(logMaster, str.c_str(), str.length()) < 0)
+		; // nobody listens to the log, that's fine
+}
+
+void CortexEmulator::processLine(string line) {
+	std::istringstream tokenizer(line);
+	vector<string> params;
+	string token;
+	while (tokenizer >> token)
+		params.push_back(token);
+	string name = params[0];
+	params.erase(params.begin());
+
+	CommDefType* comm = NULL;
+	for (int i = 0;i<CommDefType::NumberOfCommands;i++)
+		if (strcasecmp(commDef[i].name, name.c_str()) == 0)
+			comm = &commDef[i];
+	if (comm == NULL) {
+		send(name);
+		replyError(UNRECOGNIZED_CMD);
+		return;
+	}
+
+	// crc16 covers the line in front of " crc=", CHECKSUM itself does not need one
+	if (withCRC && (comm->cmd != CommDefType::CHECKSUM_CMD)) {
+		size_t crcIdx = line.rfind(" " CHECKSUM_CRC_PARAM);
+		if (params.empty() || !hasPrefix(params.back(), CHECKSUM_CRC_PARAM) || (crcIdx == string::npos)) {
+			send("crc expected");
+			replyError(CHECKSUM_EXPECTED);
+			return;
+		}
+		uint16_t crc = strtoul(params.back().c_str() + strlen(CHECKSUM_CRC_PARAM), NULL, 16);
+		params.pop_back();
+		if (crc != crc16((const uint8_t*)line.data(), crcIdx)) {
+			replyError(CHECKSUM_WRONG);
+			return;
+		}
+	}
+
+	// checksum is a hash of all characters except blanks, CHECKSUM itself does not need one
+	if (withChecksum && !withCRC && (comm->cmd != CommDefType::CHECKSUM_CMD)) {
+		if (params.empty() || !hasPrefix(params.back(), "chk=")) {
+			send("chksum expected");
+			replyError(CHECKSUM_EXPECTED);
+			return;
+		}
+		int checksum = string_to_int(params.back().substr(4));
+		params.pop_back();
+		uint8_t hash = 0;
+		string hashed = name;
+		for (unsigned i = 0;i<params.size();i++)
+			hashed += params[i];
+		for (unsigned i = 0;i<hashed.length();i++)
+			hash = ((hash << 5) + hash) + hashed[i];
+		if (hash != checksum) {
+			replyError(CHECKSUM_WRONG);
+			return;
+		}
+	}
+
+	// sequence number is the last parameter before the checksum
+	if (withSequenceNumbers && !params.empty() && hasPrefix(params.back(), "seq=")) {
+		seqNo = string_to_int(params.back().substr(4));
+		params.pop_back();
+	}
+	if (isRepetition(comm))
+		return;
+
+	uint32_t now = millis();
+	switch (comm->cmd) {
+		case CommDefType::ECHO_CMD:
+			if (params.size() != 1)
+				replyError(PARAM_NUMBER_WRONG);
+			else
+				reply(params[0]);
+			break;
+		case CommDefType::CHECKSUM_CMD:
+			if ((params.size() == 1) && (strcasecmp(params[0].c_str(), "crc") == 0)) {
+				withChecksum = true;
+				withCRC = true;
+				reply("");
+				break;
+			}
+			// fall through
+		case CommDefType::BINARY_CMD:
+		case CommDefType::SEQ_CMD: {
+			bool onOff = (params.size() == 1) && (strcasecmp(params[0].c_str(), "on") == 0);
+			if ((params.size() != 1) || (!onOff && (strcasecmp(params[0].c_str(), "off") != 0)))
+				replyError(PARAM_WRONG);
+			else {
+				if (comm->cmd == CommDefType::CHECKSUM_CMD) {
+					withChecksum = onOff;
+					withCRC = false;
+				}
+				if (comm->cmd == CommDefType::BINARY_CMD)
+					withBinaryFrames = onOff;
+				if (comm->cmd == CommDefType::SEQ_CMD) {
+					// host starts numbering anew
+					withSequenceNumbers = onOff;
+					history.clear();
+				}
+				reply("");
+			}
+			break;
+		}
+		case CommDefType::LOG_CMD:
+			if (params.size() != 2)
+				replyError(PARAM_NUMBER_WRONG);
+			else {
+				log("log " + params[0] + " " + params[1]);
+				reply("");
+			}
+			break;
+		case CommDefType::SETUP_CMD:
+			setuped = true;
+			for (int i = 0;i<EMULATOR_ACTUATORS;i++)
+				actuator[i].angle = actuator[i].nullAngle;
+			movement.clear();
+			log("setup done");
+			reply("");
+			break;
+		case CommDefType::POWER_CMD:
+			if ((params.size() == 1) && (strcasecmp(params[0].c_str(), "off") == 0)) {
+				powered = false;
+				enabled = false;
+				reply("");
+			} else
+				if ((params.size() == 1) && (strcasecmp(params[0].c_str(), "on") == 0)) {
+					if (setuped) {
+						powered = true;
+						reply("");
+					} else
+						replyError(CORTEX_POWER_ON_WITHOUT_SETUP);
+				} else
+					replyError(PARAM_WRONG);
+			break;
+		case CommDefType::ENABLE_CMD:
+			if (powered) {
+				enabled = true;
+				reply("");
+			} else
+				replyError(CORTEX_POWER_ON_WITHOUT_SETUP);
+			break;
+		case CommDefType::DISABLE_CMD:
+			enabled = false;
+			reply("");
+			break;
+		case CommDefType::INFO_CMD:
+			reply(string(powered?" powered":"") + (setuped?" setuped":"") + (enabled?" enabled":""));
+			break;
+		case CommDefType::GET_CMD:
+		case CommDefType::STATUS_CMD: {
+			bool all = (comm->cmd == CommDefType::STATUS_CMD) || ((params.size() == 1) && (strcasecmp(params[0].c_str(), "all") == 0));
+			int actuatorNo = (!all && (params.size() == 1))?string_to_int(params[0]):-1;
+			if (!setuped) {
+				replyError(CORTEX_SETUP_MISSING);
+				break;
+			}
+			if (!all && ((actuatorNo < 0) || (actuatorNo >= EMULATOR_ACTUATORS))) {
+				replyError(PARAM_WRONG);
+				break;
+			}
+			string result;
+			for (int i = 0;i<EMULATOR_ACTUATORS;i++) {
+				if (all || (i == actuatorNo)) {
+					result += " n=" + int_to_string(i) + " ang=" + string_format("%.2f", getCurrentAngle(i, now)) +
+							  " min=" + string_format("%.2f", actuator[i].minAngle) +
+							  " max=" + string_format("%.2f", actuator[i].maxAngle) +
+							  " null=" + string_format("%.2f", actuator[i].nullAngle);
+					if (comm->cmd == CommDefType::STATUS_CMD)
+						result += " torque=0 flags=" + int_to_string(FRAME_STATUS_OK | (enabled?FRAME_STATUS_ENABLED:0));
+				}
+			}
+			reply(result);
+			break;
+		}
+		case CommDefType::SET_CMD: {
+			int actuatorNo = params.empty()?-1:string_to_int(params[0]);
+			if ((actuatorNo < 0) || (actuatorNo >= EMULATOR_ACTUATORS)) {
+				replyError(PARAM_WRONG);
+				break;
+			}
+			for (unsigned i = 1;i<params.size();i++) {
+				if (hasPrefix(params[i], "min="))
+					actuator[actuatorNo].minAngle = atof(params[i].substr(4).c_str());
+				if (hasPrefix(params[i], "max="))
+					actuator[actuatorNo].maxAngle = atof(params[i].substr(4).c_str());
+				if (hasPrefix(params[i], "null="))
+					actuator[actuatorNo].nullAngle = atof(params[i].substr(5).c_str());
+			}
+			reply("");
+			break;
+		}
+		case CommDefType::MOVETO_CMD:
+		case CommDefType::CHUNK_CMD: {
+			if (params.size() != EMULATOR_ACTUATORS+1) {
+				replyError(PARAM_NUMBER_WRONG);
+				break;
+			}
+			float angle[EMULATOR_ACTUATORS];
+			for (int i = 0;i<EMULATOR_ACTUATORS;i++)
+				angle[i] = atof(params[i].c_str());
+			int duration = string_to_int(params[EMULATOR_ACTUATORS]);
+			if (comm->cmd == CommDefType::MOVETO_CMD) {
+				if ((duration < 20) || (duration > 9999))
+					replyError(PARAM_NUMBER_WRONG);
+				else {
+					moveTo(angle, duration);
+					reply("");
+				}
+			} else {
+				if ((duration < 1) || (duration > 9999))
+					replyError(PARAM_NUMBER_WRONG);
+				else
+					if (queueSample(angle, duration))
+						reply(queueState(now));
+					else
+						replyError(CORTEX_QUEUE_FULL);
+			}
+			break;
+		}
+		case CommDefType::TELEMETRY_CMD: {
+			int period = params.empty()?-1:string_to_int(params[0]);
+			if ((period == 0) || ((period >= TELEMETRY_MIN_PERIOD) && (period <= 10000))) {
+				telemetryPeriod = period;
+				reply("");
+			} else
+				replyError(PARAM_WRONG);
+			break;
+		}
+		default:
+			// accepted without any effect
+			reply("");
+	}
+}
+
+void CortexEmulator::processFrame(uint8_t command, const uint8_t* payload, int length) {
+	uint32_t now = millis();
+	switch (command) {
+		case CommDefType::MOVETO_CMD:
+		case CommDefType::CHUNK_CMD: {
+			int samples = (command == CommDefType::MOVETO_CMD)?1:((length > 0)?payload[0]:0);
+			const uint8_t* p = (command == CommDefType::MOVETO_CMD)?payload:payload+1;
+			if ((samples < 1) || (samples > FRAME_CHUNK_MAX_SAMPLES) ||
+				(length != (p-payload) + samples*FRAME_CHUNK_SAMPLE_LENGTH)) {
+				replyError(PARAM_NUMBER_WRONG);
+				return;
+			}
+			if ((command == CommDefType::CHUNK_CMD) && ((int)movement.size() + samples > MOVEMENT_QUEUE_SIZE)) {
+				replyError(CORTEX_QUEUE_FULL);
+				return;
+			}
+			for (int s = 0;s<samples;s++) {
+				float angle[EMULATOR_ACTUATORS];
+				for (int i = 0;i<EMULATOR_ACTUATORS;i++)
+					angle[i] = (int16_t)(p[i*2] | (p[i*2+1] << 8)) / (float)FRAME_ANGLE_SCALE;
+				int duration = p[14] | (p[15] << 8);
+				p += FRAME_CHUNK_SAMPLE_LENGTH;
+				if (command == CommDefType::MOVETO_CMD)
+					moveTo(angle, duration);
+				else
+					queueSample(angle, duration);
+			}
+			reply((command == CommDefType::CHUNK_CMD)?queueState(now):"");
+			break;
+		}
+		case CommDefType::STATUS_CMD: {
+			if (!setuped) {
+				replyError(CORTEX_SETUP_MISSING);
+				return;
+			}
+			uint8_t status[FRAME_STATUS_PAYLOAD_LENGTH];
+			uint8_t* p = status;
+			for (int i = 0;i<EMULATOR_ACTUATORS;i++) {
+				float value[4] = { getCurrentAngle(i, now), actuator[i].minAngle, actuator[i].maxAngle, actuator[i].nullAngle };
+				for (int j = 0;j<4;j++) {
+					int16_t angle = value[j]*FRAME_ANGLE_SCALE;
+					*p++ = angle & 0xFF;
+					*p++ = (angle >> 8) & 0xFF;
+				}
+				*p++ = 0; // torque
+				*p++ = 0;
+				*p++ = FRAME_STATUS_OK | (enabled?FRAME_STATUS_ENABLED:0);
+			}
+			reply(composeFrame(CommDefType::STATUS_CMD, status, FRAME_STATUS_PAYLOAD_LENGTH));
+			break;
+		}
+		default:
+			replyError(UNRECOGNIZED_CMD);
+	}
+}
+
+void CortexEmulator::moveTo(const float angle[], int duration_ms) {
+	uint32_t now = millis();
+	for (int i = 0;i<EMULATOR_ACTUATORS;i++)
+		actuator[i].angle = getCurrentAngle(i, now);
+	movement.clear();
+	queueSample(angle, duration_ms);
+}
+
+bool CortexEmulator::queueSample(const float angle[], int duration_ms) {
+	uint32_t now = millis();
+	updateMovement(now);
+	if (movement.size() >= MOVEMENT_QUEUE_SIZE)
+		return false;
+
+	Sample sample;
+	for (int i = 0;i<EMULATOR_ACTUATORS;i++)
+		sample.angle[i] = constrain(angle[i], actuator[i].minAngle, actuator[i].maxAngle);
+	sample.startTime = movement.empty()?now:movement.back().startTime + movement.back().duration_ms;
+	sample.duration_ms = duration_ms;
+	movement.push_back(sample);
+	statistics.samples++;
+	return true;
+}
+
+// remove all samples that have been played completely
+void CortexEmulator::updateMovement(uint32_t now) {
+	while (!movement.empty() && (now >= movement.front().startTime + movement.front().duration_ms)) {
+		for (int i = 0;i<EMULATOR_ACTUATORS;i++)
+			actuator[i].angle = movement.front().angle[i];
+		movement.pop_front();
+	}
+}
+
+// no physics, actuators follow the samples linearly
+float CortexEmulator::getCurrentAngle(int actuatorNo, uint32_t now) {
+	updateMovement(now);
+	if (movement.empty() || (now < movement.front().startTime))
+		return actuator[actuatorNo].angle;
+	const Sample& sample = movement.front();
+	float t = (float)(now - sample.startTime)/(float)sample.duration_ms;
+	return actuator[actuatorNo].angle + t*(sample.angle[actuatorNo] - actuator[actuatorNo].angle);
+}
+
+string CortexEmulator::queueState(uint32_t now) {
+	updateMovement(now);
+	uint32_t ahead = 0;
+	if (!movement.empty())
+		ahead = movement.back().startTime + movement.back().duration_ms - now;
+	return "fill=" + int_to_string(movement.size()) + " ahead=" + int_to_string(ahead);
+}
+
+void CortexEmulator::sendTelemetry(uint32_t now) {
+	uint8_t telemetry[FRAME_TELEMETRY_PAYLOAD_LENGTH];
+	memset(telemetry, 0, sizeof(telemetry));
+	uint8_t* p = telemetry;
+	for (int i = 0;i<4;i++)
+		*p++ = (now >> (i*8)) & 0xFF;
+	for (int i = 0;i<EMULATOR_ACTUATORS;i++) {
+		// setpoint and measured angle are the same, integral, speed and torque remain 0
+		int16_t angle = getCurrentAngle(i, now)*FRAME_ANGLE_SCALE;
+		for (int j = 0;j<2;j++) {
+			*p++ = angle & 0xFF;
+			*p++ = (angle >> 8) & 0xFF;
+		}
+		p += FRAME_TELEMETRY_JOINT_LENGTH-4;
+	}
+	string frame = composeFrame(CommDefType::TELEMETRY_CMD, telemetry, FRAME_TELEMETRY_PAYLOAD_LENGTH);
+	if (write(logMaster, frame.data(), frame.length()) < 0)
+		; // nobody listens to the log, that's fine
+}
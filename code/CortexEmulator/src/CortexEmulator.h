@@ -0,0 +1,152 @@
+/*
+ * CortexEmulator.h
+ *
+ * Software replacement of Walters Cortex for testing the webserver without hardware.
+ * Creates two pseudo terminals and links them to /dev/ttyUSB1 (commands) and /dev/ttyUSB0 (log),
+ * where the webserver expects the Teensy. Speaks the text protocol including checksums and sequence numbers
+ * and the binary frames (MOVETO, CHUNK, STATUS, SET), actuators follow the commanded
+ * angles without any physics. Replies can be delayed, dropped or turned into errors
+ * to check the timing and the retry behaviour of the webserver.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef CORTEXEMULATOR_H_
+#define CORTEXEMULATOR_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+
+#include "core.h"
+#include "CommDef.h"
+
+using namespace std;
+
+#define EMULATOR_ACTUATORS 7
+
+struct EmulatorConfig {
+	EmulatorConfig() {
+		replyDelay_us = 0;
+		dropRate = 0;
+		errorRate = 0;
+	}
+	int replyDelay_us;			// time the cortex takes to process a command
+	float dropRate;				// [0..1] share of commands whose reply gets lost after execution, host runs into a timeout
+	float errorRate;			// [0..1] share of commands answered with >nok(CHECKSUM_WRONG) as if the line has been garbled
+};
+
+struct EmulatorStatistics {
+	EmulatorStatistics() {
+		commands = 0;
+		frames = 0;
+		dropped = 0;
+		repeated = 0;
+		errors = 0;
+		samples = 0;
+	}
+	std::atomic<int> commands;	// text commands received
+	std::atomic<int> frames;	// binary frames received
+	std::atomic<int> dropped;	// replies dropped on purpose
+	std::atomic<int> repeated;	// commands received again and not executed twice
+	std::atomic<int> errors;	// errors injected on purpose
+	std::atomic<int> samples;	// samples put into the movement queue
+};
+
+class CortexEmulator {
+public:
+	CortexEmulator();
+	~CortexEmulator();
+
+	// create the pseudo terminals and link them to the device names of the cortex. Returns false if that failed.
+	bool open(const EmulatorConfig& config);
+	void close();
+
+	// change delay and fault injection, can be called while running
+	void configure(const EmulatorConfig& config);
+
+	// process commands in the calling thread until stop is called
+	void run();
+
+	// process commands in a separate thread
+	void start();
+	void stop();
+
+	EmulatorStatistics& getStatistics() { return statistics; };
+
+private:
+	struct Sample {
+		float angle[EMULATOR_ACTUATORS];
+		uint32_t startTime;
+		uint32_t duration_ms;
+	};
+
+	struct Actuator {
+		float angle;			// angle at the end of the last played sample
+		float minAngle;
+		float maxAngle;
+		float nullAngle;
+	};
+
+	bool openPty(const string& device, int& masterHandle, int& slaveHandle);
+	void receive();
+	void processLine(string line);
+	void processFrame(uint8_t command, const uint8_t* payload, int length);
+
+	// replies look like the cortex' ones: <payload>>ok or >nok(error)
+	void reply(const string& payload);
+	void replyError(ErrorCodeType error);
+	string composeFrame(uint8_t command, const uint8_t* payload, int length);
+	bool injectFault();
+	void storeResult(ErrorCodeType result);
+	string seqNoStr();
+	bool isRepetition(const CommDefType* comm);
+	void send(const string& str);
+	void log(const string& line);
+
+	// movement of the actuators, samples are played one after the other like the cortex' movement queue
+	void moveTo(const float angle[], int duration_ms);
+	bool queueSample(const float angle[], int duration_ms);
+	void updateMovement(uint32_t now);
+	float getCurrentAngle(int actuatorNo, uint32_t now);
+	string queueState(uint32_t now);
+	void sendTelemetry(uint32_t now);
+
+	std::atomic<int> replyDelay_us;
+	std::atomic<float> dropRate;
+	std::atomic<float> errorRate;
+	EmulatorStatistics statistics;
+
+	int cmdMaster, cmdSlave;
+	int logMaster, logSlave;
+	string cmdDevice, logDevice;
+	string received;
+
+	std::thread* thread;
+	std::atomic<bool> running;
+
+	bool withChecksum;
+	bool withCRC;
+	bool withBinaryFrames;
+	bool withSequenceNumbers;
+	uint8_t seqNo;					// sequence number of the current command, 0 if none
+	bool dropReply;					// reply of the current command gets lost
+	struct SeqNoResult {
+		uint8_t seqNo;
+		ErrorCodeType result;
+	};
+	std::deque<SeqNoResult> history;	// results of the latest commands
+	bool powered;
+	bool setuped;
+	bool enabled;
+	int telemetryPeriod;
+	uint32_t lastTelemetry;
+
+	Actuator actuator[EMULATOR_ACTUATORS];
+	std::deque<Sample> movement;	// first sample is the one currently played
+};
+
+#endif /* CORTEXEMULATOR_H_ */
@@ -0,0 +1,254 @@
+//============================================================================
+// Name        : benchmark.cpp
+// Author      : Jochen Alt
+//
+// Runs the cortex emulator in-process and measures the webserver's
+// communication with it: round trip time, MOVETO rate and retries when
+// replies are lost. Additionally measures the throughput of the checksums.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+
+#include "core.h"
+#include "Util.h"
+#include "CortexController.h"
+#include "CortexEmulator.h"
+#include "logger.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+using namespace std;
+
+CortexEmulator emulator;
+
+void setupLogging() {
+	el::Configurations defaultConf;
+    defaultConf.setToDefault();
+    defaultConf.set(el::Level::Global, el::ConfigurationType::Format, "%datetime %level %msg");
+    defaultConf.set(el::Level::Global, el::ConfigurationType::ToFile, std::string("false"));
+    // results go to cout, retries are expected when faults are injected, so do not flood the console
+    defaultConf.set(el::Level::Global, el::ConfigurationType::Enabled, std::string("false"));
+    el::Loggers::reconfigureLogger("default", defaultConf);
+}
+
+char* getCmdOption(char ** begin, char ** end, const std::string & option)
+{
+    char ** itr = std::find(begin, end, option);
+    if (itr != end && ++itr != end)
+    {
+        return *itr;
+    }
+    return 0;
+}
+
+bool cmdOptionExists(char** begin, char** end, const std::string& option)
+{
+    return std::find(begin, end, option) != end;
+}
+
+void printUsage(string prg) {
+	cout << "usage: " << prg << " [-h] [-delay <us>] [-n <calls>] [-fault <percent>]" << endl
+		 << "  [-delay <us>]       time the emulated cortex takes per command" << endl
+		 << "  [-n <calls>]        number of calls per measurement (default 500)" << endl
+		 << "  [-fault <percent>]  lost and garbled replies in the retry measurement (default 5% each)" << endl
+		 << "  [-h]                help" << endl;
+}
+
+// [us] since the passed time
+double microsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+void printLatency(const string& name, vector<double>& latency) {
+	if (latency.empty())
+		return;
+	std::sort(latency.begin(), latency.end());
+	double sum = 0;
+	for (unsigned i = 0;i<latency.size();i++)
+		sum += latency[i];
+	cout << setw(24) << left << name << right << fixed << setprecision(0)
+		 << " min=" << setw(6) << latency.front() << "us"
+		 << " avg=" << setw(6) << sum/latency.size() << "us"
+		 << " p99=" << setw(6) << latency[(latency.size()*99)/100] << "us"
+		 << " max=" << setw(6) << latency.back() << "us" << endl;
+}
+
+// crc16 as computed before the table has been introduced, to compare with
+uint16_t crc16Bitwise(const uint8_t* data, int length) {
+	uint16_t crc = 0xFFFF;
+	for (int i = 0;i<length;i++) {
+		crc ^= (uint16_t)data[i] << 8;
+		for (int bit = 0;bit<8;bit++) {
+			if (crc & 0x8000)
+				crc = (crc << 1) ^ 0x1021;
+			else
+				crc = crc << 1;
+		}
+	}
+	return crc;
+}
+
+void printThroughput(const string& name, double bytes, double us) {
+	cout << setw(24) << left << name << right << fixed << setprecision(1)
+		 << " " << setw(8) << bytes/us << " MB/s" << endl;
+}
+
+// throughput of hash, bitwise and table driven crc16 over a typical MOVETO command
+void printChecksumThroughput(int calls) {
+	const string line = "MOVETO -12.34 56.78 -90.12 34.56 -78.90 12.34 56.78 100 seq=123";
+	const int runs = calls*1000;
+	volatile uint32_t result = 0; // keeps the loops from being optimized away
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0;i<runs;i++) {
+		uint8_t hash = 0;
+		for (unsigned j = 0;j<line.length();j++)
+			if (line[j] != ' ')
+				hash = ((hash << 5) + hash) + line[j];
+		result = result + hash;
+	}
+	printThroughput("checksum hash", (double)runs*line.length(), microsSince(start));
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0;i<runs;i++)
+		result = result + crc16Bitwise((const uint8_t*)line.data(), line.length());
+	printThroughput("crc16 bitwise", (double)runs*line.length(), microsSince(start));
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0;i<runs;i++)
+		result = result + crc16((const uint8_t*)line.data(), line.length());
+	printThroughput("crc16 table", (double)runs*line.length(), microsSince(start));
+
+	if (crc16Bitwise((const uint8_t*)line.data(), line.length()) != crc16((const uint8_t*)line.data(), line.length()))
+		cout << "crc16 table differs from bitwise computation" << endl;
+}
+
+JointAngles samplePose(int i) {
+	JointAngles angles;
+	for (int j = 0;j<NumberOfActuators;j++)
+		angles[j] = radians(10.0*sin(i*0.01 + j));
+	return angles;
+}
+
+int main(int argc, char *argv[]) {
+	setupLogging();
+
+	if(cmdOptionExists(argv, argv+argc, "-h")) {
+		printUsage(argv[0]);
+		exit(0);
+	}
+
+	EmulatorConfig config;
+	int calls = 500;
+	float faultRate = 0.05;
+	char* arg = getCmdOption(argv, argv + argc, "-delay");
+	if (arg != NULL)
+		config.replyDelay_us = atoi(arg);
+	arg = getCmdOption(argv, argv + argc, "-n");
+	if (arg != NULL)
+		calls = max(1, atoi(arg));
+	arg = getCmdOption(argv, argv + argc, "-fault");
+	if (arg != NULL)
+		faultRate = atof(arg)/100.0;
+
+	printChecksumThroughput(calls);
+
+	if (!emulator.open(config))
+		exit(1);
+	emulator.start();
+
+	CortexController& cortex = CortexController::getInstance();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool ok = cortex.setupCommunication() && cortex.setupBot();
+	if (!ok) {
+		cout << "setup failed (" << getLastErrorMessage() << ")" << endl;
+		exit(1);
+	}
+	cout << "setup communication in " << fixed << setprecision(0) << microsSince(start)/1000.0 << "ms" << endl;
+
+	// round trip of a text command
+	vector<double> latency;
+	for (int i = 0;i<calls;i++) {
+		string response;
+		bool okOrNOk;
+		start = std::chrono::steady_clock::now();
+		cortex.directAccess("ECHO " + int_to_string(i), response, okOrNOk);
+		latency.push_back(microsSince(start));
+	}
+	printLatency("ECHO round trip", latency);
+
+	// round trip of the binary status frame
+	latency.clear();
+	for (int i = 0;i<calls;i++) {
+		ActuatorStateType state[NumberOfActuators];
+		start = std::chrono::steady_clock::now();
+		cortex.getAngles(state);
+		latency.push_back(microsSince(start));
+	}
+	printLatency("STATUS round trip", latency);
+
+	// MOVETO waiting for each reply
+	latency.clear();
+	start = std::chrono::steady_clock::now();
+	for (int i = 0;i<calls;i++) {
+		std::chrono::steady_clock::time_point callStart = std::chrono::steady_clock::now();
+		cortex.move(samplePose(i), 100);
+		latency.push_back(microsSince(callStart));
+	}
+	double rate = calls/(microsSince(start)/1000000.0);
+	printLatency("MOVETO round trip", latency);
+	cout << setw(24) << left << "MOVETO sync" << right << " " << setprecision(0) << rate << " calls/s" << endl;
+
+	// CHUNK pipelined like trajectory execution does, replies are processed while the next samples are sent.
+	// The emulated cortex plays the samples in real time, so most of them are rejected with a full queue. What
+	// counts is the rate of the pipelined round trips. queueAsync drops samples if they pile up, so wait for that
+	int samples = emulator.getStatistics().samples;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0;i<calls;i++) {
+		while (cortex.getUnsentSamples() >= MOVEMENT_QUEUE_SIZE/2)
+			cortex.processReplies();
+		cortex.queueAsync(samplePose(i), 1);
+		cortex.processReplies();
+	}
+	while (cortex.getUnsentSamples() > 0)
+		cortex.processReplies();
+	rate = calls/(microsSince(start)/1000000.0);
+	delay(200);
+	cortex.processReplies();
+	samples = emulator.getStatistics().samples - samples;
+	cout << setw(24) << left << "CHUNK pipelined" << right << " " << setprecision(0) << rate << " samples/s"
+		 << " queued=" << samples << " rejected=" << calls - samples << endl;
+
+	// lose and garble replies, the controller is supposed to retry
+	config.dropRate = faultRate;
+	config.errorRate = faultRate;
+	emulator.configure(config);
+	int received = emulator.getStatistics().commands + emulator.getStatistics().frames;
+	int dropped = emulator.getStatistics().dropped;
+	int repeated = emulator.getStatistics().repeated;
+	int errors = emulator.getStatistics().errors;
+	int failed = 0;
+	latency.clear();
+	for (int i = 0;i<calls;i++) {
+		std::chrono::steady_clock::time_point callStart = std::chrono::steady_clock::now();
+		if (!cortex.move(samplePose(i), 100))
+			failed++;
+		latency.push_back(microsSince(callStart));
+	}
+	received = emulator.getStatistics().commands + emulator.getStatistics().frames - received;
+	printLatency("MOVETO with faults", latency);
+	cout << setw(24) << left << "retries" << right
+		 << " calls=" << calls << " sent=" << received << " retries=" << received - calls
+		 << " dropped=" << emulator.getStatistics().dropped - dropped << " garbled=" << emulator.getStatistics().errors - errors
+		 << " not executed twice=" << emulator.getStatistics().repeated - repeated
+		 << " failed=" << failed << endl;
+
+	emulator.stop();
+	emulator.close();
+	return 0;
+}
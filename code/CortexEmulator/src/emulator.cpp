@@ -0,0 +1,114 @@
+//============================================================================
+// Name        : emulator.cpp
+// Author      : Jochen Alt
+//============================================================================
+
+#include <iostream>
+#include <signal.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "core.h"
+#include "Util.h"
+#include "CortexEmulator.h"
+#include "logger.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+using namespace std;
+
+// commands are dispatched by the emulator itself, the function pointers of CommDef are not used
+void cmdLED(){};
+void cmdPOWER(){};
+void cmdECHO(){};
+void cmdSETUP(){};
+void cmdMOVETO(){};
+void cmdDISABLE(){};
+void cmdENABLE(){};
+void cmdGET(){};
+void cmdSET(){};
+void cmdSTEP(){};
+void cmdMEM(){};
+void cmdCHECKSUM(){};
+void cmdKNOB(){};
+void cmdLOG(){};
+void cmdHELP(){};
+void cmdINFO(){};
+void cmdPRINT(){};
+void cmdPRINTLN(){};
+void cmdBINARY(){};
+void cmdCHUNK(){};
+void cmdSTATUS(){};
+void cmdTELEMETRY(){};
+void cmdSEQ(){};
+
+CortexEmulator emulator;
+
+void signalHandler(int s){
+	// remove the links to the pseudo terminals
+	emulator.close();
+	cout << "Signal " << s << ". Exiting" << endl;
+	exit(1);
+}
+
+void setupLogging() {
+	signal (SIGINT,signalHandler);
+	signal (SIGTERM,signalHandler);
+
+	el::Configurations defaultConf;
+    defaultConf.setToDefault();
+    defaultConf.set(el::Level::Global, el::ConfigurationType::Format, "%datetime %level %msg");
+    defaultConf.set(el::Level::Global, el::ConfigurationType::ToFile, std::string("false"));
+    el::Loggers::reconfigureLogger("default", defaultConf);
+}
+
+char* getCmdOption(char ** begin, char ** end, const std::string & option)
+{
+    char ** itr = std::find(begin, end, option);
+    if (itr != end && ++itr != end)
+    {
+        return *itr;
+    }
+    return 0;
+}
+
+bool cmdOptionExists(char** begin, char** end, const std::string& option)
+{
+    return std::find(begin, end, option) != end;
+}
+
+void printUsage(string prg) {
+	cout << "usage: " << prg << " [-h] [-delay <us>] [-drop <percent>] [-error <percent>]" << endl
+		 << "  emulates the cortex on /dev/" << CORTEX_COMMAND_SERIAL_PORT << " and /dev/" << CORTEX_LOGGER_SERIAL_PORT << endl
+		 << "  [-delay <us>]       time to process a command" << endl
+		 << "  [-drop <percent>]   commands that get no reply" << endl
+		 << "  [-error <percent>]  commands replied with a checksum error" << endl
+		 << "  [-h]                help" << endl;
+}
+
+int main(int argc, char *argv[]) {
+	setupLogging();
+
+	if(cmdOptionExists(argv, argv+argc, "-h")) {
+		printUsage(argv[0]);
+		exit(0);
+	}
+
+	EmulatorConfig config;
+	char* arg = getCmdOption(argv, argv + argc, "-delay");
+	if (arg != NULL)
+		config.replyDelay_us = atoi(arg);
+	arg = getCmdOption(argv, argv + argc, "-drop");
+	if (arg != NULL)
+		config.dropRate = atof(arg)/100.0;
+	arg = getCmdOption(argv, argv + argc, "-error");
+	if (arg != NULL)
+		config.errorRate = atof(arg)/100.0;
+
+	if (!emulator.open(config))
+		exit(1);
+
+	LOG(INFO) << "cortex emulator running, delay=" << config.replyDelay_us << "us drop=" << config.dropRate*100.0 << "% error=" << config.errorRate*100.0 << "%";
+	emulator.run();
+	return 0;
+}
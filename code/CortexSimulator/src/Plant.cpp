@@ -0,0 +1,355 @@
+/*
+ * Plant.cpp
+ *
+ * Author: JochenAlt
+ */
+
+#include "Plant.h"
+#include "BotMemory.h"
+#include "ActuatorProperty.h"
+#include "HerkuleX.h"
+#include "sn3218.h"
+#include "ams_as5048b.h"
+#include "pins.h"
+
+#define HERKULEX_PLAYTIME_UNIT 11.2			// [ms] per unit of play time in S_JOG
+#define HERKULEX_ANGLE_PER_UNIT 0.325		// [°] per position unit
+#define HERKULEX_CENTER_POSITION 512
+#define HERKULEX_POSITION_REG 0x3A			// RAM register of calibrated position
+#define HERKULEX_PWM_REG 0x40				// RAM register of current PWM
+
+// intervals longer than this belong to a stopped or starting stepper and are not counted as jitter
+#define STEPPER_PLANT_MOVING_INTERVAL_NS 10000000ULL
+
+StepperPlant::StepperPlant() {
+	stepperNo = 0;
+	angle = 0;
+	steps = 0;
+	resetStatistics();
+}
+
+void StepperPlant::setup(uint8_t pStepperNo) {
+	stepperNo = pStepperNo;
+	angle = 0;
+	steps = 0;
+	resetStatistics();
+	simSetPinListener(stepperSetup[stepperNo].clockPIN, this);
+}
+
+void StepperPlant::resetStatistics() {
+	pulseStart_ns = 0;
+	lastRise_ns = 0;
+	lastInterval_ns = 0;
+	minInterval_ns = 0;
+	minPulseWidth_ns = 0;
+	sumJitter_ns = 0;
+	maxJitter_ns = 0;
+	jitterSamples = 0;
+}
+
+float StepperPlant::getMaxStepRate() {
+	return (minInterval_ns > 0)?1000000000.0/minInterval_ns:0;
+}
+
+float StepperPlant::getMinPulseWidth_us() {
+	return minPulseWidth_ns/1000.0;
+}
+
+float StepperPlant::getAvgJitter_us() {
+	return (jitterSamples > 0)?sumJitter_ns/1000.0/jitterSamples:0;
+}
+
+float StepperPlant::getMaxJitter_us() {
+	return maxJitter_ns/1000.0;
+}
+
+// the driver does a step with the rising edge of the clock, when enabled. Motors with
+// reverse direction are wired the other way round, so the direction pin has the opposite meaning.
+// Configuration is read with each step, since it is in EEPROM and initialized in setup()
+// Jitter is the change of the interval between two impulses, which is small when the impulses
+// follow the ramp and large when they have to wait for the firmware's loop.
+void StepperPlant::pinChanged(uint8_t pin, uint8_t value) {
+	StepperSetupData& setupData = stepperSetup[stepperNo];
+	uint64_t now = simTime_ns();
+	if (value == HIGH)
+		pulseStart_ns = now;
+	else {
+		uint64_t pulseWidth = now - pulseStart_ns;
+		if ((minPulseWidth_ns == 0) || (pulseWidth < minPulseWidth_ns))
+			minPulseWidth_ns = pulseWidth;
+	}
+	if ((value == HIGH) && (digitalRead(setupData.enablePIN) == HIGH)) {
+		if (lastRise_ns > 0) {
+			uint64_t interval = now - lastRise_ns;
+			if ((minInterval_ns == 0) || (interval < minInterval_ns))
+				minInterval_ns = interval;
+			if ((interval < STEPPER_PLANT_MOVING_INTERVAL_NS) && (lastInterval_ns < STEPPER_PLANT_MOVING_INTERVAL_NS)) {
+				uint64_t jitter = (interval > lastInterval_ns)?interval - lastInterval_ns:lastInterval_ns - interval;
+				sumJitter_ns += jitter;
+				maxJitter_ns = std::max(maxJitter_ns, jitter);
+				jitterSamples++;
+			}
+			lastInterval_ns = interval;
+		} else
+			lastInterval_ns = STEPPER_PLANT_MOVING_INTERVAL_NS;
+		lastRise_ns = now;
+		ActuatorIdentifier id = setupData.id;
+		float anglePerMicroStep = setupData.degreePerStep
+				/ memory.persMem.armConfig[id].config.stepperArm.stepper.microSteps
+				/ actuatorConfigType[id].gearRatio;
+		if ((digitalRead(setupData.directionPIN) == LOW) == setupData.direction)
+			angle += anglePerMicroStep;
+		else
+			angle -= anglePerMicroStep;
+		steps++;
+	}
+}
+
+EncoderPlant::EncoderPlant() {
+	encoderNo = 0;
+	stepper = NULL;
+	noise = 0;
+	registerAddress = 0;
+	lastAngleRegister = 0;
+}
+
+void EncoderPlant::setup(uint8_t pEncoderNo, StepperPlant* pStepper, float pNoise) {
+	encoderNo = pEncoderNo;
+	stepper = pStepper;
+	noise = pNoise;
+	registerAddress = 0;
+}
+
+// 14-bit raw value as the firmware converts it back into the actuator angle
+uint16_t EncoderPlant::angleRegister() {
+	ActuatorIdentifier id = encoderSetup[encoderNo].id;
+	float rawAngle = stepper->getAngle()
+			+ actuatorConfigType[id].angleOffset
+			+ memory.persMem.armConfig[id].config.stepperArm.encoder.nullAngle;
+	if (noise > 0)
+		rawAngle += noise*(random(2001)-1000)/1000.0;
+	rawAngle = fmod(rawAngle, 360.0);
+	if (rawAngle < 0)
+		rawAngle += 360.0;
+	int32_t value = (int32_t)(rawAngle/360.0*AS5048B_RESOLUTION + 0.5) & 0x3FFF;
+	if (encoderSetup[encoderNo].clockwise)
+		value = 0x3FFF - value;
+	return value;
+}
+
+uint8_t EncoderPlant::readRegister(uint8_t reg) {
+	switch (reg) {
+		case AS5048B_ANGLMSB_REG:
+			lastAngleRegister = angleRegister();
+			return (lastAngleRegister >> 6) & 0xFF;
+		case AS5048B_ANGLLSB_REG:
+			return lastAngleRegister & 0x3F;
+		case AS5048B_ADDR_REG:
+			return (encoderSetup[encoderNo].I2CAddress - AS5048_ADDRESS) & 0x03;
+		case AS5048B_MAGNMSB_REG:
+			return 0x80;
+		default:
+			return 0;
+	}
+}
+
+// first byte selects the register, the following are written into it
+bool EncoderPlant::write(const uint8_t* data, size_t len) {
+	if (len > 0)
+		registerAddress = data[0];
+	return true;
+}
+
+// reading auto-increments the register address
+void EncoderPlant::read(uint8_t* data, size_t len) {
+	for (size_t i = 0;i<len;i++)
+		data[i] = readRegister(registerAddress++);
+}
+
+ServoPlant::ServoPlant() {
+	servoNo = 0;
+	startAngle = 0;
+	endAngle = 0;
+	startTime_ns = 0;
+	endTime_ns = 0;
+}
+
+void ServoPlant::setup(uint8_t pServoNo) {
+	servoNo = pServoNo;
+	startAngle = 0;
+	endAngle = 0;
+	startTime_ns = 0;
+	endTime_ns = 0;
+}
+
+// servo moves linearly to the goal position within the play time
+void ServoPlant::move(float toAngle, uint32_t duration_ms) {
+	startAngle = getAngle();
+	endAngle = toAngle;
+	startTime_ns = simTime_ns();
+	endTime_ns = startTime_ns + (uint64_t)duration_ms*1000000;
+}
+
+float ServoPlant::getAngle() {
+	uint64_t now = simTime_ns();
+	if (now >= endTime_ns)
+		return endAngle;
+	float t = float(now - startTime_ns)/float(endTime_ns - startTime_ns);
+	return startAngle + (endAngle - startAngle)*t;
+}
+
+float ServoPlant::getRawAngle() {
+	return getAngle() + memory.persMem.armConfig[getId()].config.servoArm.servo.nullAngle;
+}
+
+HerkulexBusPlant::HerkulexBusPlant() {
+	serial = NULL;
+	servos = NULL;
+	numberOfServos = 0;
+	packetLength = 0;
+}
+
+void HerkulexBusPlant::setup(HardwareSerial* pSerial, ServoPlant pServos[], uint8_t pNumberOfServos) {
+	serial = pSerial;
+	servos = pServos;
+	numberOfServos = pNumberOfServos;
+	packetLength = 0;
+	serial->setListener(this);
+}
+
+ServoPlant* HerkulexBusPlant::getServo(uint8_t herkulexId) {
+	for (int i = 0;i<numberOfServos;i++)
+		if (servos[i].getHerkulexId() == herkulexId)
+			return &servos[i];
+	return NULL;
+}
+
+// <0xFF> <0xFF> <size> <id> <cmd> <ck1> <ck2> <data>
+void HerkulexBusPlant::received(uint8_t b) {
+	if ((packetLength < 2) && (b != 0xFF)) {
+		packetLength = 0;
+		return;
+	}
+	packet[packetLength++] = b;
+	if (packetLength > 2) {
+		uint8_t size = packet[2];
+		if ((size < 7) || (size > sizeof(packet))) {
+			packetLength = 0;
+			return;
+		}
+		if (packetLength == size) {
+			process(packet, size);
+			packetLength = 0;
+		}
+	}
+}
+
+void HerkulexBusPlant::reply(uint8_t id, uint8_t cmd, const uint8_t data[], uint8_t dataLength) {
+	uint8_t packetSize = 7 + dataLength;
+	uint8_t replyPacket[packetSize];
+	replyPacket[0] = 0xFF;
+	replyPacket[1] = 0xFF;
+	replyPacket[2] = packetSize;
+	replyPacket[3] = id;
+	replyPacket[4] = cmd | 0x40;		// ACK packets have bit 6 set
+	uint8_t ck1 = packetSize ^ id ^ replyPacket[4];
+	for (int i = 0;i<dataLength;i++) {
+		replyPacket[7+i] = data[i];
+		ck1 ^= data[i];
+	}
+	replyPacket[5] = ck1 & 0xFE;
+	replyPacket[6] = (~ck1) & 0xFE;
+	serial->inject(replyPacket, packetSize);
+}
+
+void HerkulexBusPlant::process(const uint8_t* p, uint8_t size) {
+	uint8_t id = p[3];
+	uint8_t cmd = p[4];
+	uint8_t ck1 = size ^ id ^ cmd;
+	for (int i = 7;i<size;i++)
+		ck1 ^= p[i];
+	if ((p[5] != (ck1 & 0xFE)) || (p[6] != ((~ck1) & 0xFE)))
+		return;
+
+	switch (cmd) {
+		case HSJOG: {
+			// <playtime> followed by <posLSB> <posMSB> <set> <id> per servo
+			uint32_t duration_ms = p[7]*HERKULEX_PLAYTIME_UNIT;
+			for (int i = 8;i+3<size;i+=4) {
+				ServoPlant* servo = getServo(p[i+3]);
+				if (servo != NULL) {
+					int position = (p[i] | (p[i+1] << 8)) & 0x3FF;
+					float rawAngle = (position - HERKULEX_CENTER_POSITION)*HERKULEX_ANGLE_PER_UNIT;
+					float nullAngle = memory.persMem.armConfig[servo->getId()].config.servoArm.servo.nullAngle;
+					servo->move(rawAngle - nullAngle, duration_ms);
+				}
+			}
+			break;
+		}
+		case HSTAT: {
+			if (getServo(id) != NULL) {
+				uint8_t status[2] = { H_STATUS_OK, 0 };
+				reply(id, cmd, status, sizeof(status));
+			}
+			break;
+		}
+		case HRAMREAD: {
+			ServoPlant* servo = getServo(id);
+			if (servo != NULL) {
+				uint8_t address = p[7];
+				int16_t value = 0;
+				if (address == HERKULEX_POSITION_REG)
+					value = (int16_t)(servo->getRawAngle()/HERKULEX_ANGLE_PER_UNIT + HERKULEX_CENTER_POSITION + 0.5);
+				if (address == HERKULEX_PWM_REG)
+					value = servo->getPWM();
+				uint8_t data[6] = { address, 2, (uint8_t)(value & 0xFF), (uint8_t)((value >> 8) & 0xFF), H_STATUS_OK, 0 };
+				reply(id, cmd, data, sizeof(data));
+			}
+			break;
+		}
+		case HEEPREAD: {
+			ServoPlant* servo = getServo(id);
+			if ((servo != NULL) || (id == BROADCAST_ID)) {
+				uint8_t model[2] = { 0x01, 0x01 };	// DRS-0101
+				reply((servo != NULL)?id:servos[0].getHerkulexId(), cmd, model, sizeof(model));
+			}
+			break;
+		}
+		default:
+			// RAM/EEP write (torque, LED, ACK policy, errors) do not change the plant
+			break;
+	}
+}
+
+Plant::Plant() {
+}
+
+void Plant::setup(float encoderNoise) {
+	for (int i = 0;i<MAX_STEPPERS;i++)
+		steppers[i].setup(i);
+
+	for (int i = 0;i<MAX_ENCODERS;i++) {
+		StepperPlant* stepper = NULL;
+		for (int j = 0;j<MAX_STEPPERS;j++)
+			if (steppers[j].getId() == encoderSetup[i].id)
+				stepper = &steppers[j];
+		encoders[i].setup(i, stepper, encoderNoise);
+		Wires[encoderSetup[i].I2CBusNo]->attach(encoderSetup[i].I2CAddress, &encoders[i]);
+	}
+
+	for (int i = 0;i<MAX_SERVOS;i++)
+		servos[i].setup(i);
+	herkulexBus.setup(servoComm, servos, MAX_SERVOS);
+
+	Wires[I2C1]->attach(SN3218_ADDR, &lights);
+}
+
+float Plant::getAngle(ActuatorIdentifier id) {
+	for (int i = 0;i<MAX_STEPPERS;i++)
+		if (steppers[i].getId() == id)
+			return steppers[i].getAngle();
+	for (int i = 0;i<MAX_SERVOS;i++)
+		if (servos[i].getId() == id)
+			return servos[i].getAngle();
+	return 0;
+}
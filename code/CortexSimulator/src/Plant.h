@@ -0,0 +1,128 @@
+/*
+ * Plant.h
+ *
+ * Models of the hardware the Cortex controls, connected to the simulated HAL:
+ * steppers count the impulses on the clock pins, the AS5048B encoders answer on the I2C buses
+ * with the angle of their stepper, the HerkuleX servos parse the packets on the servo UART and
+ * move linearly to the commanded position within the play time.
+ * All angles are actuator angles as seen by the firmware, the conversion into raw sensor
+ * values is done with the firmware's configuration.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef PLANT_H_
+#define PLANT_H_
+
+#include "Arduino.h"
+#include "i2c_t3.h"
+#include "Config.h"
+
+class StepperPlant : public PinListener {
+public:
+	StepperPlant();
+	void setup(uint8_t stepperNo);
+	virtual void pinChanged(uint8_t pin, uint8_t value);
+
+	ActuatorIdentifier getId() { return stepperSetup[stepperNo].id; };
+	float getAngle() { return angle; };
+	uint32_t getSteps() { return steps; };
+
+	// timing of the impulses
+	void resetStatistics();
+	float getMaxStepRate();					// [steps/s]
+	float getMinPulseWidth_us();
+	float getAvgJitter_us();
+	float getMaxJitter_us();
+private:
+	uint8_t stepperNo;
+	float angle;
+	uint32_t steps;
+
+	uint64_t pulseStart_ns;
+	uint64_t lastRise_ns;
+	uint64_t lastInterval_ns;
+	uint64_t minInterval_ns;
+	uint64_t minPulseWidth_ns;
+	uint64_t sumJitter_ns;
+	uint64_t maxJitter_ns;
+	uint32_t jitterSamples;
+};
+
+class EncoderPlant : public I2CDevice {
+public:
+	EncoderPlant();
+	void setup(uint8_t encoderNo, StepperPlant* stepper, float noise);
+	virtual bool write(const uint8_t* data, size_t len);
+	virtual void read(uint8_t* data, size_t len);
+private:
+	uint8_t readRegister(uint8_t reg);
+	uint16_t angleRegister();
+
+	uint8_t encoderNo;
+	StepperPlant* stepper;
+	float noise;			// [°] max noise of a reading
+	uint8_t registerAddress;
+	uint16_t lastAngleRegister;
+};
+
+class ServoPlant {
+public:
+	ServoPlant();
+	void setup(uint8_t servoNo);
+	void move(float toAngle, uint32_t duration_ms);
+	float getAngle();
+
+	ActuatorIdentifier getId() { return servoSetup[servoNo].id; };
+	uint8_t getHerkulexId() { return servoSetup[servoNo].herkulexMotorId; };
+	float getRawAngle();
+	int16_t getPWM() { return 0; };
+private:
+	uint8_t servoNo;
+	float startAngle;
+	float endAngle;
+	uint64_t startTime_ns;
+	uint64_t endTime_ns;
+};
+
+// HerkuleX servos sharing one UART, replies are put into the receive buffer of the UART
+class HerkulexBusPlant : public SerialListener {
+public:
+	HerkulexBusPlant();
+	void setup(HardwareSerial* serial, ServoPlant servos[], uint8_t numberOfServos);
+	virtual void received(uint8_t b);
+private:
+	void process(const uint8_t* packet, uint8_t size);
+	ServoPlant* getServo(uint8_t herkulexId);
+	void reply(uint8_t id, uint8_t cmd, const uint8_t data[], uint8_t dataLength);
+
+	HardwareSerial* serial;
+	ServoPlant* servos;
+	uint8_t numberOfServos;
+	uint8_t packet[64];
+	uint8_t packetLength;
+};
+
+// panel's PWM controller acknowledges everything
+class LightsPlant : public I2CDevice {
+public:
+	virtual bool write(const uint8_t* data, size_t len) { return true; };
+	virtual void read(uint8_t* data, size_t len) { memset(data, 0, len); };
+};
+
+// all plants of Walter
+class Plant {
+public:
+	Plant();
+	void setup(float encoderNoise);
+	float getAngle(ActuatorIdentifier id);
+	StepperPlant& getStepper(uint8_t stepperNo) { return steppers[stepperNo]; };
+private:
+	StepperPlant steppers[MAX_STEPPERS];
+	EncoderPlant encoders[MAX_ENCODERS];
+	ServoPlant servos[MAX_SERVOS];
+	HerkulexBusPlant herkulexBus;
+	LightsPlant lights;
+};
+
+#endif /* PLANT_H_ */
@@ -0,0 +1,197 @@
+//============================================================================
+// Name        : fixedcheck.cpp
+// Author      : Jochen Alt
+//
+// Compares the fixed point variant of the steppers' trajectory and closed
+// loop (STEPPER_FIXED_POINT) with the float variant on the host. Sweeps the
+// cubic Hermite interpolation of AngleMovement and AngleMovementQueue, and
+// runs both variants of GearedStepperDrive's controller side by side. The
+// fixed point drive is compiled a second time as FixedGearedStepperDrive,
+// see makefile. Returns 1 if one of the variants diverges.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <algorithm>
+#include <math.h>
+
+#include "Arduino.h"
+#include "Config.h"
+#include "Space.h"
+#include "ActuatorProperty.h"
+#include "BotMemory.h"
+
+// float variant as the firmware is built by default
+#include "GearedStepperDrive.h"
+
+// fixed point variant, same header once more under another name
+#undef __MOTORDRIVERSTEPPERIMPL_H__
+#undef STEPPER_FIXED_POINT
+#define STEPPER_FIXED_POINT 1
+#define GearedStepperDrive FixedGearedStepperDrive
+#include "GearedStepperDrive.h"
+#undef GearedStepperDrive
+
+using namespace std;
+
+// maximum deviation of fixed point against float. The ratio of time within a movement has 16 bits only,
+// so angle and speed of the trajectory are compared relative to the size of the movement, plus 1° and 1°/ms
+// for the resolution of Q16.16 itself
+#define TRAJECTORY_TOLERANCE 0.0001		// relative to angles and tangents of the movement
+#define STEPS_TOLERANCE 0.5				// [microsteps] per sample, half of what the step generator can do
+#define INTEGRAL_TOLERANCE 0.5			// [microsteps*s]
+
+struct Deviation {
+	Deviation(const string& pName, double pTolerance) {
+		name = pName;
+		tolerance = pTolerance;
+		max = 0;
+		samples = 0;
+	}
+	void add(double floatValue, double fixedValue, double scale = 1.0) {
+		max = std::max(max, fabs(floatValue - fixedValue)/scale);
+		samples++;
+	}
+	bool print() {
+		bool ok = (max <= tolerance);
+		cout << setw(24) << left << name << right
+			 << " n=" << setw(7) << samples
+			 << " max=" << setw(10) << setprecision(6) << fixed << max
+			 << " tolerance=" << setw(10) << tolerance
+			 << (ok?"  ok":"  diverges") << endl;
+		return ok;
+	}
+	string name;
+	double tolerance;
+	double max;
+	uint32_t samples;
+};
+
+static const float sweepAngle[] = { -170.0, -45.0, -0.5, 0.0, 12.3, 90.0, 179.0 };	// [°]
+static const uint32_t sweepDuration[] = { 1, 7, 20, 56, 300, 2000 };				// [ms]
+static const float sweepSpeedRatio[] = { 0.0, 0.5, 1.0, 3.0 };						// start/end speed relative to the average speed
+
+#define ELEMENTS(array) (sizeof(array)/sizeof(array[0]))
+
+// single movements with all combinations of angles, durations and speeds at start and end
+void checkMovement(Deviation& angle, Deviation& speed) {
+	const uint32_t start = 1000;
+	for (unsigned a = 0;a<ELEMENTS(sweepAngle);a++)
+		for (unsigned b = 0;b<ELEMENTS(sweepAngle);b++)
+			for (unsigned d = 0;d<ELEMENTS(sweepDuration);d++)
+				for (unsigned s = 0;s<ELEMENTS(sweepSpeedRatio);s++)
+					for (unsigned e = 0;e<ELEMENTS(sweepSpeedRatio);e++) {
+						AngleMovement movement;
+						movement.set(sweepAngle[a], sweepAngle[b], start, sweepDuration[d]);
+						float averageSpeed = movement.getAverageSpeed();
+						movement.setSpeed(sweepSpeedRatio[s]*averageSpeed, sweepSpeedRatio[e]*averageSpeed);
+
+						uint32_t duration = sweepDuration[d];
+						float scale = fabs(movement.angleStart) + fabs(movement.angleEnd)
+									+ (fabs(movement.startSpeed) + fabs(movement.endSpeed))*duration + 1.0;
+						uint32_t step = std::max(duration/100, 1U);
+						for (uint32_t now = start;now <= start + duration + 2;now += step) {
+							angle.add(movement.getCurrentAngle(now), fixedToFloat(movement.getCurrentAngleFixed(now)), scale);
+							speed.add(movement.getCurrentSpeed(now), fixedToFloat(movement.getCurrentSpeedFixed(now)), scale/duration + 1.0);
+						}
+					}
+}
+
+// a trajectory streamed in samples like CHUNK does, so the speeds at the junctions are in use
+void checkQueue(Deviation& angle, Deviation& speed) {
+	for (unsigned d = 0;d<ELEMENTS(sweepDuration);d++) {
+		uint32_t sampleDuration = std::max(sweepDuration[d], 5U);
+		for (unsigned a = 0;a<ELEMENTS(sweepAngle);a++) {
+			float amplitude = sweepAngle[a];
+			float scale = fabs(amplitude) + 1.0;
+			AngleMovementQueue<MOVEMENT_QUEUE_SIZE> queue;
+			uint32_t now = 1000;
+			uint32_t sampleTime = now;
+			float sampleAngle = 0;
+
+			// keep the queue filled half, play it in steps of 1ms
+			for (int i = 0;i<200;i++) {
+				while (queue.getTimeAhead(now) < sampleDuration*MOVEMENT_QUEUE_SIZE/2) {
+					sampleTime += sampleDuration;
+					float nextAngle = amplitude*sin(float(sampleTime)*0.002);
+					queue.add(sampleAngle, nextAngle, now, sampleDuration);
+					sampleAngle = nextAngle;
+				}
+				for (uint32_t t = 0;t<sampleDuration;t++,now++) {
+					queue.setTime(now);
+					angle.add(queue.getCurrentAngle(now), fixedToFloat(queue.getCurrentAngleFixed(now)), scale);
+					speed.add(queue.getCurrentSpeed(now), fixedToFloat(queue.getCurrentSpeedFixed(now)), scale/sampleDuration + 1.0);
+				}
+			}
+		}
+	}
+}
+
+// one controller step after the other, float and fixed point drive get the same trajectory and measurements
+void checkController(Deviation& steps, Deviation& integral) {
+	for (int i = 0;i<MAX_STEPPERS;i++) {
+		ActuatorIdentifier id = stepperSetup[i].id;
+		StepperConfig& config = memory.persMem.armConfig[id].config.stepperArm.stepper;
+
+		GearedStepperDrive floatDrive;
+		FixedGearedStepperDrive fixedDrive;
+		floatDrive.setup(&config, &actuatorConfigType[id], &stepperSetup[i], NULL);
+		fixedDrive.setup(&config, &actuatorConfigType[id], &stepperSetup[i], NULL);
+		float stepsPerSecond = 1000.0/float(config.sampleRate);
+
+		uint32_t now = 1000;
+		for (unsigned d = 0;d<ELEMENTS(sweepDuration);d++)
+			for (unsigned a = 0;a<ELEMENTS(sweepAngle);a++) {
+				// start at rest with the controller reset
+				float startAngle = constrain(sweepAngle[a], config.minAngle, config.maxAngle);
+				float endAngle = constrain(sweepAngle[(a+3) % ELEMENTS(sweepAngle)]*0.2, config.minAngle, config.maxAngle);
+				floatDrive.setMeasuredAngle(startAngle, now);
+				fixedDrive.setMeasuredAngle(startAngle, now);
+				floatDrive.setCurrentAngle(startAngle);
+				fixedDrive.setCurrentAngle(startAngle);
+				floatDrive.enable();
+				fixedDrive.enable();
+				floatDrive.movement.set(startAngle, endAngle, now, sweepDuration[d]*10);
+				fixedDrive.movement.set(startAngle, endAngle, now, sweepDuration[d]*10);
+
+				// the measured angle lags behind the trajectory and is noisy
+				uint32_t end = now + sweepDuration[d]*10 + 5*config.sampleRate;
+				for (int n = 0;now < end;n++) {
+					now += config.sampleRate;
+					float lag = 0.5*sin(n*0.7) + 0.05*(n % 3);
+					float measured = floatDrive.movement.getCurrentAngle(now) - lag;
+					floatDrive.setMeasuredAngle(measured, now);
+					fixedDrive.setMeasuredAngle(measured, now);
+
+					steps.add(floatDrive.getStepsPerSecond()/stepsPerSecond, fixedDrive.getStepsPerSecond()/stepsPerSecond);
+					integral.add(floatDrive.getIntegral(), fixedDrive.getIntegral());
+				}
+				floatDrive.disable();
+				fixedDrive.disable();
+			}
+	}
+}
+
+int main(int argc, char *argv[]) {
+	Deviation movementAngle("movement angle", TRAJECTORY_TOLERANCE);
+	Deviation movementSpeed("movement speed", TRAJECTORY_TOLERANCE);
+	Deviation queueAngle("queue angle", TRAJECTORY_TOLERANCE);
+	Deviation queueSpeed("queue speed", TRAJECTORY_TOLERANCE);
+	Deviation controllerSteps("controller steps/sample", STEPS_TOLERANCE);
+	Deviation controllerIntegral("controller integral", INTEGRAL_TOLERANCE);
+
+	checkMovement(movementAngle, movementSpeed);
+	checkQueue(queueAngle, queueSpeed);
+	checkController(controllerSteps, controllerIntegral);
+
+	cout << "deviation of fixed point against float" << endl;
+	bool ok = movementAngle.print();
+	ok = movementSpeed.print() && ok;
+	ok = queueAngle.print() && ok;
+	ok = queueSpeed.print() && ok;
+	ok = controllerSteps.print() && ok;
+	ok = controllerIntegral.print() && ok;
+
+	return ok?0:1;
+}
@@ -0,0 +1,14 @@
+/*
+ * AMS_AS5048B.h
+ *
+ * The Teensy is built on a case-insensitive file system, forwards to ams_as5048b.h
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef SIM_AMS_AS5048B_H_
+#define SIM_AMS_AS5048B_H_
+
+#include "ams_as5048b.h"
+
+#endif /* SIM_AMS_AS5048B_H_ */
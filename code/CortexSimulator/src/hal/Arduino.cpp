@@ -0,0 +1,349 @@
+/*
+ * Arduino.cpp
+ *
+ * Author: JochenAlt
+ */
+
+#include "Arduino.h"
+#include "avr/eeprom.h"
+#include <vector>
+
+static uint64_t now_ns = 0;
+static uint32_t clockCallCost_ns = 250;				// approx. time of micros() on a 120MHz Cortex M4
+static uint32_t interruptCost_ns = 1000;			// approx. time of entering, running and leaving a timer ISR
+static bool interruptsEnabled = true;
+static bool inInterrupt = false;
+static std::vector<IntervalTimer*> timers;
+static uint8_t pinValue[SIM_PINS];
+static PinListener* pinListener[SIM_PINS];
+static int analogValue[SIM_PINS];
+static uint32_t randomState = 1;
+static uint8_t eeprom[SIM_EEPROM_SIZE];
+static bool eepromInitialized = false;
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+HardwareSerial Serial3;
+HardwareSerial Serial4;
+HardwareSerial Serial5;
+HardwareSerial Serial6;
+
+uint64_t simTime_ns() {
+	return now_ns;
+}
+
+// lets the time pass and runs the timer interrupts that are due meanwhile. Each interrupt
+// delays what the firmware is doing by its own running time.
+static void passTime(uint64_t ns) {
+	uint64_t end = now_ns + ns;
+	while (interruptsEnabled && !inInterrupt) {
+		IntervalTimer* next = NULL;
+		for (size_t i = 0;i<timers.size();i++)
+			if ((timers[i]->due_ns <= end) && ((next == NULL) || (timers[i]->due_ns < next->due_ns)))
+				next = timers[i];
+		if (next == NULL)
+			break;
+		now_ns = std::max(now_ns, next->due_ns);
+		next->due_ns += next->period_ns;
+		inInterrupt = true;
+		next->isr();
+		inInterrupt = false;
+		now_ns += interruptCost_ns;
+		end += interruptCost_ns;
+	}
+	now_ns = std::max(now_ns, end);
+}
+
+void simAdvance_ns(uint64_t ns) {
+	passTime(ns);
+}
+
+void simSetClockCallCost(uint32_t ns) {
+	clockCallCost_ns = ns;
+}
+
+void simSetInterruptCost(uint32_t ns) {
+	interruptCost_ns = ns;
+}
+
+uint32_t millis() {
+	passTime(clockCallCost_ns);
+	return (uint32_t)(now_ns / 1000000);
+}
+
+uint32_t micros() {
+	passTime(clockCallCost_ns);
+	return (uint32_t)(now_ns / 1000);
+}
+
+// Teensy's delay calls yield while waiting, which gives the steppers their impulses
+void delay(uint32_t ms) {
+	uint64_t end = now_ns + (uint64_t)ms*1000000;
+	while (now_ns < end) {
+		yield();
+		passTime(std::min(end - now_ns, (uint64_t)10000));
+	}
+}
+
+void delayMicroseconds(uint32_t us) {
+	passTime((uint64_t)us*1000);
+}
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+	if (pin >= SIM_PINS)
+		return;
+	value = value?HIGH:LOW;
+	if (pinValue[pin] != value) {
+		pinValue[pin] = value;
+		if (pinListener[pin] != NULL)
+			pinListener[pin]->pinChanged(pin, value);
+	}
+}
+
+uint8_t digitalRead(uint8_t pin) {
+	return (pin < SIM_PINS)?pinValue[pin]:LOW;
+}
+
+int analogRead(uint8_t pin) {
+	passTime(10000);	// one conversion takes approx. 10us
+	return (pin < SIM_PINS)?analogValue[pin]:0;
+}
+
+void analogReference(uint8_t) {
+}
+
+void simSetPinListener(uint8_t pin, PinListener* listener) {
+	if (pin < SIM_PINS)
+		pinListener[pin] = listener;
+}
+
+void simSetAnalogValue(uint8_t pin, int value) {
+	if (pin < SIM_PINS)
+		analogValue[pin] = value;
+}
+
+// xorshift, the same sequence in every run
+long random(long howbig) {
+	if (howbig <= 0)
+		return 0;
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState % howbig;
+}
+
+long random(long howsmall, long howbig) {
+	if (howsmall >= howbig)
+		return howsmall;
+	return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+	randomState = (seed == 0)?1:seed;
+}
+
+// interrupts that became due meanwhile are run now
+void interrupts() {
+	interruptsEnabled = true;
+	passTime(0);
+}
+
+void noInterrupts() {
+	interruptsEnabled = false;
+}
+
+IntervalTimer::IntervalTimer() {
+	isr = NULL;
+	period_ns = 0;
+	due_ns = 0;
+}
+
+IntervalTimer::~IntervalTimer() {
+	end();
+}
+
+bool IntervalTimer::begin(void (*pIsr)(), unsigned int microseconds) {
+	if ((pIsr == NULL) || (microseconds == 0))
+		return false;
+	end();
+	isr = pIsr;
+	period_ns = (uint64_t)microseconds*1000;
+	due_ns = now_ns + period_ns;
+	timers.push_back(this);
+	return true;
+}
+
+void IntervalTimer::end() {
+	timers.erase(std::remove(timers.begin(), timers.end(), this), timers.end());
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+	size_t n = 0;
+	while (size--)
+		n += write(*buffer++);
+	return n;
+}
+
+size_t Print::print(long n, int base) {
+	if ((n < 0) && (base == DEC))
+		return print('-') + print((unsigned long)-n, base);
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+	char buf[8 * sizeof(long) + 1];
+	char* str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+	if (base < 2)
+		base = 10;
+	do {
+		unsigned long m = n;
+		n /= base;
+		char c = m - base * n;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+	return write(str);
+}
+
+size_t Print::print(double number, int digits) {
+	if (std::isnan(number))
+		return print("nan");
+	if (std::isinf(number))
+		return print("inf");
+
+	size_t n = 0;
+	if (number < 0.0) {
+		n += print('-');
+		number = -number;
+	}
+
+	// round correctly so that print(1.999, 2) prints as "2.00"
+	double rounding = 0.5;
+	for (int i = 0;i<digits;i++)
+		rounding /= 10.0;
+	number += rounding;
+
+	unsigned long intPart = (unsigned long)number;
+	double remainder = number - (double)intPart;
+	n += print(intPart);
+	if (digits > 0)
+		n += print('.');
+	while (digits-- > 0) {
+		remainder *= 10.0;
+		int toPrint = int(remainder);
+		n += print((char)('0' + toPrint));
+		remainder -= toPrint;
+	}
+	return n;
+}
+
+HardwareSerial::HardwareSerial() {
+	listener = NULL;
+	baud = 115200;
+	txDone_ns = 0;
+	txBufferSize = SIM_SERIAL_TX_BUFFER;
+	bytesSent = 0;
+}
+
+void HardwareSerial::begin(uint32_t pBaud) {
+	baud = pBaud;
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+	// start bit, 8 data bits, stop bit
+	uint64_t byteTime_ns = 10ULL*1000000000ULL/baud;
+	if (txDone_ns < now_ns)
+		txDone_ns = now_ns;
+
+	// buffer is full, wait until one byte has been sent
+	uint64_t bufferTime_ns = txBufferSize*byteTime_ns;
+	if (txDone_ns - now_ns > bufferTime_ns)
+		passTime(txDone_ns - bufferTime_ns - now_ns);
+	txDone_ns += byteTime_ns;
+
+	bytesSent++;
+	if (listener != NULL)
+		listener->received(b);
+	return 1;
+}
+
+// the buffer itself is not used, the transmit buffer is modelled by its size only
+void HardwareSerial::addMemoryForWrite(void* buffer, size_t size) {
+	txBufferSize = SIM_SERIAL_TX_BUFFER + size;
+}
+
+// room in the transmit buffer, a byte in transmission counts as occupied
+int HardwareSerial::availableForWrite() {
+	if (txDone_ns <= now_ns)
+		return txBufferSize;
+	uint64_t byteTime_ns = 10ULL*1000000000ULL/baud;
+	int pending = (txDone_ns - now_ns + byteTime_ns - 1)/byteTime_ns;
+	return max((int)txBufferSize - pending, 0);
+}
+
+int HardwareSerial::available() {
+	return rx.size();
+}
+
+int HardwareSerial::read() {
+	if (rx.empty())
+		return -1;
+	uint8_t b = rx.front();
+	rx.pop_front();
+	return b;
+}
+
+int HardwareSerial::peek() {
+	if (rx.empty())
+		return -1;
+	return rx.front();
+}
+
+// wait until everything has been sent
+void HardwareSerial::flush() {
+	if (txDone_ns > now_ns)
+		passTime(txDone_ns - now_ns);
+}
+
+void HardwareSerial::inject(const uint8_t* data, size_t size) {
+	rx.insert(rx.end(), data, data + size);
+}
+
+// EEPROM is erased at the start of a simulation, so the firmware initializes its memory
+static uint8_t* eepromAddress(const void* addr, size_t len) {
+	if (!eepromInitialized) {
+		memset(eeprom, 0xFF, sizeof(eeprom));
+		eepromInitialized = true;
+	}
+	size_t offset = (size_t)addr;
+	if (offset + len > SIM_EEPROM_SIZE)
+		return NULL;
+	return &eeprom[offset];
+}
+
+void eeprom_read_block(void* dst, const void* addr, size_t len) {
+	uint8_t* src = eepromAddress(addr, len);
+	if (src != NULL)
+		memcpy(dst, src, len);
+}
+
+void eeprom_write_block(const void* src, void* addr, size_t len) {
+	uint8_t* dst = eepromAddress(addr, len);
+	if (dst != NULL)
+		memcpy(dst, src, len);
+	passTime((uint64_t)len*50000);	// writing a byte takes approx. 50us
+}
+
+uint16_t eeprom_read_word(const uint16_t* addr) {
+	uint16_t value = 0xFFFF;
+	eeprom_read_block(&value, addr, sizeof(value));
+	return value;
+}
+
+void eeprom_write_word(uint16_t* addr, uint16_t value) {
+	eeprom_write_block(&value, addr, sizeof(value));
+}
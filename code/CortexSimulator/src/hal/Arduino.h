@@ -0,0 +1,203 @@
+/*
+ * Arduino.h
+ *
+ * Simulated Teensy 3.5 core to compile the Cortex' sources on Linux. Time is virtual and
+ * advances only when the firmware waits (delay, delayMicroseconds, busy serial or i2c
+ * lines) or when the simulator runs the next loop, so a run is deterministic and
+ * faster than real time. Timer interrupts run when the virtual time passes their due time.
+ * Pins, UARTs and EEPROM are in memory, the plant models listen to pins and UARTs to
+ * follow the firmware.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef SIM_ARDUINO_H_
+#define SIM_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <math.h>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <deque>
+#include <type_traits>
+
+using std::abs;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define DEFAULT 0
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+#define _BV(bit) (1 << (bit))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+// mixed types are allowed, like the macros of the Teensy core
+template<class A, class B> inline typename std::common_type<A,B>::type min(A a, B b) { return (b < a)?b:a; }
+template<class A, class B> inline typename std::common_type<A,B>::type max(A a, B b) { return (a < b)?b:a; }
+
+// strings in flash are plain strings here
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper*)(s))
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+
+// virtual time
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();									// implemented by the firmware, called while waiting
+
+// pins
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+inline void digitalWriteFast(uint8_t pin, uint8_t value) { digitalWrite(pin, value); }
+uint8_t digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReference(uint8_t type);
+
+// deterministic random numbers
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+void interrupts();
+void noInterrupts();
+
+// Teensy's periodic timer interrupt. The interrupt service routine is called whenever
+// the virtual time passes its due time, unless interrupts are disabled.
+class IntervalTimer {
+public:
+	IntervalTimer();
+	~IntervalTimer();
+	bool begin(void (*isr)(), unsigned int microseconds);
+	void end();
+	void priority(uint8_t) {};
+
+	// simulator side
+	void (*isr)();
+	uint64_t period_ns;
+	uint64_t due_ns;
+};
+
+// Arduino's Print, numbers are printed as on the Teensy
+class Print {
+public:
+	virtual ~Print() {};
+	virtual size_t write(uint8_t b) = 0;
+	virtual size_t write(const uint8_t* buffer, size_t size);
+	size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); };
+
+	size_t print(const __FlashStringHelper* s) { return print((const char*)s); };
+	size_t print(const char* s) { return write(s); };
+	size_t print(char c) { return write((uint8_t)c); };
+	size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); };
+	size_t print(int n, int base = DEC) { return print((long)n, base); };
+	size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); };
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+	size_t print(double n, int digits = 2);
+
+	size_t println() { return write("\r\n"); };
+	template<class T> size_t println(T value) { size_t n = print(value); return n + println(); };
+	template<class T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); };
+};
+
+class Stream : public Print {
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+	virtual void flush() = 0;
+};
+
+// Receiver of what the firmware sends on a UART, i.e. a plant model or the simulator
+class SerialListener {
+public:
+	virtual ~SerialListener() {};
+	virtual void received(uint8_t b) = 0;
+};
+
+// UART with a transmit buffer. When the buffer is full, write waits for the transmission
+// of one byte at the baud rate, like the Teensy core does.
+class HardwareSerial : public Stream {
+public:
+	HardwareSerial();
+	void begin(uint32_t baud);
+	void end() {};
+	operator bool() { return true; };
+
+	virtual size_t write(uint8_t b);
+	using Print::write;
+	virtual int available();
+	virtual int read();
+	virtual int peek();
+	virtual void flush();
+	void addMemoryForRead(void* buffer, size_t size) {};	// receive buffer is unbounded anyway
+	void addMemoryForWrite(void* buffer, size_t size);
+	int availableForWrite();
+
+	// simulator side: what the firmware sends goes to the listener, inject feeds the receive buffer
+	void setListener(SerialListener* pListener) { listener = pListener; };
+	void inject(const uint8_t* data, size_t size);
+	void inject(const char* str) { inject((const uint8_t*)str, strlen(str)); };
+	uint32_t getBytesSent() { return bytesSent; };
+private:
+	std::deque<uint8_t> rx;
+	SerialListener* listener;
+	uint32_t baud;
+	uint64_t txDone_ns;						// time the transmit buffer is empty
+	uint32_t txBufferSize;					// [bytes]
+	uint32_t bytesSent;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+extern HardwareSerial Serial4;
+extern HardwareSerial Serial5;
+extern HardwareSerial Serial6;
+
+// Simulator side of the HAL
+#define SIM_PINS 64
+#define SIM_SERIAL_TX_BUFFER 64				// [bytes] of the Teensy's UART transmit buffer
+
+// Receiver of pin changes, i.e. a plant model
+class PinListener {
+public:
+	virtual ~PinListener() {};
+	virtual void pinChanged(uint8_t pin, uint8_t value) = 0;
+};
+
+void simSetPinListener(uint8_t pin, PinListener* listener);
+void simSetAnalogValue(uint8_t pin, int value);
+
+// virtual clock in [ns]. simAdvance lets the simulated time pass without calling yield
+uint64_t simTime_ns();
+void simAdvance_ns(uint64_t ns);
+
+// cost of reading the clock. Busy loops on micros() terminate this way.
+void simSetClockCallCost(uint32_t ns);
+
+// time one timer interrupt takes away from the firmware's loop
+void simSetInterruptCost(uint32_t ns);
+
+#endif /* SIM_ARDUINO_H_ */
@@ -0,0 +1,12 @@
+/*
+ * EEPROM.h
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef SIM_EEPROM_H_
+#define SIM_EEPROM_H_
+
+#include "avr/eeprom.h"
+
+#endif /* SIM_EEPROM_H_ */
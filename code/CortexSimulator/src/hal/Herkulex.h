@@ -0,0 +1,14 @@
+/*
+ * Herkulex.h
+ *
+ * The Teensy is built on a case-insensitive file system, forwards to HerkuleX.h
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef SIM_HERKULEX_H_
+#define SIM_HERKULEX_H_
+
+#include "HerkuleX.h"
+
+#endif /* SIM_HERKULEX_H_ */
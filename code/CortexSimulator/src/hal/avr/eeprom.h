@@ -0,0 +1,22 @@
+/*
+ * eeprom.h
+ *
+ * Simulated EEPROM of the Teensy, addresses are passed as pointers like in avr-libc.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef SIM_AVR_EEPROM_H_
+#define SIM_AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SIM_EEPROM_SIZE 4096
+
+void eeprom_read_block(void* dst, const void* addr, size_t len);
+void eeprom_write_block(const void* src, void* addr, size_t len);
+uint16_t eeprom_read_word(const uint16_t* addr);
+void eeprom_write_word(uint16_t* addr, uint16_t value);
+
+#endif /* SIM_AVR_EEPROM_H_ */
@@ -0,0 +1,14 @@
+/*
+ * hostCommunication.h
+ *
+ * The Teensy is built on a case-insensitive file system, forwards to HostCommunication.h
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef SIM_HOSTCOMMUNICATION_H_
+#define SIM_HOSTCOMMUNICATION_H_
+
+#include "HostCommunication.h"
+
+#endif /* SIM_HOSTCOMMUNICATION_H_ */
@@ -0,0 +1,123 @@
+/*
+ * i2c_t3.cpp
+ *
+ * Author: JochenAlt
+ */
+
+#include "i2c_t3.h"
+
+i2c_t3 Wire;
+i2c_t3 Wire1;
+
+i2c_t3::i2c_t3() {
+	for (int i = 0;i<128;i++)
+		devices[i] = NULL;
+	rate = I2C_RATE_100;
+	currentStatus = I2C_WAITING;
+	txAddress = 0;
+	txLen = 0;
+	rxLen = 0;
+	rxIdx = 0;
+	transactions = 0;
+	busyUntil_ns = 0;
+	busyStatus = I2C_WAITING;
+}
+
+void i2c_t3::attach(uint8_t address, I2CDevice* device) {
+	devices[address & 0x7F] = device;
+}
+
+// start condition, address byte and data bytes with 9 clocks each, and the stop condition
+uint64_t i2c_t3::transferTime(size_t bytes) {
+	transactions++;
+	return ((uint64_t)(bytes+1)*9 + 2)*1000000000ULL/rate;
+}
+
+i2c_status i2c_t3::status() {
+	return (simTime_ns() < busyUntil_ns)?busyStatus:currentStatus;
+}
+
+void i2c_t3::beginTransmission(uint8_t address) {
+	txAddress = address & 0x7F;
+	txLen = 0;
+}
+
+size_t i2c_t3::write(uint8_t data) {
+	if (txLen >= I2C_BUFFER_LENGTH) {
+		currentStatus = I2C_BUF_OVF;
+		return 0;
+	}
+	txBuffer[txLen++] = data;
+	return 1;
+}
+
+// the device gets or delivers the data with the start of the transaction, returns its duration
+uint64_t i2c_t3::transmit() {
+	I2CDevice* device = devices[txAddress];
+	if (device == NULL) {
+		currentStatus = I2C_ADDR_NAK;
+		return transferTime(0);
+	}
+	currentStatus = device->write(txBuffer, txLen)?I2C_WAITING:I2C_DATA_NAK;
+	return transferTime(txLen);
+}
+
+uint64_t i2c_t3::receive(uint8_t addr, size_t len) {
+	rxIdx = 0;
+	rxLen = 0;
+	I2CDevice* device = devices[addr & 0x7F];
+	if (device == NULL) {
+		currentStatus = I2C_ADDR_NAK;
+		return transferTime(0);
+	}
+	len = std::min(len, (size_t)I2C_BUFFER_LENGTH);
+	device->read(rxBuffer, len);
+	rxLen = len;
+	currentStatus = I2C_WAITING;
+	return transferTime(len);
+}
+
+uint8_t i2c_t3::endTransmission(i2c_stop sendStop, uint32_t timeout) {
+	finish();
+	simAdvance_ns(transmit());
+	return getError();
+}
+
+size_t i2c_t3::requestFrom(uint8_t addr, size_t len, i2c_stop sendStop, uint32_t timeout) {
+	finish();
+	simAdvance_ns(receive(addr, len));
+	return rxLen;
+}
+
+void i2c_t3::sendTransmission(i2c_stop sendStop) {
+	finish();
+	busyStatus = I2C_SENDING;
+	busyUntil_ns = simTime_ns() + transmit();
+}
+
+void i2c_t3::sendRequest(uint8_t addr, size_t len, i2c_stop sendStop) {
+	finish();
+	busyStatus = I2C_RECEIVING;
+	busyUntil_ns = simTime_ns() + receive(addr, len);
+}
+
+uint8_t i2c_t3::done() {
+	return simTime_ns() >= busyUntil_ns;
+}
+
+// waits until the running transaction is done
+uint8_t i2c_t3::finish() {
+	if (!done())
+		simAdvance_ns(busyUntil_ns - simTime_ns());
+	return currentStatus == I2C_WAITING;
+}
+
+uint8_t i2c_t3::getError() {
+	switch (currentStatus) {
+		case I2C_WAITING:	return 0;
+		case I2C_BUF_OVF:	return 1;
+		case I2C_ADDR_NAK:	return 2;
+		case I2C_DATA_NAK:	return 3;
+		default:			return 4;
+	}
+}
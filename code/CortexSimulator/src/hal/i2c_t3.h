@@ -0,0 +1,118 @@
+/*
+ * i2c_t3.h
+ *
+ * Simulated I2C bus with the interface of the Teensy's i2c_t3 library. Devices are
+ * plant models registered at their address, a transaction takes the time
+ * of its bits at the bus rate. Blocking transactions let the virtual time pass,
+ * non-blocking ones (sendTransmission, sendRequest) are done when the virtual
+ * time passed their end.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef SIM_I2C_T3_H_
+#define SIM_I2C_T3_H_
+
+#include "Arduino.h"
+
+#define I2C_BUFFER_LENGTH 32
+
+enum i2c_op_mode  {I2C_OP_MODE_IMM, I2C_OP_MODE_ISR, I2C_OP_MODE_DMA};
+enum i2c_rate     {I2C_RATE_100  = 100000,
+                   I2C_RATE_200  = 200000,
+                   I2C_RATE_300  = 300000,
+                   I2C_RATE_400  = 400000,
+                   I2C_RATE_600  = 600000,
+                   I2C_RATE_800  = 800000,
+                   I2C_RATE_1000 = 1000000,
+                   I2C_RATE_1200 = 1200000,
+                   I2C_RATE_1500 = 1500000,
+                   I2C_RATE_1800 = 1800000,
+                   I2C_RATE_2000 = 2000000,
+                   I2C_RATE_2400 = 2400000,
+                   I2C_RATE_2800 = 2800000,
+                   I2C_RATE_3000 = 3000000};
+enum i2c_stop     {I2C_NOSTOP, I2C_STOP};
+enum i2c_status   {I2C_WAITING,
+                   I2C_SENDING,
+                   I2C_SEND_ADDR,
+                   I2C_RECEIVING,
+                   I2C_TIMEOUT,
+                   I2C_ADDR_NAK,
+                   I2C_DATA_NAK,
+                   I2C_ARB_LOST,
+                   I2C_BUF_OVF,
+                   I2C_SLAVE_TX,
+                   I2C_SLAVE_RX};
+
+// slave on the simulated bus, i.e. a plant model
+class I2CDevice {
+public:
+	virtual ~I2CDevice() {};
+	// master wrote data, returns false if not acknowledged
+	virtual bool write(const uint8_t* data, size_t len) = 0;
+	// master reads len bytes
+	virtual void read(uint8_t* data, size_t len) = 0;
+};
+
+class i2c_t3 : public Stream {
+public:
+	i2c_t3();
+
+	void begin() {};
+	void setDefaultTimeout(uint32_t timeout) {};
+	uint8_t setRate(i2c_rate pRate) { rate = pRate; return 1; };
+	void setClock(uint32_t freq) { rate = freq; };
+	void resetBus() { busyUntil_ns = 0; currentStatus = I2C_WAITING; };
+	i2c_status status();
+
+	void beginTransmission(uint8_t address);
+	uint8_t endTransmission(i2c_stop sendStop, uint32_t timeout);
+	uint8_t endTransmission() { return endTransmission(I2C_STOP, 0); };
+	uint8_t endTransmission(i2c_stop sendStop) { return endTransmission(sendStop, 0); };
+	uint8_t endTransmission(uint8_t sendStop) { return endTransmission((i2c_stop)sendStop, 0); };
+	size_t requestFrom(uint8_t addr, size_t len, i2c_stop sendStop, uint32_t timeout);
+	size_t requestFrom(uint8_t addr, size_t len) { return requestFrom(addr, len, I2C_STOP, 0); };
+	size_t requestFrom(int addr, int len) { return requestFrom((uint8_t)addr, (size_t)len, I2C_STOP, 0); };
+	uint8_t requestFrom(uint8_t addr, uint8_t len) { return requestFrom(addr, (size_t)len, I2C_STOP, 0); };
+
+	// non-blocking
+	void sendTransmission(i2c_stop sendStop);
+	void sendRequest(uint8_t addr, size_t len, i2c_stop sendStop);
+	uint8_t done();
+	uint8_t finish();
+	uint8_t getError();
+
+	virtual size_t write(uint8_t data);
+	using Print::write;
+	virtual int available() { return rxLen - rxIdx; };
+	virtual int read() { return (rxIdx < rxLen)?rxBuffer[rxIdx++]:-1; };
+	virtual int peek() { return (rxIdx < rxLen)?rxBuffer[rxIdx]:-1; };
+	virtual void flush() {};
+
+	// simulator side
+	void attach(uint8_t address, I2CDevice* device);
+	uint32_t getTransactions() { return transactions; };
+private:
+	uint64_t transferTime(size_t bytes);
+	uint64_t transmit();
+	uint64_t receive(uint8_t addr, size_t len);
+
+	I2CDevice* devices[128];
+	uint32_t rate;
+	i2c_status currentStatus;
+	uint8_t txAddress;
+	uint8_t txBuffer[I2C_BUFFER_LENGTH];
+	size_t txLen;
+	uint8_t rxBuffer[I2C_BUFFER_LENGTH];
+	size_t rxLen;
+	size_t rxIdx;
+	uint32_t transactions;
+	uint64_t busyUntil_ns;					// end of the running non-blocking transaction
+	i2c_status busyStatus;					// status while it is running
+};
+
+extern i2c_t3 Wire;
+extern i2c_t3 Wire1;
+
+#endif /* SIM_I2C_T3_H_ */
@@ -0,0 +1,369 @@
+//============================================================================
+// Name        : simulator.cpp
+// Author      : Jochen Alt
+//
+// Runs the Cortex' firmware on Linux against the simulated HAL and the plant
+// models of steppers, encoders and servos. Time is virtual, so a run is
+// deterministic and faster than real time. Streams MOVETO commands of a
+// sinusoidal trajectory and measures the loop timing, the timing of the
+// stepper impulses and the tracking error. With -profile, the firmware's
+// profiler reports on the log UART and its lines are parsed like the
+// webserver does. -check runs the profiler by simulated time and returns 1
+// if its report is incomplete or inconsistent.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+
+#include "Arduino.h"
+#include "Plant.h"
+#include "Config.h"
+#include "pins.h"
+#include "CommDef.h"
+#include "Profiler.h"
+
+using namespace std;
+
+// firmware's entry points in main.cpp
+void setup();
+void loop();
+
+static const char* actuatorName[MAX_ACTUATORS] = { "hip", "upperarm", "forearm", "ellbow", "wrist", "hand", "gripper" };
+
+// amplitude and period of the reference trajectory per actuator, which starts at 0° at rest
+static const float trajectoryAmplitude[MAX_ACTUATORS] = { 20.0, 10.0, 15.0, 20.0, 30.0, 30.0, 20.0 };	// [°]
+static const float trajectoryPeriod[MAX_ACTUATORS] = { 4.0, 6.0, 3.0, 5.0, 2.0, 3.0, 2.5 };				// [s]
+
+Plant plant;
+
+// collects what the firmware sends on the command UART
+class ReplyCollector : public SerialListener {
+public:
+	virtual void received(uint8_t b) { reply += (char)b; };
+
+	// true if a complete reply >ok or >nok(...) came in
+	bool isComplete() {
+		size_t idx = reply.find(">ok");
+		if (idx == string::npos)
+			idx = reply.find(">nok(");
+		return (idx != string::npos) && (reply.find("\r\n>", idx) != string::npos);
+	}
+	bool isOk() { return reply.find(">ok") != string::npos; };
+	string reply;
+};
+
+// prints the log UART, if requested, and keeps the latest complete profile report
+class LogPrinter : public SerialListener {
+public:
+	LogPrinter() {
+		enabled = false;
+		for (int i = 0;i<NumberOfProfileSections;i++)
+			profile[i].count = 0;
+		profileLines = 0;
+		reports = 0;
+		errors = 0;
+		pendingSections = 0;
+	};
+	virtual void received(uint8_t b) {
+		if (enabled && (b != '\r'))
+			cout << (char)b;
+		if (b == '\n') {
+			ProfileRecord record;
+			if (parseProfileLine(line.c_str(), record)) {
+				check(record);
+				if (record.section == 0)
+					pendingSections = 0;
+				pending[record.section] = record;
+				pendingSections |= 1 << record.section;
+				profileLines++;
+				if (record.section == NumberOfProfileSections-1) {
+					if (pendingSections != (1 << NumberOfProfileSections)-1)
+						error("report without all sections", line);
+					std::copy(pending, pending + NumberOfProfileSections, profile);
+					reports++;
+				}
+			} else if (line.compare(0, strlen(PROFILE_LOG_PREFIX), PROFILE_LOG_PREFIX) == 0)
+				error("line not parsed", line);
+			line = "";
+		} else if (b != '\r')
+			line += (char)b;
+	};
+
+	// a parsed line has to come out the same when printed like the profiler does, and has to be consistent in itself
+	void check(const ProfileRecord& record) {
+		char printed[256];
+		int length = sprintf(printed, "%s%s n=%lu min=%.1f avg=%.1f max=%.1f hist=", PROFILE_LOG_PREFIX,
+				profileSectionName[record.section], (unsigned long)record.count, record.min_us, record.avg_us, record.max_us);
+		uint32_t sum = 0;
+		for (int i = 0;i<PROFILE_HISTOGRAM_BINS;i++) {
+			length += sprintf(printed + length, "%s%lu", (i > 0)?",":"", (unsigned long)record.histogram[i]);
+			sum += record.histogram[i];
+		}
+		ProfileRecord reparsed;
+		if ((line != printed) || !parseProfileLine(printed, reparsed))
+			error("round trip differs", line);
+		if ((record.count > 0) && ((record.min_us > record.avg_us) || (record.avg_us > record.max_us)))
+			error("min<=avg<=max violated", line);
+		if (sum != record.count)
+			error("histogram does not sum up to n", line);
+	}
+	void error(const char* what, const string& line) {
+		cout << "profile check: " << what << ": " << line << endl;
+		errors++;
+	}
+
+	bool enabled;
+	string line;
+	ProfileRecord pending[NumberOfProfileSections];		// report that is coming in
+	ProfileRecord profile[NumberOfProfileSections];		// latest complete report
+	uint32_t profileLines;
+	uint32_t reports;									// complete reports
+	uint32_t errors;									// found by check
+	uint32_t pendingSections;							// bit per section of the report coming in
+};
+
+ReplyCollector replies;
+LogPrinter logPrinter;
+
+struct LoopStatistics {
+	LoopStatistics() {
+		loops = 0;
+		sumPeriod_us = 0;
+		maxPeriod_us = 0;
+		sumWall_us = 0;
+		maxWall_us = 0;
+	}
+	uint32_t loops;
+	double sumPeriod_us;		// virtual time between two loops
+	double maxPeriod_us;
+	double sumWall_us;			// host time of one loop
+	double maxWall_us;
+};
+
+struct TrackingStatistics {
+	TrackingStatistics() {
+		samples = 0;
+		for (int i = 0;i<MAX_ACTUATORS;i++) {
+			sumSquare[i] = 0;
+			maxError[i] = 0;
+		}
+	}
+	uint32_t samples;
+	double sumSquare[MAX_ACTUATORS];
+	double maxError[MAX_ACTUATORS];
+};
+
+LoopStatistics loopStat;
+uint32_t loopOverhead_ns = 20000;	// time of one loop that is not spent in the HAL
+
+double secondsSinceStart() {
+	return simTime_ns()/1000000000.0;
+}
+
+// clock of the profiler in simulated time, includes the waiting for i2c, UARTs and the like
+uint32_t simulatedClock() {
+	return (uint32_t)simTime_ns();
+}
+
+// one loop of the firmware, takes the configured overhead in virtual time
+void runLoop() {
+	static uint64_t lastLoop_ns = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	uint64_t start_ns = simTime_ns();
+
+	loop();
+	simAdvance_ns(loopOverhead_ns);
+
+	double wall_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	if (lastLoop_ns > 0) {
+		double period_us = (start_ns - lastLoop_ns)/1000.0;
+		loopStat.sumPeriod_us += period_us;
+		loopStat.maxPeriod_us = max(loopStat.maxPeriod_us, period_us);
+	}
+	lastLoop_ns = start_ns;
+	loopStat.sumWall_us += wall_us;
+	loopStat.maxWall_us = max(loopStat.maxWall_us, wall_us);
+	loopStat.loops++;
+}
+
+// sends a command to the firmware and runs the loop until the reply came in
+bool command(const string& cmd, uint32_t timeout_ms = 10000) {
+	replies.reply = "";
+	Serial5.inject((cmd + "\r").c_str());
+	uint64_t end_ns = simTime_ns() + (uint64_t)timeout_ms*1000000;
+	while (!replies.isComplete() && (simTime_ns() < end_ns))
+		runLoop();
+	if (!replies.isOk()) {
+		cout << cmd << " failed: " << replies.reply << endl;
+		return false;
+	}
+	return true;
+}
+
+float referenceAngle(int actuatorNo, double t) {
+	return trajectoryAmplitude[actuatorNo]*(1.0 - cos(2.0*PI*t/trajectoryPeriod[actuatorNo]));
+}
+
+char* getCmdOption(char ** begin, char ** end, const std::string & option)
+{
+    char ** itr = std::find(begin, end, option);
+    if (itr != end && ++itr != end)
+    {
+        return *itr;
+    }
+    return 0;
+}
+
+bool cmdOptionExists(char** begin, char** end, const std::string& option)
+{
+    return std::find(begin, end, option) != end;
+}
+
+void printUsage(string prg) {
+	cout << "usage: " << prg << " [-h] [-t <s>] [-sample <ms>] [-overhead <us>] [-noise <deg>] [-profile <host|sim>] [-log] [-check]" << endl
+		 << "  [-t <s>]             simulated time of the trajectory (default 10s)" << endl
+		 << "  [-sample <ms>]       period of MOVETO commands (default 100ms)" << endl
+		 << "  [-overhead <us>]     computing time of one loop besides I/O (default 20us)" << endl
+		 << "  [-noise <deg>]       noise of encoder readings (default 0)" << endl
+		 << "  [-profile <host|sim>] profile the loop's sections by host clock or simulated time" << endl
+		 << "  [-log]               print the cortex' log" << endl
+		 << "  [-check]             profile by simulated time, return 1 if the report is incomplete or inconsistent" << endl
+		 << "  [-h]                 help" << endl;
+}
+
+int main(int argc, char *argv[]) {
+	if(cmdOptionExists(argv, argv+argc, "-h")) {
+		printUsage(argv[0]);
+		exit(0);
+	}
+
+	double duration_s = 10.0;
+	uint32_t sample_ms = 100;
+	float encoderNoise = 0;
+	char* arg = getCmdOption(argv, argv + argc, "-t");
+	if (arg != NULL)
+		duration_s = atof(arg);
+	arg = getCmdOption(argv, argv + argc, "-sample");
+	if (arg != NULL)
+		sample_ms = max(20, atoi(arg));
+	arg = getCmdOption(argv, argv + argc, "-overhead");
+	if (arg != NULL)
+		loopOverhead_ns = atoi(arg)*1000;
+	arg = getCmdOption(argv, argv + argc, "-noise");
+	if (arg != NULL)
+		encoderNoise = atof(arg);
+	logPrinter.enabled = cmdOptionExists(argv, argv+argc, "-log");
+	char* profileClock = getCmdOption(argv, argv + argc, "-profile");
+	bool checkProfile = cmdOptionExists(argv, argv+argc, "-check");
+	if (checkProfile)
+		profileClock = (char*)"sim";
+
+	cmdSerial->setListener(&replies);
+	logger->setListener(&logPrinter);
+	simSetAnalogValue(MOTOR_KNOB_PIN, 512);
+	plant.setup(encoderNoise);
+
+	std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+	setup();
+	if (!command("SETUP") || !command("POWER on") || !command("ENABLE"))
+		exit(1);
+	if (profileClock != NULL) {
+		if (strcmp(profileClock, "sim") == 0)
+			profiler.setClock(simulatedClock, 1000);
+		if (!command("LOG profile on"))
+			exit(1);
+	}
+	cout << "setup and enable done after " << fixed << setprecision(2) << secondsSinceStart() << "s" << endl;
+
+	// stream the trajectory, each MOVETO reaches the reference of the next sample
+	loopStat = LoopStatistics();
+	for (int i = 0;i<MAX_STEPPERS;i++)
+		plant.getStepper(i).resetStatistics();
+	TrackingStatistics tracking;
+	uint32_t commands = 0;
+	uint32_t failedCommands = 0;
+	double trajectoryStart = secondsSinceStart();
+	double nextSample = trajectoryStart;
+	double nextTrackingSample = 0;
+	double wallTrajectoryStart = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+	while (secondsSinceStart() - trajectoryStart < duration_s) {
+		double t = secondsSinceStart() - trajectoryStart;
+		if (secondsSinceStart() >= nextSample) {
+			nextSample += sample_ms/1000.0;
+			string cmd = "MOVETO";
+			for (int i = 0;i<MAX_ACTUATORS;i++) {
+				char angleStr[16];
+				sprintf(angleStr, " %.2f", referenceAngle(i, t + sample_ms/1000.0));
+				cmd += angleStr;
+			}
+			cmd += " " + to_string(sample_ms);
+			commands++;
+			if (!command(cmd))
+				failedCommands++;
+		} else
+			runLoop();
+
+		// tracking error of the plants against the reference, sampled every ms
+		t = secondsSinceStart() - trajectoryStart;
+		while (nextTrackingSample <= t) {
+			for (int i = 0;i<MAX_ACTUATORS;i++) {
+				double error = fabs(plant.getAngle((ActuatorIdentifier)i) - referenceAngle(i, t));
+				tracking.sumSquare[i] += error*error;
+				tracking.maxError[i] = max(tracking.maxError[i], error);
+			}
+			tracking.samples++;
+			nextTrackingSample += 0.001;
+		}
+	}
+
+	double simulated_s = secondsSinceStart() - trajectoryStart;
+	double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count() - wallTrajectoryStart;
+	cout << "simulated " << setprecision(2) << simulated_s << "s in " << wall_s << "s ("
+		 << setprecision(1) << simulated_s/wall_s << "x real time), "
+		 << loopStat.loops << " loops, " << commands << " MOVETO, " << failedCommands << " failed" << endl;
+	cout << "loop period   avg=" << setprecision(1) << setw(8) << loopStat.sumPeriod_us/max(1U,loopStat.loops-1) << "us"
+		 << " max=" << setw(8) << loopStat.maxPeriod_us << "us" << endl;
+	cout << "loop host     avg=" << setprecision(2) << setw(8) << loopStat.sumWall_us/max(1U,loopStat.loops) << "us"
+		 << " max=" << setw(8) << loopStat.maxWall_us << "us" << endl;
+	cout << "stepper impulses (tick " << STEPPER_ISR_TICK_US << "us)" << endl;
+	for (int i = 0;i<MAX_STEPPERS;i++) {
+		StepperPlant& stepper = plant.getStepper(i);
+		cout << "  " << setw(10) << left << actuatorName[stepper.getId()] << right
+			 << " max rate=" << setprecision(0) << setw(6) << stepper.getMaxStepRate() << "/s"
+			 << " min pulse=" << setprecision(1) << setw(5) << stepper.getMinPulseWidth_us() << "us"
+			 << " jitter avg=" << setw(6) << stepper.getAvgJitter_us() << "us"
+			 << " max=" << setw(8) << stepper.getMaxJitter_us() << "us" << endl;
+	}
+	if (profileClock != NULL) {
+		cout << "profile of the latest " << PROFILE_REPORT_PERIOD << "ms (" << profileClock << " clock, " << logPrinter.profileLines << " lines parsed)" << endl;
+		for (int i = 0;i<NumberOfProfileSections;i++) {
+			const ProfileRecord& record = logPrinter.profile[i];
+			cout << "  " << setw(10) << left << profileSectionName[i] << right
+				 << " n=" << setw(7) << record.count
+				 << " min=" << setprecision(1) << setw(8) << record.min_us << "us"
+				 << " avg=" << setw(8) << record.avg_us << "us"
+				 << " max=" << setw(8) << record.max_us << "us hist=";
+			for (int b = 0;b<PROFILE_HISTOGRAM_BINS;b++)
+				cout << ((b > 0)?",":"") << record.histogram[b];
+			cout << endl;
+		}
+	}
+	cout << "tracking error [deg]" << endl;
+	for (int i = 0;i<MAX_ACTUATORS;i++) {
+		cout << "  " << setw(10) << left << actuatorName[i] << right
+			 << " rms=" << setprecision(3) << setw(7) << sqrt(tracking.sumSquare[i]/max(1U,tracking.samples))
+			 << " max=" << setw(7) << tracking.maxError[i] << endl;
+	}
+	if (checkProfile) {
+		if (logPrinter.reports == 0)
+			logPrinter.error("no complete report", "");
+		cout << "profile check: " << logPrinter.reports << " reports, " << logPrinter.errors << " errors" << endl;
+		if (logPrinter.errors > 0)
+			return 1;
+	}
+	return 0;
+}
@@ -10,8 +10,90 @@
 #ifndef COMM_DEF_H_
 #define COMM_DEF_H_
 
+#include <stdint.h>
+
+// Binary frames are an alternative to the text protocol for commands sent with high frequency (MOVETO).
+// They are used only after being switched on via "BINARY on". Layout of a frame:
+//   <sync byte> <length> <command id> <payload> <crc16 low byte> <crc16 high byte>
+// length counts command id and payload, the crc16 covers length, command id and payload.
+// All numbers are little endian, the reply is the same as in text protocol (>ok or >nok(error)).
+// Replies carrying binary data start with a frame of the same layout, followed by >ok.
+#define FRAME_SYNC_BYTE 0xA5						// not printable, so it cannot be part of a text command
+#define FRAME_MAX_LENGTH 64							// max length of command id and payload, a frame fits into the UART's receive buffer
+#define FRAME_ANGLE_SCALE 100						// angles are transferred as int16 in 1/100 degree
+
+// binary MOVETO: <7 x int16 angle> <uint16 duration [ms]>
+#define FRAME_MOVETO_PAYLOAD_LENGTH (7*2+2)
+
+// CHUNK appends samples to the cortex' movement queue instead of replacing the current movement like MOVETO.
+// Every sample starts when the previous one ends, so a trajectory can be streamed ahead of time.
+// The reply carries the queue state as "fill=<samples> ahead=<ms>" to let the host control the flow.
+// binary CHUNK: <uint8 number of samples> (<7 x int16 angle> <uint16 duration [ms]>)*
+// text CHUNK carries one sample only, with the same parameters as MOVETO.
+#define FRAME_CHUNK_SAMPLE_LENGTH (7*2+2)
+#define FRAME_CHUNK_MAX_SAMPLES ((FRAME_MAX_LENGTH-3)/FRAME_CHUNK_SAMPLE_LENGTH)	// leaves space for the sequence number
+#define MOVEMENT_QUEUE_SIZE 16						// number of samples the cortex queues per actuator
+
+// binary STATUS has no payload, the reply frame carries the state of all actuators:
+// 7 x (<int16 angle> <int16 min> <int16 max> <int16 null> <int16 torque> <uint8 flags>)
+// The text command STATUS returns the same as list n=<no> ang=<angle> min=<min> max=<max> null=<null> torque=<torque> flags=<flags>
+#define FRAME_STATUS_ACTUATOR_LENGTH (5*2+1)
+#define FRAME_STATUS_PAYLOAD_LENGTH (7*FRAME_STATUS_ACTUATOR_LENGTH)
+#define FRAME_STATUS_OK 0x01						// encoder or servo works properly
+#define FRAME_STATUS_ENABLED 0x02					// stepper or servo is enabled
+
+// TELEMETRY <period> lets the cortex emit a telemetry frame every period [ms] on the log port, 0 switches it off.
+// Frames are sent in between log lines, which consist of printable characters only, so the sync byte cannot be mixed up.
+// <uint32 time [ms]> 7 x (<int16 setpoint angle> <int16 measured angle> <float integral> <float steps/s> <int16 torque>)
+#define FRAME_TELEMETRY_JOINT_LENGTH (2+2+4+4+2)
+#define FRAME_TELEMETRY_PAYLOAD_LENGTH (4+7*FRAME_TELEMETRY_JOINT_LENGTH)
+#define FRAME_TELEMETRY_LENGTH (3+FRAME_TELEMETRY_PAYLOAD_LENGTH+2)
+#define TELEMETRY_MIN_PERIOD 20						// [ms], a frame takes approx. 9ms at 115200 baud
+
+// SEQ on lets the host number its commands to make them idempotent. Text commands carry seq=<n> as last parameter before chk,
+// binary frames carry <uint8 n> right after the command id (counted by length and covered by the crc). n runs from 1 to 255,
+// replies end with >ok #<n> or >nok(error) #<n>, so the host assigns late replies properly. If a reply gets lost, the host
+// sends the same command with the same number again. Commands that must not be executed twice (e.g. CHUNK) are answered
+// with the result of the first execution, all others are executed again. Commands with a wrong checksum are replied without number.
+#define SEQUENCE_HISTORY 4							// number of commands whose result the cortex remembers
+
+// CHECKSUM on appends chk=<uint8> to text commands, a hash*33+c over all characters except blanks. CHECKSUM crc
+// appends crc=<4 hex digits> instead, the crc16 of the line in front of " crc=" including blanks. It detects all
+// single and double bit errors and swapped characters, and costs a table lookup per byte. The host tries crc first
+// and falls back to on if the cortex does not know it.
+#define CHECKSUM_CRC_PARAM "crc="
+
+// LOG profile on lets the cortex measure the sections of its loop. Every PROFILE_REPORT_PERIOD it writes one line per section
+// on the log port and starts the statistics anew:
+//   prof <section> n=<count> min=<us> avg=<us> max=<us> hist=<bin 0>,...,<bin 11>
+// Bin 0 counts the durations below 1us, bin i the durations in [2^(i-1),2^i) us, the last bin everything above.
+// Sections are inclusive, e.g. controller contains stepper, servo and encoder.
+#define PROFILE_LOG_PREFIX "prof "
+#define PROFILE_HISTOGRAM_BINS 12
+#define PROFILE_REPORT_PERIOD 1000					// [ms]
+
+enum ProfileSection { PROFILE_LOOP = 0, PROFILE_HOSTCOMM = 1, PROFILE_CONTROLLER = 2, PROFILE_STEPPER = 3,
+					  PROFILE_SERVO = 4, PROFILE_ENCODER = 5, PROFILE_LIGHTS = 6, NumberOfProfileSections = 7 };
+extern const char* profileSectionName[NumberOfProfileSections];
+
+struct ProfileRecord {
+	ProfileSection section;
+	uint32_t count;
+	float min_us;
+	float avg_us;
+	float max_us;
+	uint32_t histogram[PROFILE_HISTOGRAM_BINS];
+};
+
+// returns true if the log line is a profile line, used by the webserver
+bool parseProfileLine(const char* line, ProfileRecord& record);
+
+// CRC16-CCITT (polynom 0x1021, init 0xFFFF), table driven. Used for binary frames and,
+// after CHECKSUM crc, for text commands
+uint16_t crc16(const uint8_t* data, int length);
+
 struct CommDefType {
-	static const int NumberOfCommands = 18;
+	static const int NumberOfCommands = 23;
 
 	// all possible commands the uC provides
 	enum CommandType { 	LED_CMD = 0,
@@ -31,7 +113,12 @@ struct CommDefType {
 						INFO_CMD = 14,
 						SETUP_CMD = 15,
 						PRINT_CMD = 16,
-						PRINTLN_CMD = 17
+						PRINTLN_CMD = 17,
+						BINARY_CMD = 18,
+						CHUNK_CMD = 19,
+						STATUS_CMD = 20,
+						TELEMETRY_CMD = 21,
+						SEQ_CMD = 22
 
 	};
 	CommandType cmd;
@@ -40,6 +127,9 @@ struct CommDefType {
 
 	// Pointer to the default handler function
     void (*cmdFunction)();
+
+	// true, if executing the command twice has the same effect as executing it once
+	bool idempotent;
 	static CommDefType* get(CommandType cmd);
 };
 
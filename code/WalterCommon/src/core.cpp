@@ -51,6 +51,7 @@ std::string getErrorMessage(ErrorCodeType err) {
 	case CORTEX_NO_RESPONSE: 			msg << "no response from cortex";break;
 	case CORTEX_POWER_ON_WITHOUT_SETUP: msg << "cannot power on without being setup";break;
 	case CORTEX_SETUP_MISSING: 			msg << "call setup upfront";break;
+	case CORTEX_QUEUE_FULL: 			msg << "movement queue full";break;
 
 	// configuration errors
 	case MISCONFIG_NO_STEPPERS: 		msg << "misconfiguration: no steppers";break;
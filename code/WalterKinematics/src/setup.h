@@ -9,7 +9,10 @@
 
 #include <valarray>
 
-#define LOGVIEW_MAXSIZE 10000 // number of displayed log lines in server view
+#define LOGVIEW_MAXSIZE 200 // number of displayed log lines in server view
+#define CMDVIEW_MAXSIZE 200 // number of displayed cortex commands in server view
+#define ALERTVIEW_MAXSIZE 16 // number of alerts kept for the server view
+#define TELEMETRY_MAXSIZE 1000 // number of telemetry samples kept for the server view
 
 // logging switches
 // #define KINEMATICS_LOGGING
@@ -53,12 +56,16 @@ struct ActuatorStateType {
 	float minAngle;
 	float maxAngle;
 	float nullAngle;
+	float torque;			// servo only, proportional to PWM
+	bool healthy;			// encoder or servo works properly
+	bool enabled;
 };
 
 // UI trajectories are samples with 1000/25 = 40 fps
 const milliseconds UITrajectorySampleRate = 50;
 const milliseconds BotTrajectorySampleRate = 100;
 const milliseconds CortexSampleRate  = 100;
+const milliseconds CortexQueueLeadTime = 200; // trajectory samples are streamed that much ahead into the cortex' movement queue
 
 
 
@@ -9,6 +9,7 @@
 #include "Poco/Net/HTTPClientSession.h"
 #include "Poco/Net/HTTPRequest.h"
 #include "Poco/Net/HTTPResponse.h"
+#include "Poco/Net/WebSocket.h"
 #include <Poco/Net/HTTPCredentials.h>
 #include "Poco/StreamCopier.h"
 #include "Poco/NullStream.h"
@@ -19,6 +20,7 @@
 #include <iostream>
 #include <sstream> // for ostringstream
 #include <string>
+#include <chrono>
 #include "ExecutionInvoker.h"
 #include "spatial.h"
 #include "Trajectory.h"
@@ -118,10 +120,75 @@ bool ExecutionInvoker::httpPOST(string path, string body, string &responsestr, i
 void ExecutionInvoker::setHost(string pHost, int pPort) {
 	host = pHost;
 	port = pPort;
+	if (streamThread == NULL)
+		streamThread = new std::thread(&ExecutionInvoker::streamReader, this);
+}
+
+// same stream as used by the web UI, reconnects every 2s if the webserver is not there
+void ExecutionInvoker::streamReader() {
+	while (true) {
+		try {
+			HTTPClientSession session(host, port);
+			HTTPRequest request(HTTPRequest::HTTP_GET, "/stream", HTTPMessage::HTTP_1_1);
+			HTTPResponse response;
+			WebSocket ws(session, request, response);
+			LOG(DEBUG) << "stream of webserver connected";
+
+			char buffer[4096];
+			int flags = 0;
+			int length = 0;
+			do {
+				try {
+					length = ws.receiveFrame(buffer, sizeof(buffer), flags);
+				}
+				catch (Poco::TimeoutException ex) {
+					continue; // no event for a while, the bot might stand still
+				}
+				if ((length > 0) && ((flags & WebSocket::FRAME_OP_BITMASK) == WebSocket::FRAME_OP_TEXT))
+					handleStreamEvent(string(buffer, length));
+			} while ((length > 0) && ((flags & WebSocket::FRAME_OP_BITMASK) != WebSocket::FRAME_OP_CLOSE));
+		}
+		catch (Poco::Exception& ex) {
+			LOG(DEBUG) << "stream of webserver failed " << ex.displayText();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(streamMutex);
+			streamedNode = "";
+		}
+		std::this_thread::sleep_for(std::chrono::seconds(2));
+	}
+}
+
+// events are {"type":"<type>", "data":<json>}, a trajectory node comes as json string in the format of /executor/getangles
+void ExecutionInvoker::handleStreamEvent(const string& event) {
+	if (event.find("\"type\":\"tnode\"") == string::npos)
+		return;
+	const string dataTag = "\"data\":\"";
+	size_t idx = event.find(dataTag);
+	if (idx == string::npos)
+		return;
+
+	string node;
+	for (idx += dataTag.length();(idx < event.length()) && (event[idx] != '"');idx++) {
+		char c = event[idx];
+		if ((c == '\\') && (idx+1 < event.length())) {
+			c = event[++idx];
+			if (c == 'n') c = '\n';
+			if (c == 'r') c = '\r';
+			if (c == 't') c = '\t';
+		}
+		node += c;
+	}
+
+	std::lock_guard<std::mutex> lock(streamMutex);
+	streamedNode = node;
 }
 
 ExecutionInvoker::ExecutionInvoker() {
 	Poco::Net::initializeNetwork();
+	port = 0;
+	streamThread = NULL;
 }
 
 ExecutionInvoker& ExecutionInvoker::getInstance() {
@@ -162,7 +229,13 @@ bool ExecutionInvoker::setAngles(JointAngles angles) {
 TrajectoryNode ExecutionInvoker::getAngles() {
 	TrajectoryNode node;
 	string response;
-	bool okHttp = httpGET("/executor/getangles", response,200);
+	{
+		std::lock_guard<std::mutex> lock(streamMutex);
+		response = streamedNode;
+	}
+	// the webserver pushes a changed node within STREAM_NODE_SAMPLE_RATE, the final pose of a movement
+	// included, so the latest one is the current one. Without a stream connection, ask for it
+	bool okHttp = !response.empty() || httpGET("/executor/getangles", response,200);
 	if (okHttp) {
 		int idx = 0;
 		bool ok = node.fromString(response, idx);
@@ -1,7 +1,8 @@
 /*
  * ExecutionInvoker.h
  *
- * Class to call the webserver to transfer trajectoryies.
+ * Class to call the webserver to transfer trajectoryies. The current pose of the bot is pushed
+ * by the webserver via websocket, getAngles polls via http only while the stream is not there.
  *
  * Author: JochenAlt
  */
@@ -10,6 +11,8 @@
 #define EXECUTIONINVOKER_H_
 
 #include <string.h>
+#include <thread>
+#include <mutex>
 #include "spatial.h"
 #include "Trajectory.h"
 
@@ -43,8 +46,16 @@ private:
 	bool httpGET(string path, string &responsestr, int timeout_ms);
 	bool httpPOST(string path, string body, string &responsestr, int timeout_ms);
 
+	// runs in streamThread, receives the events of the webserver's websocket
+	void streamReader();
+	void handleStreamEvent(const string& event);
+
 	std::string host;
 	int port;
+
+	std::thread* streamThread;
+	std::mutex streamMutex;
+	string streamedNode;			// latest trajectory node pushed by the webserver, empty if not connected
 };
 
 #endif /* EXECUTIONINVOKER_H_ */
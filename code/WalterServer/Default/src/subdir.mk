@@ -5,8 +5,10 @@
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
 ../src/CmdDispatcher.cpp \
+../src/CortexChannel.cpp \
 ../src/CortexController.cpp \
 ../src/SerialPort.cpp \
+../src/Telemetry.cpp \
 ../src/TrajectoryExecution.cpp \
 ../src/main.cpp 
 
@@ -15,16 +17,20 @@ C_SRCS += \
 
 OBJS += \
 ./src/CmdDispatcher.o \
+./src/CortexChannel.o \
 ./src/CortexController.o \
 ./src/SerialPort.o \
+./src/Telemetry.o \
 ./src/TrajectoryExecution.o \
 ./src/main.o \
 ./src/mongoose.o 
 
 CPP_DEPS += \
 ./src/CmdDispatcher.d \
+./src/CortexChannel.d \
 ./src/CortexController.d \
 ./src/SerialPort.d \
+./src/Telemetry.d \
 ./src/TrajectoryExecution.d \
 ./src/main.d 
 
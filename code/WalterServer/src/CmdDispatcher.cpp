@@ -4,49 +4,121 @@
 
 #include "TrajectoryExecution.h"
 #include "CmdDispatcher.h"
+#include "Telemetry.h"
 #include "Util.h"
 
 #include "setup.h"
 #include <vector>
+#include <algorithm>
 #include "logger.h"
 
 
 CommandDispatcher commandDispatcher;
 
 
-bool getURLParameter(vector<string> names, vector<string> values, string key, string &value) {
-	for (int i = 0;i<(int)names.size();i++) {
-		if (names[i].compare(key) == 0) {
-			value = values[i];
+URLParameters::URLParameters(const string& query) {
+	// split name=value pairs separated by '&' in one pass, tokens without value are ignored
+	size_t start = 0;
+	while (start < query.length()) {
+		size_t end = query.find('&', start);
+		if (end == string::npos)
+			end = query.length();
+		size_t equalsIdx = query.find('=', start);
+		if ((equalsIdx != string::npos) && (equalsIdx > start) && (equalsIdx < end))
+			params.push_back(make_pair(query.substr(start, equalsIdx-start), urlDecode(query.substr(equalsIdx+1, end-equalsIdx-1))));
+		start = end+1;
+	}
+}
+
+bool URLParameters::get(const char* name, string &value) const {
+	for (unsigned i = 0;i<params.size();i++) {
+		if (params[i].first.compare(name) == 0) {
+			value = params[i].second;
 			return true;
 		}
 	}
 	return false;
 }
 
+bool URLParameters::has(const char* name) const {
+	for (unsigned i = 0;i<params.size();i++) {
+		if (params[i].first.compare(name) == 0)
+			return true;
+	}
+	return false;
+}
+
+size_t RouteHash::operator()(const string& path) const {
+	// djb2 of the lowercase path
+	size_t hash = 5381;
+	for (unsigned i = 0;i<path.length();i++)
+		hash = hash * 33 + tolower(path[i]);
+	return hash;
+}
 
-void compileURLParameter(string uri, vector<string> &names, vector<string> &values) {
-	names.clear();
-	values.clear();
+bool RouteEqual::operator()(const string& a, const string& b) const {
+	if (a.length() != b.length())
+		return false;
+	for (unsigned i = 0;i<a.length();i++)
+		if (tolower(a[i]) != tolower(b[i]))
+			return false;
+	return true;
+}
 
-	std::istringstream iss(uri);
-	std::string token;
-	while (std::getline(iss, token, '&'))
-	{
-		// extract name and value of parameter
-		int equalsIdx = token.find("=");
-		if (equalsIdx > 0) {
-			string name = token.substr(0,equalsIdx);
-			string value = token.substr(equalsIdx+1);
-			names.insert(names.end(), name);
-			values.insert(values.end(), urlDecode(value));
-		};
+// returns OK or the last error in the format NOK(<error code>) <error message>
+static string okOrNOkResponse(bool okOrNOk) {
+	std::ostringstream s;
+	if (okOrNOk) {
+		s << "OK";
+	} else {
+		s << "NOK(" << getLastError() << ") " << getErrorMessage(getLastError());
 	}
+	return s.str();
+}
+
+// escape a string to be used as json string value
+static string jsonEscape(const string& s) {
+	string result;
+	result.reserve(s.length());
+	for (unsigned i = 0;i<s.length();i++) {
+		switch (s[i]) {
+			case '"':  result += "\\\""; break;
+			case '\\': result += "\\\\"; break;
+			case '\n': result += "\\n"; break;
+			case '\r': result += "\\r"; break;
+			case '\t': result += "\\t"; break;
+			default:   result += s[i];
+		}
+	}
+	return result;
 }
 
 CommandDispatcher::CommandDispatcher() {
-	logLineCounter = 0;
-	cmdLineCounter = 0;
+	droppedLogLines = 0;
+	streamSubscribers = 0;
+
+	// direct cortex command defined via URL parameter, e.g. /cortex/LED?blink
+	for (int i = 0;i<CommDefType::NumberOfCommands;i++)
+		registerRoute(string("/cortex/") + commDef[i].name, &CommandDispatcher::dispatchCortexCommand, commDef[i].name);
+
+	// cortex called via one command string, e.g. /direct?param=LED+blink
+	registerRoute("/direct", &CommandDispatcher::dispatchDirect);
+	registerRoute("/direct/cmd", &CommandDispatcher::dispatchDirect);
+
+	// orchestrated calls of the trajectory executor
+	registerRoute("/executor/startupbot", &CommandDispatcher::dispatchStartupBot);
+	registerRoute("/executor/teardownbot", &CommandDispatcher::dispatchTeardownBot);
+	registerRoute("/executor/nullpositionbot", &CommandDispatcher::dispatchNullPositionBot);
+	registerRoute("/executor/isupandrunning", &CommandDispatcher::dispatchIsUpAndRunning);
+	registerRoute("/executor/emergencystop", &CommandDispatcher::dispatchEmergencyStop);
+	registerRoute("/executor/setangles", &CommandDispatcher::dispatchSetAngles);
+	registerRoute("/executor/getangles", &CommandDispatcher::dispatchGetAngles);
+	registerRoute("/executor/settrajectory", &CommandDispatcher::dispatchSetTrajectory);
+	registerRoute("/executor/stoptrajectory", &CommandDispatcher::dispatchStopTrajectory);
+
+	// calls of the webpage, e.g. /web?key=cortexlog&from=12
+	registerRoute("/web", &CommandDispatcher::dispatchWeb);
+
 	addCmdLine("<no command>");
 	addLogLine("start logging");
 }
@@ -55,275 +127,246 @@ CommandDispatcher& CommandDispatcher::getInstance() {
 	return commandDispatcher;
 }
 
+void CommandDispatcher::registerRoute(const string& path, RouteHandler handler, const char* cortexCommand) {
+	Route route;
+	route.handler = handler;
+	route.cortexCommand = cortexCommand;
+	routes[path] = route;
+}
+
+bool CommandDispatcher::isAPIRequest(const string& uri, const string& query) {
+	if (routes.find(uri) == routes.end())
+		return false;
+
+	// /web is the webpage itself as well, so check the parameters
+	if (RouteEqual()(uri, "/web")) {
+		URLParameters params(query);
+		return params.has("key") || params.has("action");
+	}
+
+	return true;
+}
+
+
+bool CommandDispatcher::queueRequest(DispatchRequest& request) {
+	return requestQueue.push(std::move(request));
+}
+
+bool CommandDispatcher::fetchResponse(DispatchResponse& response) {
+	return responseQueue.pop(response);
+}
+
+bool CommandDispatcher::processQueuedRequest() {
+	DispatchRequest request;
+	if (!requestQueue.pop(request))
+		return false;
+
+	DispatchResponse response;
+	response.connection = request.connection;
+	response.requestId = request.requestId;
+	response.processed = dispatch(request.uri, request.query, request.body, response.response, response.okOrNOk);
+
+	// http thread empties the queue permanently, so this is not supposed to wait
+	while (!responseQueue.push(std::move(response)))
+		delay(1);
+
+	return true;
+}
+
 // central dispatcher of all url requests arriving at the webserver
 // returns true, if request has been dispatched within dispatch. Otherwise the caller
 // should assume that static content is to be displayed.
-bool  CommandDispatcher::dispatch(string uri, string query, string body, string &response, bool &okOrNOk) {
-
+bool  CommandDispatcher::dispatch(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
 	response = "";
-	string urlPath = getPath(uri);
+	okOrNOk = false;
 
-	vector<string> urlParamName;
-	vector<string> urlParamValue;
+	auto route = routes.find(uri);
+	if (route == routes.end())
+		return false;
 
-	compileURLParameter(query,urlParamName,urlParamValue);
+	return (this->*(route->second.handler))(uri, query, body, response, okOrNOk);
+}
 
-	// check if direct cortex command defined via URL parameter
-	// example: /cortex/LED?blink
-	if (hasPrefix(uri, "/cortex")) {
-		LOG(DEBUG) << uri << " " << query;
+bool CommandDispatcher::dispatchCortexCommand(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	LOG(DEBUG) << uri << " " << query;
 
-		string cmd = uri.substr(string("/cortex/").length());
-		for (int i = 0;i<CommDefType::NumberOfCommands;i++) {
-			string cortexCmdStr = string(commDef[i].name);
-			if (hasPrefix(cmd, cortexCmdStr)) {
-				string command = string(commDef[i].name);
-				// are there any parameters ?
-				if (query.length() > 0) {
-					std::istringstream iss(query);
-					std::string token;
-					while (std::getline(iss, token, '&'))
-					{
-						// extract name and value of parameter
-						int equalsIdx = token.find("=");
-						if (equalsIdx > 0) {
-							string name = token.substr(0,equalsIdx);
-							string value = token.substr(equalsIdx+1);
-							command += " " + name + "=" + value;
-						} else {
-							command += " " + token;
-						}
-					}
-				};
-				LOG(DEBUG) << "calling cortex with \"" << command << "\"";
-				string cmdReply;
-				TrajectoryExecution::getInstance().directAccess(command, cmdReply, okOrNOk);
-
-				if (cmdReply.length() > 0)
-					response += cmdReply + "";
-				if (okOrNOk)
-					response += "ok";
-				else
-					response += "failed";
-				return true;
-			}
-		}
+	// parameters are passed as they are, e.g. /cortex/MOVETO?10&20 becomes "MOVETO 10 20"
+	string command = routes.find(uri)->second.cortexCommand;
+	if (query.length() > 0) {
+		command += " " + query;
+		std::replace(command.begin(), command.end(), '&', ' ');
 	}
 
-	// check, if cortex is called via one command string
-	// example /direct?param=LED+blink
-	if (hasPrefix(uri, "/direct")) {
-		if (hasPrefix(query, "param=")) {
-			LOG(DEBUG) << uri << " " << query;
+	LOG(DEBUG) << "calling cortex with \"" << command << "\"";
+	string cmdReply;
+	TrajectoryExecution::getInstance().directAccess(command, cmdReply, okOrNOk);
+
+	if (cmdReply.length() > 0)
+		response += cmdReply + "";
+	if (okOrNOk)
+		response += "ok";
+	else
+		response += "failed";
+	return true;
+}
 
-			string cmd = urlDecode(query.substr(string("param=").length()));
-			LOG(DEBUG) << "calling cortex with \"" << cmd << "\"";
-			string cmdReply;
+bool CommandDispatcher::dispatchDirect(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	string cmd;
+	if (!URLParameters(query).get("param", cmd))
+		return false;
 
-			TrajectoryExecution::getInstance().directAccess(cmd, cmdReply, okOrNOk);
-			std::ostringstream s;
-			if (okOrNOk) {
-				s << "OK";
-			} else {
-				s << "NOK(" << getLastError() << ") " << getErrorMessage(getLastError());
-			}
-			response += s.str();
-			return true;
-		}
-	}
+	LOG(DEBUG) << "calling cortex with \"" << cmd << "\"";
+	string cmdReply;
+	TrajectoryExecution::getInstance().directAccess(cmd, cmdReply, okOrNOk);
+	response = okOrNOkResponse(okOrNOk);
+	return true;
+}
 
-	// check, if TransactionExecutor is called with orchestrated calls
-	if (hasPrefix(uri, "/executor/")) {
-		string executorPath = uri.substr(string("/executor/").length());
+bool CommandDispatcher::dispatchStartupBot(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	LOG(DEBUG) << uri << " " << query;
 
-		if (hasPrefix(executorPath, "startupbot")) {
-			LOG(DEBUG) << uri << " " << query;
+	okOrNOk = TrajectoryExecution::getInstance().startupBot();
+	response = okOrNOkResponse(okOrNOk);
+	return true;
+}
 
+bool CommandDispatcher::dispatchTeardownBot(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	LOG(DEBUG) << uri << " " << query;
 
-			okOrNOk =  TrajectoryExecution::getInstance().startupBot();
-			std::ostringstream s;
-			if (okOrNOk) {
-				s << "OK";
-			} else {
-				s << "NOK(" << getLastError() << ") " << getErrorMessage(getLastError());
-			}
-			response = s.str();
-		}
-		else if (hasPrefix(executorPath, "teardownbot")) {
-			LOG(DEBUG) << uri << " " << query;
+	okOrNOk = TrajectoryExecution::getInstance().teardownBot();
+	response = okOrNOkResponse(okOrNOk);
+	return true;
+}
 
+bool CommandDispatcher::dispatchNullPositionBot(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	LOG(DEBUG) << uri << " " << query;
 
-			okOrNOk = TrajectoryExecution::getInstance().teardownBot();
-			std::ostringstream s;
-			if (okOrNOk) {
-				s << "OK";
-			} else {
-				s << "NOK(" << getLastError() << ") " << getErrorMessage(getLastError());
-			}
-			response = s.str();
-			return true;
-		}
-		else if (hasPrefix(executorPath, "nullpositionbot")) {
-			LOG(DEBUG) << uri << " " << query;
+	okOrNOk = TrajectoryExecution::getInstance().moveToNullPosition();
+	response = okOrNOkResponse(okOrNOk);
+	return true;
+}
 
+bool CommandDispatcher::dispatchIsUpAndRunning(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	bool result = TrajectoryExecution::getInstance().isBotUpAndReady();
+	okOrNOk = true;
+	response = result?"true":"false";
+	return true;
+}
 
-			okOrNOk = TrajectoryExecution::getInstance().moveToNullPosition();
-			std::ostringstream s;
-			if (okOrNOk) {
-				s << "OK";
-			} else {
-				s << "NOK(" << getLastError() << ") " << getErrorMessage(getLastError());
-			}
-			response = s.str();
-			return true;
-		}
-		else if (hasPrefix(executorPath, "isupandrunning")) {
-			response = "";
-			bool result = TrajectoryExecution::getInstance().isBotUpAndReady();
-			okOrNOk = true;
-			response = result?"true":"false";
-			return true;
-		}
-		else if (hasPrefix(executorPath, "emergencystop")) {
-			LOG(DEBUG) << uri << " " << query;
+bool CommandDispatcher::dispatchEmergencyStop(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	LOG(DEBUG) << uri << " " << query;
 
+	bool result = TrajectoryExecution::getInstance().emergencyStopBot();
+	okOrNOk = true;
+	response = result?"true":"false";
+	return true;
+}
 
-			response = "";
-			bool result = TrajectoryExecution::getInstance().emergencyStopBot();
-			okOrNOk = true;
-			response = result?"true":"false";
-			return true;
-		}
-		else if (hasPrefix(executorPath, "setangles")) {
-			LOG(DEBUG) << uri << " " << query;
+bool CommandDispatcher::dispatchSetAngles(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	LOG(DEBUG) << uri << " " << query;
 
+	string param;
+	URLParameters(query).get("param", param);
+	okOrNOk = TrajectoryExecution::getInstance().setAnglesAsString(param);
+	response = okOrNOkResponse(okOrNOk);
+	return true;
+}
 
-			string param = urlDecode(query.substr(string("param=").length()));
-			okOrNOk = TrajectoryExecution::getInstance().setAnglesAsString(param);
-			std::ostringstream s;
-			if (okOrNOk) {
-				s << "OK";
-			} else {
-				s << "NOK(" << getLastError() << ") " << getErrorMessage(getLastError());
-			}
-			response = s.str();
+bool CommandDispatcher::dispatchGetAngles(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	LOG(DEBUG) << uri << " " << query;
+
+	int indent = 0;
+	response = TrajectoryExecution::getInstance().currentTrajectoryNodeToString(indent);
+	okOrNOk = !isError();
+	return true;
+}
+
+bool CommandDispatcher::dispatchSetTrajectory(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	LOG(DEBUG) << uri << " " << query;
+
+	string param = urlDecode(body);
+	LOG(DEBUG) << "body:" << param;
+
+	TrajectoryExecution::getInstance().runTrajectory(param);
+	okOrNOk = !isError();
+	response = okOrNOkResponse(okOrNOk);
+	return true;
+}
+
+bool CommandDispatcher::dispatchStopTrajectory(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	LOG(DEBUG) << uri << " " << query;
+
+	TrajectoryExecution::getInstance().stopTrajectory();
+	okOrNOk = !isError();
+	response = okOrNOkResponse(okOrNOk);
+	return true;
+}
+
+bool CommandDispatcher::dispatchWeb(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk) {
+	URLParameters params(query);
+	string keyValue;
+	string fromValue;
+	if (params.get("key", keyValue)) {
+		bool hasFrom = params.get("from", fromValue);
+		int from = hasFrom?string_to_int(fromValue):-1;
+
+		if (keyValue.compare("cortexcmd") == 0) {
+			response = getCmdLineJson((from >= 0)?from+1:0);
+			okOrNOk = true;
 			return true;
 		}
-		else if (hasPrefix(executorPath, "getangles")) {
-			LOG(DEBUG) << uri << " " << query;
-
-			int indent = 0;
-			response  = TrajectoryExecution::getInstance().currentTrajectoryNodeToString(indent);
-			okOrNOk = !isError();
+		if (keyValue.compare("cortexlog") == 0) {
+			response = getLogLineJson((from >= 0)?from+1:0);
+			okOrNOk = true;
 			return true;
 		}
-		else if (hasPrefix(executorPath, "settrajectory")) {
-			LOG(DEBUG) << uri << " " << query;
-
-			string param = urlDecode(body);
-			LOG(DEBUG) << "body:" << param;
-
-			TrajectoryExecution::getInstance().runTrajectory(param);
-			okOrNOk = !isError();
-			std::ostringstream s;
-			if (okOrNOk) {
-				s << "OK";
-			} else {
-				s << "NOK(" << getLastError() << ") " << getErrorMessage(getLastError());
-			}
-			response += s.str();
+		if (keyValue.compare("telemetry") == 0) {
+			response = Telemetry::getInstance().getSamplesJson((from >= 0)?from+1:0);
+			okOrNOk = true;
 			return true;
 		}
-		else if (hasPrefix(executorPath, "stoptrajectory")) {
-			LOG(DEBUG) << uri << " " << query;
-
-
-			TrajectoryExecution::getInstance().stopTrajectory();
-			okOrNOk = !isError();
-			std::ostringstream s;
-			if (okOrNOk) {
-				s << "OK";
-			} else {
-				s << "NOK(" << getLastError() << ") " << getErrorMessage(getLastError());
-			}
-			response = s.str();
+		if (keyValue.compare("profile") == 0) {
+			response = Telemetry::getInstance().getProfileJson();
+			okOrNOk = true;
 			return true;
 		}
-
-	}
-
-	if (hasPrefix(uri, "/web")) {
-		string keyValue;
-		if (getURLParameter(urlParamName, urlParamValue, "key", keyValue)) {
-			if (keyValue.compare(string("cortexcmd")) == 0) {
-				if (getURLParameter(urlParamName, urlParamValue, "from", keyValue)) {
-					int from = string_to_int(keyValue);
-					if (from >=0 )
-						response = getCmdLineJson(from+1);
-					else
-						response = getCmdLineJson(0);
-				} else
-					response = getCmdLineJson(0);
+		if (keyValue.compare("alert") == 0) {
+			if (!hasFrom) {
+				response = int_to_string(alertHistory.endId());
 				okOrNOk = true;
 				return true;
-			} else {
-				if (keyValue.compare(string("cortexlog")) == 0) {
-					if (getURLParameter(urlParamName, urlParamValue, "from", keyValue)) {
-						int from = string_to_int(keyValue);
-						if (from >=0)
-							response = getLogLineJson(from+1);
-						else
-							response = getLogLineJson(0);
-					} else
-						response = getLogLineJson(0);
-					okOrNOk = true;
-					return true;
-				} else {
-					if (keyValue.compare(string("alert")) == 0) {
-						if (getURLParameter(urlParamName, urlParamValue, "from", keyValue)) {
-							int from = string_to_int(keyValue);
-							if (from >=0) {
-								response = getAlertLineJson(from);
-								okOrNOk = true;
-								return true;
-							}
-						} else {
-							response = int_to_string(alertCounter);
-							okOrNOk = true;
-							return true;
-						}
-					}
-					else {
-						if (keyValue.compare(string("heartbeat")) == 0) {
-							response = getHeartbeatJson();
-							okOrNOk = true;
-							return true;
-						}
-					}
-				}
 			}
-		} else {
-			if (getURLParameter(urlParamName, urlParamValue, "action", keyValue)) {
-				if (keyValue.compare("savecmd") == 0) {
-					LOG(DEBUG) << uri << " " << query;
-
-
-					string value;
-					if (getURLParameter(urlParamName, urlParamValue, "value", value)) {
-						string cmdReply;
-						TrajectoryExecution::getInstance().directAccess(value, cmdReply, okOrNOk);
-						response = cmdReply;
-						return true;
-					}
-				}
+			if (from >= 0) {
+				response = getAlertLineJson(from);
+				okOrNOk = true;
+				return true;
 			}
+			return false;
+		}
+		if (keyValue.compare("heartbeat") == 0) {
+			response = getHeartbeatJson();
+			okOrNOk = true;
+			return true;
+		}
+		return false;
+	}
+
+	if (params.get("action", keyValue) && (keyValue.compare("savecmd") == 0)) {
+		LOG(DEBUG) << uri << " " << query;
+
+		string value;
+		if (params.get("value", value)) {
+			string cmdReply;
+			TrajectoryExecution::getInstance().directAccess(value, cmdReply, okOrNOk);
+			response = cmdReply;
+			return true;
 		}
 	}
 
-	okOrNOk = false;
 	return false;
 }
 
+
 string CommandDispatcher::getHeartbeatJson() {
 	if (millis() - lastHeartbeat < 1000)
 		return "true";
@@ -332,48 +375,107 @@ string CommandDispatcher::getHeartbeatJson() {
 
 void CommandDispatcher::updateHeartbeat() {
 	lastHeartbeat = millis();
+	if (lastHeartbeat - lastStreamedHeartbeat >= STREAM_HEARTBEAT_RATE) {
+		pushStreamEvent("heartbeat", "true");
+		lastStreamedHeartbeat = lastHeartbeat;
+	}
 }
 
-string  CommandDispatcher::getCmdLineJson(int fromId) {
-	string fromIdStr = string("{\"id\":") + int_to_string(fromId);
-	string cmdJson;
-	int idx = cortexCmdJson.find(fromIdStr);
-	if (idx>=0){
-		cmdJson = cortexCmdJson.substr(idx);
-	} else
-		cmdJson = "";
+void CommandDispatcher::addStreamSubscriber() {
+	streamSubscribers++;
+}
 
+void CommandDispatcher::removeStreamSubscriber() {
+	streamSubscribers--;
+}
+
+bool CommandDispatcher::fetchStreamEvent(string& event) {
+	return streamQueue.pop(event);
+}
+
+// a stream event is a json object with the type of event and its data, e.g. {"type":"cortexlog", "data":{"id":1, ...}}
+void CommandDispatcher::pushStreamEvent(const string& type, const string& dataJson) {
+	if (!isStreamSubscribed())
+		return;
+
+	// if the http thread cannot keep up, the event is lost, clients reload via /web?key=... anyway
+	streamQueue.push("{\"type\":\"" + type + "\", \"data\":" + dataJson + "}");
+}
+
+void CommandDispatcher::streamTrajectoryNode(const TrajectoryNode& node) {
+	if (!isStreamSubscribed())
+		return;
+
+	// only the latest node counts, the final pose of a movement must not get lost
+	pendingNode = node;
+	nodePending = true;
+	streamPendingNode();
+}
+
+void CommandDispatcher::streamPendingNode() {
+	if (!nodePending)
+		return;
+
+	uint32_t now = millis();
+	if (now - lastStreamedNode < STREAM_NODE_SAMPLE_RATE)
+		return;
+	nodePending = false;
+
+	// same format as /executor/getangles, stream it only if it changed
+	int indent = 0;
+	string nodeStr = pendingNode.toString(indent);
+	if (nodeStr.compare(lastStreamedNodeStr) != 0) {
+		pushStreamEvent("tnode", "\"" + jsonEscape(nodeStr) + "\"");
+		lastStreamedNodeStr = nodeStr;
+		lastStreamedNode = now;
+	}
+}
+
+string CommandDispatcher::cmdEntryToJson(const HistoryEntry& entry) {
+	return "{\"id\":" + int_to_string(entry.id) +
+			", \"time\":\"" + htmlEncode(entry.time) + "\"" +
+			", \"traj\":\"" + htmlEncode(entry.trajectory) + "\"" +
+			", \"line\":\"" + htmlEncode(entry.line) + "\"" +
+			"}";
+}
+
+string CommandDispatcher::logEntryToJson(const HistoryEntry& entry) {
+	return "{\"id\":" + int_to_string(entry.id) +
+			", \"time\":\"" + htmlEncode(entry.time) + "\"" +
+			", \"line\":\"" + htmlEncode(entry.line) + "\"}";
+}
+
+// render all commands starting with fromId. If fromId has been overwritten already, start with the oldest one
+string  CommandDispatcher::getCmdLineJson(int fromId) {
 	string result = "[";
-	result += cmdJson + string("]");
+	int startId = std::max(fromId, cortexCmdHistory.firstId());
+	for (int id = startId;id<cortexCmdHistory.endId();id++) {
+		if (id > startId)
+			result += ", ";
+		result += cmdEntryToJson(cortexCmdHistory.get(id));
+	}
+	result += "]";
 	return result;
 }
 
 string CommandDispatcher::getAlertLineJson(int fromId) {
-	string fromIdStr = string("{\"id\":") + int_to_string(fromId);
-	string shortAlertJson;
-	int idx = alertJson.find(fromIdStr);
-	if (idx>=0){
-		int start = alertJson.find("\"line\":", idx);
-		int end = alertJson.find("}", start);
+	if (alertHistory.has(fromId))
+		return htmlEncode(alertHistory.get(fromId).line);
 
-		shortAlertJson = alertJson.substr(start+string("\"line\":\"").length(),end-start-string("\"line\":\"").length()-1);
-	} else
-		shortAlertJson = "";
-
-	return shortAlertJson;
+	return "";
 }
 
 string CommandDispatcher::getLogLineJson(int fromId) {
-	string fromIdStr = string("{\"id\":") + int_to_string(fromId);
-	string logJson;
-	int idx = cortexLogJson.find(fromIdStr);
-	if (idx>=0){
-		logJson = cortexLogJson.substr(idx);
-	} else
-		logJson = "";
+	fetchLogLines();
 
 	string result = "[ ";
-	result += logJson + " ]";
+	int startId = std::max(fromId, cortexLogHistory.firstId());
+	for (int id = startId;id<cortexLogHistory.endId();id++) {
+		if (id > startId)
+			result += ", ";
+		result += logEntryToJson(cortexLogHistory.get(id));
+	}
+	result += " ]";
 	return result;
 }
 
@@ -383,6 +485,7 @@ void CommandDispatcher::setOneTimeTrajectoryNodeName(string name) {
 
 
 void CommandDispatcher::addCmdLine(string line) {
+	// one entry per line, empty lines are skipped
 	int CRLNRidx = 0;
 	do {
 		CRLNRidx = line.find("\n");
@@ -394,63 +497,44 @@ void CommandDispatcher::addCmdLine(string line) {
 			s = line;
 		}
 
-		if (line.compare("") != 0) {
-			int idx = cortexCmdJson.find("\"line\"");
-			if (idx >= 0)
-				cortexCmdJson += ", ";
-
-			string time = currentTimeToString();
-
-			cortexCmdJson += "{\"id\":" + int_to_string(cmdLineCounter++) +
-					", \"time\":\"" + htmlEncode(time) + "\"" +
-					", \"traj\":\"" + htmlEncode(oneTimeTrajectoryName) + "\"" +
-					", \"line\":\"" + htmlEncode(s) + "\"" +
-					"}";
+		if (s.compare("") != 0) {
+			int id = cortexCmdHistory.add(currentTimeToString(), oneTimeTrajectoryName, s);
+			pushStreamEvent("cortexcmd", cmdEntryToJson(cortexCmdHistory.get(id)));
 			oneTimeTrajectoryName = "";
 		}
 	}
 	while ((CRLNRidx >= 0));
-
 }
 
 void CommandDispatcher::addAlert(string line) {
-	int idx = alertJson.find("\"line\"");
-	if (idx >= 0)
-		alertJson += ", ";
-
-	alertJson += "{\"id\":" + int_to_string(alertCounter++) + ", \"line\":\"" + htmlEncode(line) + "\"}";
+	int id = alertHistory.add("", "", line);
+	pushStreamEvent("alert", "{\"id\":" + int_to_string(id) + ", \"line\":\"" + htmlEncode(line) + "\"}");
 }
 
-
-
 void CommandDispatcher::addLogLine(string line) {
-	string time;
-
-	if ((line.length() > 24) && (line[13] == ':') && (line[16] == ':')) {
-		time = line.substr(11,12);
-		line = line.substr(24);
-	} else
-		time = currentTimeToString();
-
-
-	int idx = cortexLogJson.find("\"line\"");
-
-	if (idx >= 0)
-		cortexLogJson += ", ";
-	cortexLogJson += "{\"id\":" + int_to_string(logLineCounter++) +
-			", \"time\":\"" + htmlEncode(time) + "\"" +
-			", \"line\":\"" + htmlEncode(line) + "\"}";
+	// in case the execution thread is too slow, drop the line instead of blocking the log thread
+	if (!logQueue.push(std::move(line)))
+		droppedLogLines++;
+}
 
+void CommandDispatcher::fetchLogLines() {
+	string line;
+	while (logQueue.pop(line)) {
+		string time;
+		if ((line.length() > 24) && (line[13] == ':') && (line[16] == ':')) {
+			time = line.substr(11,12);
+			line = line.substr(24);
+		} else
+			time = currentTimeToString();
+
+		// oldest lines are overwritten once the history is full
+		int id = cortexLogHistory.add(time, "", line);
+		pushStreamEvent("cortexlog", logEntryToJson(cortexLogHistory.get(id)));
+	}
 
-	// remove staff from beginning if log gets loo long to be displayed
-	while (cortexLogJson.length() > LOGVIEW_MAXSIZE) {
-		int idx = cortexLogJson.find("{\"id\"");
-		if (idx >= 0) {
-			idx = cortexLogJson.find("{\"id\"", idx+1);
-			if (idx>= 0) {
-				cortexLogJson = cortexLogJson.substr(idx);
-			}
-		}
+	int dropped = droppedLogLines.exchange(0);
+	if (dropped > 0) {
+		int id = cortexLogHistory.add(currentTimeToString(), "", int_to_string(dropped) + " log lines dropped");
+		pushStreamEvent("cortexlog", logEntryToJson(cortexLogHistory.get(id)));
 	}
 }
-
@@ -11,15 +11,98 @@
 #define WEBSERVERAPI_H_
 
 #include "TrajectoryExecution.h"
+#include "LockFreeQueue.h"
+#include "HistoryBuffer.h"
+#include "setup.h"
 #include <vector>
+#include <atomic>
+#include <unordered_map>
+
+#define STREAM_NODE_SAMPLE_RATE 50		// [ms] trajectory nodes are streamed to websocket clients not more often than this
+#define STREAM_HEARTBEAT_RATE 500		// [ms] heartbeats are streamed not more often than this
+
+// http request handed over from the http thread to the trajectory execution thread
+struct DispatchRequest {
+	void* connection;			// mongoose connection the reply is sent to, not touched by execution thread
+	uint32_t requestId;			// identifies the request, in case the connection has been reused meanwhile
+	string uri;
+	string query;
+	string body;
+};
+
+// reply of a dispatched request, handed back from the trajectory execution thread to the http thread
+struct DispatchResponse {
+	void* connection;
+	uint32_t requestId;
+	bool processed;				// false if the request turned out to be static content
+	bool okOrNOk;
+	string response;
+};
+
+// parameters of an url query, parsed in one pass. Values are url-decoded.
+// Requests have a handful of parameters only, so a flat list is faster than a map
+class URLParameters {
+public:
+	URLParameters(const string& query);
+	bool get(const char* name, string &value) const;
+	bool has(const char* name) const;
+private:
+	vector<pair<string,string> > params;
+};
+
+// case insensitive hash and comparison of url paths, used for route lookup without copying the path
+struct RouteHash {
+	size_t operator()(const string& path) const;
+};
+struct RouteEqual {
+	bool operator()(const string& a, const string& b) const;
+};
+
+class CommandDispatcher;
+typedef bool (CommandDispatcher::*RouteHandler)(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+
+// registered url path, the cortex command is set for /cortex/<command> routes only
+struct Route {
+	RouteHandler handler;
+	const char* cortexCommand;
+};
 
 class CommandDispatcher {
 public:
 	CommandDispatcher();
 
-	bool dispatch(string uri, string query, string body, string &response, bool &okOrNOk);
+	bool dispatch(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
 	static CommandDispatcher& getInstance();
 
+	// true, if the request is an API call to be dispatched, false if static content is requested.
+	// Thread-safe, since routes are not changed after construction
+	bool isAPIRequest(const string& uri, const string& query);
+
+	// called by http thread only. Hands over a request to the trajectory execution thread
+	bool queueRequest(DispatchRequest& request);
+
+	// called by http thread only. Returns the next response computed by the trajectory execution thread
+	bool fetchResponse(DispatchResponse& response);
+
+	// called by trajectory execution thread only. Dispatches one queued request, returns false if nothing to do
+	bool processQueuedRequest();
+
+	// called by http thread only. Websocket clients subscribe to the stream of log lines, commands, alerts,
+	// heartbeats and trajectory nodes. Without subscribers, no stream events are generated
+	void addStreamSubscriber();
+	void removeStreamSubscriber();
+	bool isStreamSubscribed() { return streamSubscribers > 0; };
+
+	// called by http thread only. Returns the next stream event to be sent to all websocket clients
+	bool fetchStreamEvent(string& event);
+
+	// called by trajectory execution thread only. Streams the passed trajectory node, limited to STREAM_NODE_SAMPLE_RATE.
+	// A node coming in earlier is kept and streamed by streamPendingNode when the rate allows
+	void streamTrajectoryNode(const TrajectoryNode& node);
+
+	// called by trajectory execution thread in each loop, streams the latest node that has been held back
+	void streamPendingNode();
+
 	string getCmdLineJson(int fromIdx);
 	string getLogLineJson(int fromIdx);
 	string getAlertLineJson(int fromIdx);
@@ -27,22 +110,57 @@ public:
 	void updateHeartbeat();
 
 	void addCmdLine(string line);
-	void addLogLine(string line);
 	void addAlert(string line);
 
-	string getIncrLogLineJSon(string line);
+	// thread-safe, never blocks. Line is queued and taken over into the history by fetchLogLines
+	void addLogLine(string line);
+
+	// called by trajectory execution thread only. Moves queued log lines into the log history
+	void fetchLogLines();
+
 	void setOneTimeTrajectoryNodeName(string name);
 private:
+	void registerRoute(const string& path, RouteHandler handler, const char* cortexCommand = NULL);
+
+	bool dispatchCortexCommand(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchDirect(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchStartupBot(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchTeardownBot(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchNullPositionBot(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchIsUpAndRunning(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchEmergencyStop(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchSetAngles(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchGetAngles(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchSetTrajectory(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchStopTrajectory(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+	bool dispatchWeb(const string& uri, const string& query, const string& body, string &response, bool &okOrNOk);
+
+	std::unordered_map<string, Route, RouteHash, RouteEqual> routes;
 
-	string cortexCmdJson;
-	string cortexLogJson;
-	string alertJson;
+	string cmdEntryToJson(const HistoryEntry& entry);
+	string logEntryToJson(const HistoryEntry& entry);
+	void pushStreamEvent(const string& type, const string& dataJson);
+
+
+	HistoryBuffer<CMDVIEW_MAXSIZE> cortexCmdHistory;
+	HistoryBuffer<LOGVIEW_MAXSIZE> cortexLogHistory;
+	LockFreeMPSCQueue<string, 256> logQueue;				// any thread -> execution thread
+	std::atomic<int> droppedLogLines;						// lines lost due to a full log queue
+	HistoryBuffer<ALERTVIEW_MAXSIZE> alertHistory;
 	string oneTimeTrajectoryName;
-	int logLineCounter;
-	int cmdLineCounter;
-	int alertCounter;
 
 	uint32_t lastHeartbeat = 0;
+	uint32_t lastStreamedHeartbeat = 0;
+	uint32_t lastStreamedNode = 0;
+	string lastStreamedNodeStr;
+	TrajectoryNode pendingNode;								// latest node not yet streamed
+	bool nodePending = false;
+
+	std::atomic<int> streamSubscribers;						// number of connected websocket clients
+	LockFreeQueue<string, 256> streamQueue;					// execution thread -> http thread
+
+	LockFreeQueue<DispatchRequest, 32> requestQueue;	// http thread -> execution thread
+	LockFreeQueue<DispatchResponse, 32> responseQueue;	// execution thread -> http thread
 };
 
 
@@ -0,0 +1,340 @@
+/*
+ * CortexChannel.cpp
+ *
+ * Author: JochenAlt
+ */
+
+#include <chrono>
+
+#include "CortexChannel.h"
+#include "CommDef.h"
+#include "Util.h"
+#include "logger.h"
+
+const string reponseOKStr =">ok";	 	// reponse code from uC: >ok or >nok(errornumber), optionally followed by #seqNo
+const string reponseNOKStr =">nok(";
+const string reponseEndStr ="\r\n>";
+const string reponseSeqNoStr =" #";
+
+CortexChannel::CortexChannel(SerialPort& port) : serial(port) {
+	readerThread = NULL;
+	readerRunning = false;
+	resyncRequested = false;
+	seqNoCounter = 0;
+	dropRepliesUntil = 0;
+	withChecksum = false;
+	withCRC = false;
+	withSequenceNumbers = false;
+}
+
+CortexChannel::~CortexChannel() {
+	stop();
+}
+
+void CortexChannel::start() {
+	if (readerThread == NULL) {
+		resyncRequested = true; // drop everything received before
+		readerRunning = true;
+		readerThread = new std::thread(&CortexChannel::reader, this);
+	}
+}
+
+void CortexChannel::stop() {
+	if (readerThread != NULL) {
+		readerRunning = false;
+		readerThread->join();
+		delete readerThread;
+		readerThread = NULL;
+	}
+	failPending();
+}
+
+void CortexChannel::computeChecksum(const string& s, uint8_t& hash) {
+	for (unsigned i = 0;i<s.length();i++) {
+		int c = s[i];
+		if (c != ' ')
+			hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+	}
+}
+
+uint32_t CortexChannel::addPending(const string& message, bool isFrame, int timeout_ms, CortexCompletion completion, int retries) {
+	// wait until the cortex caught up
+	while ((int)pending.size() >= CORTEX_COMMAND_WINDOW) {
+		processReplies();
+		if ((int)pending.size() >= CORTEX_COMMAND_WINDOW)
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+
+	PendingCommand cmd;
+	cmd.seqNo = ++seqNoCounter;
+	cmd.isFrame = isFrame;
+	cmd.timeout_ms = timeout_ms;
+	cmd.retries = retries;
+	cmd.completion = completion;
+
+	if (isFrame) {
+		// <sync> <length> <cmd> [<seqNo>] <payload> <crc16>
+		cmd.message = message;
+		if (withSequenceNumbers) {
+			cmd.message.insert(3, 1, (char)cortexSeqNo(cmd.seqNo));
+			cmd.message[1]++;
+			uint16_t crc = crc16((const uint8_t*)&cmd.message[1], cmd.message.length()-3);
+			cmd.message[cmd.message.length()-2] = crc & 0xFF;
+			cmd.message[cmd.message.length()-1] = (crc >> 8) & 0xFF;
+		}
+	} else {
+		// <cmd> <params> [seq=<seqNo>] [chk=<checksum>|crc=<crc16>]
+		cmd.message = message;
+		if (withSequenceNumbers)
+			cmd.message += " seq=" + std::to_string(cortexSeqNo(cmd.seqNo));
+		if (withCRC) {
+			char crcStr[5];
+			sprintf(crcStr, "%04X", crc16((const uint8_t*)cmd.message.data(), cmd.message.length()));
+			cmd.message += " " CHECKSUM_CRC_PARAM + string(crcStr);
+		} else if (withChecksum) {
+			uint8_t checksum = 0;
+			computeChecksum(cmd.message, checksum);
+			cmd.message += " chk=" + std::to_string(checksum);
+		}
+	}
+
+	pending.push_back(cmd);
+	transmit(pending.back());
+	return cmd.seqNo;
+}
+
+void CortexChannel::transmit(PendingCommand& cmd) {
+	cmd.sent = true;
+	cmd.sendTime = millis();
+	if (cmd.isFrame)
+		serial.sendArray((char*)cmd.message.data(), cmd.message.length());
+	else
+		serial.sendString(cmd.message);
+}
+
+uint32_t CortexChannel::send(const string& cmd, int timeout_ms, CortexCompletion completion, int retries) {
+	return addPending(cmd, false, timeout_ms, completion, retries);
+}
+
+uint32_t CortexChannel::sendFrame(uint8_t frame[], int frameLength, int timeout_ms, CortexCompletion completion, int retries) {
+	return addPending(string((char*)frame, frameLength), true, timeout_ms, completion, retries);
+}
+
+void CortexChannel::waitFor(bool& done) {
+	while (!done) {
+		processReplies();
+		if (!done)
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+}
+
+CortexReply CortexChannel::call(const string& cmd, int timeout_ms, int retries) {
+	CortexReply result;
+	bool done = false;
+	send(cmd, timeout_ms, [&result, &done](const CortexReply& reply) { result = reply; done = true; }, retries);
+	waitFor(done);
+	return result;
+}
+
+CortexReply CortexChannel::callFrame(uint8_t frame[], int frameLength, int timeout_ms, int retries) {
+	CortexReply result;
+	bool done = false;
+	sendFrame(frame, frameLength, timeout_ms, [&result, &done](const CortexReply& reply) { result = reply; done = true; }, retries);
+	waitFor(done);
+	return result;
+}
+
+// send a command again whose reply got lost or that has been garbled, or call its completion if there are no retries left.
+// With sequence numbers, the repetition has the same number and is not executed twice by the cortex.
+void CortexChannel::repeatOrFail(PendingCommand& cmd, const CortexReply& reply) {
+	if (cmd.retries > 0) {
+		LOG(WARNING) << "command " << cmd.seqNo << " failed (" << reply.error << "), sending again";
+		cmd.retries--;
+		pending.push_back(cmd);
+		if (withSequenceNumbers)
+			transmit(pending.back());
+		else {
+			// replies to the previous attempt might come in still, send again once they are dropped
+			pending.back().sent = false;
+			pending.back().sendTime = dropRepliesUntil;
+		}
+		return;
+	}
+
+	CortexReply result = reply;
+	result.seqNo = cmd.seqNo;
+	if (cmd.completion)
+		cmd.completion(result);
+}
+
+void CortexChannel::processReplies() {
+	CortexReply reply;
+	while (replies.pop(reply)) {
+		if (!withSequenceNumbers && ((uint32_t)millis() < dropRepliesUntil)) {
+			LOG(WARNING) << "unexpected reply \"" << replaceWhiteSpace(reply.payload) << "\" dropped";
+			continue;
+		}
+
+		// replies with a sequence number belong to the command with the same number,
+		// all others to the oldest command
+		int idx = -1;
+		for (unsigned i = 0;i<pending.size();i++) {
+			if (pending[i].sent && ((reply.replySeqNo == 0) || (reply.replySeqNo == cortexSeqNo(pending[i].seqNo)))) {
+				idx = i;
+				break;
+			}
+		}
+		if (idx < 0) {
+			if (reply.replySeqNo != 0)
+				LOG(DEBUG) << "late reply to #" << (int)reply.replySeqNo << " dropped";
+			else
+				LOG(WARNING) << "unexpected reply \"" << replaceWhiteSpace(reply.payload) << "\" dropped";
+			continue;
+		}
+
+		// cortex processes commands in the order of sending, so all older commands will not be replied anymore
+		std::deque<PendingCommand> lost(pending.begin(), pending.begin() + idx);
+		PendingCommand cmd = pending[idx];
+		pending.erase(pending.begin(), pending.begin() + idx + 1);
+		for (unsigned i = 0;i<lost.size();i++) {
+			CortexReply lostReply;
+			lostReply.okOrNOk = false;
+			lostReply.error = CORTEX_NO_RESPONSE;
+			repeatOrFail(lost[i], lostReply);
+		}
+
+		// garbled commands have not been executed, so they can be sent again
+		if (!reply.okOrNOk && ((reply.error == CHECKSUM_WRONG) || (withChecksum && (reply.error == CHECKSUM_EXPECTED)))) {
+			repeatOrFail(cmd, reply);
+			continue;
+		}
+
+		reply.seqNo = cmd.seqNo;
+		if (cmd.completion)
+			cmd.completion(reply);
+	}
+
+	// without sequence numbers, commands are sent again only after late replies have been dropped
+	for (unsigned i = 0;i<pending.size();i++) {
+		if (!pending[i].sent && ((uint32_t)millis() >= pending[i].sendTime))
+			transmit(pending[i]);
+	}
+
+	for (unsigned i = 0;i<pending.size();i++) {
+		if (pending[i].sent && (millis() - pending[i].sendTime > (uint32_t)pending[i].timeout_ms)) {
+			LOG(WARNING) << "no response to command " << pending[i].seqNo;
+			CortexReply timeoutReply;
+			timeoutReply.okOrNOk = false;
+			timeoutReply.error = CORTEX_NO_RESPONSE;
+			PendingCommand cmd = pending[i];
+			pending.erase(pending.begin() + i);
+			if (!withSequenceNumbers) {
+				// assignment of replies to commands is lost. Give up all other pending commands
+				// and drop everything that comes in during CORTEX_RESYNC_TIME
+				resyncRequested = true;
+				dropRepliesUntil = millis() + CORTEX_RESYNC_TIME;
+				failPending();
+			}
+			// with sequence numbers, a late reply is recognized by its number, so only this command is affected
+			repeatOrFail(cmd, timeoutReply);
+			break;
+		}
+	}
+}
+
+void CortexChannel::failPending() {
+	std::deque<PendingCommand> failed;
+	failed.swap(pending);
+	for (unsigned i = 0;i<failed.size();i++) {
+		CortexReply reply;
+		reply.seqNo = failed[i].seqNo;
+		reply.okOrNOk = false;
+		reply.error = CORTEX_NO_RESPONSE;
+		if (failed[i].completion)
+			failed[i].completion(reply);
+	}
+}
+
+// reponse code of uC is >ok or >nok(error), with sequence numbers followed by #seqNo.
+// Take the first complete reply out of buffer. A reply might start with a binary frame,
+// whose bytes are not searched for the response code. Text is printable, so whatever
+// comes before a sync byte without a complete reply is left over from a garbled reply
+// and dropped, as well as lines without a reply once the buffer exceeds CORTEX_MAX_REPLY_LENGTH
+bool CortexChannel::parseReply(string& buffer, CortexReply& reply) {
+	size_t frameLength = 0;
+	size_t syncIdx = string::npos;		// a text reply has to end before the next frame
+	if (!buffer.empty() && ((uint8_t)buffer[0] == FRAME_SYNC_BYTE)) {
+		// <sync> <length> <length bytes> <crc16>
+		if (buffer.length() < 2)
+			return false;
+		frameLength = (uint8_t)buffer[1] + 4;
+		if (buffer.length() < frameLength)
+			return false;
+	} else
+		syncIdx = buffer.find((char)FRAME_SYNC_BYTE);
+
+	// the reply ends with the first line starting with >ok or >nok(
+	size_t endIdx = frameLength;
+	while (((endIdx = buffer.find(reponseEndStr, endIdx)) != string::npos) &&
+		   ((syncIdx == string::npos) || (endIdx + reponseEndStr.length() <= syncIdx))) {
+		size_t statusIdx = buffer.rfind('>', endIdx);
+		if ((statusIdx != string::npos) && (statusIdx >= frameLength)) {
+			string status = buffer.substr(statusIdx, endIdx-statusIdx);
+			bool isOk = hasPrefix(status, reponseOKStr);
+			bool isNOk = hasPrefix(status, reponseNOKStr);
+			if (isOk || isNOk) {
+				reply.okOrNOk = isOk;
+				reply.error = isOk?ABSOLUTELY_NO_ERROR:(ErrorCodeType)atoi(status.c_str()+reponseNOKStr.length());
+				size_t seqNoIdx = status.find(reponseSeqNoStr);
+				reply.replySeqNo = (seqNoIdx != string::npos)?atoi(status.c_str()+seqNoIdx+reponseSeqNoStr.length()):0;
+				reply.frame = buffer.substr(0, frameLength);
+				reply.payload = buffer.substr(frameLength, statusIdx-frameLength);
+				buffer.erase(0, endIdx + reponseEndStr.length());
+				return true;
+			}
+		}
+		endIdx++;
+	}
+
+	// no reply before the next frame, resync to it
+	if (syncIdx != string::npos) {
+		LOG(WARNING) << "cortex reply garbled, dropping " << syncIdx << " bytes";
+		buffer.erase(0, syncIdx);
+		return parseReply(buffer, reply);
+	}
+
+	// garbage without any reply, keep the line that is coming in only
+	if (buffer.length() > CORTEX_MAX_REPLY_LENGTH) {
+		size_t lineStart = buffer.rfind('\n');
+		size_t dropped = (lineStart != string::npos)?lineStart+1:buffer.length();
+		LOG(WARNING) << "cortex reply too long, dropping " << dropped << " bytes";
+		buffer.erase(0, dropped);
+	}
+	return false;
+}
+
+// reader thread, splits everything coming from the cortex into replies
+void CortexChannel::reader() {
+	string buffer;
+	string str;
+	CortexReply reply;
+
+	while (readerRunning) {
+		if (resyncRequested) {
+			buffer = "";
+			serial.clear();
+			resyncRequested = false;
+		}
+
+		// sleep until something comes in, wake up regularly to check if the thread is stopped
+		int bytesRead = serial.receive(str, CORTEX_READER_WAKEUP_TIME);
+		if (bytesRead > 0) {
+			buffer += str;
+			while (parseReply(buffer, reply)) {
+				// execution thread empties the queue permanently, so this is not supposed to wait
+				while (!replies.push(std::move(reply)) && readerRunning)
+					delay(1);
+			}
+		}
+	}
+}
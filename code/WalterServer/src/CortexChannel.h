@@ -0,0 +1,117 @@
+/*
+ * CortexChannel.h
+ *
+ * Pipelined command channel to the cortex. Commands are sent without waiting for the reply
+ * of the previous one, as long as not more than CORTEX_COMMAND_WINDOW commands are pending.
+ * A reader thread splits the incoming bytes into replies. Since the cortex processes commands
+ * strictly one after the other, replies are assigned to pending commands in the order of sending.
+ * Completions are called within processReplies, i.e. in the trajectory execution thread.
+ * With sequence numbers, replies carry the number of their command, so a lost reply affects its command
+ * only. The command is sent again with the same number, and the cortex does not execute it twice.
+ * Without, a timeout makes the assignment unreliable and all pending commands fail.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef CORTEXCHANNEL_H_
+#define CORTEXCHANNEL_H_
+
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <string>
+
+#include "core.h"
+#include "SerialPort.h"
+#include "LockFreeQueue.h"
+
+using namespace std;
+
+#define CORTEX_COMMAND_WINDOW 2			// max number of commands sent without reply, limited by cortex' serial input buffer
+#define CORTEX_RESYNC_TIME 10			// [ms] without sequence numbers, replies arriving within this time after a timeout are dropped
+#define CORTEX_RETRIES 3				// number of times a command waited for is sent again if the reply got lost or garbled
+#define CORTEX_READER_WAKEUP_TIME 10	// [ms] max time the reader thread waits for data before checking if it has to stop
+#define CORTEX_MAX_REPLY_LENGTH 4096	// [bytes] without a reply within that many bytes, what came in is garbage
+
+struct CortexReply {
+	uint32_t seqNo;						// sequence number of the command the reply belongs to
+	uint8_t replySeqNo;					// sequence number as replied by the cortex (1..255), 0 if none
+	bool okOrNOk;						// true, if cortex replied with >ok
+	ErrorCodeType error;				// error code of >nok(error), CORTEX_NO_RESPONSE in case of a timeout
+	string payload;						// reply without >ok or >nok(error)
+	string frame;						// binary frame preceding the reply, empty if there is none
+};
+
+typedef std::function<void (const CortexReply& reply)> CortexCompletion;
+
+class CortexChannel {
+public:
+	CortexChannel(SerialPort& port);
+	~CortexChannel();
+
+	// start and stop the reader thread. Serial port needs to be connected in between
+	void start();
+	void stop();
+
+	// add checksum and sequence number to all commands sent from now on. Needs to be switched on at the cortex as well.
+	// With crc, text commands carry the crc16 of the line instead of the hash of its characters
+	void useChecksum(bool onOff, bool crc = false) { withChecksum = onOff; withCRC = onOff && crc; };
+	void useSequenceNumbers(bool onOff) { withSequenceNumbers = onOff; };
+	bool isChecksum() { return withChecksum; };
+	bool isCRC() { return withCRC; };
+	bool isSequenceNumbers() { return withSequenceNumbers; };
+
+	// send a command and return without waiting for the reply. Blocks only if too many commands are pending.
+	// completion is called once the reply came in or the command timed out. Returns the sequence number of the command.
+	// If the reply gets lost or the command is garbled, it is sent again up to retries times. Commands sent without
+	// waiting are not repeated by default, since the repetition would be executed after the commands sent meanwhile.
+	uint32_t send(const string& cmd, int timeout_ms, CortexCompletion completion, int retries = 0);
+	uint32_t sendFrame(uint8_t frame[], int frameLength, int timeout_ms, CortexCompletion completion, int retries = 0);
+
+	// send a command and wait for its reply
+	CortexReply call(const string& cmd, int timeout_ms, int retries = CORTEX_RETRIES);
+	CortexReply callFrame(uint8_t frame[], int frameLength, int timeout_ms, int retries = CORTEX_RETRIES);
+
+	// call completions of all replies received meanwhile and of all timed out commands
+	void processReplies();
+
+	// number of commands waiting for a reply
+	int pendingCommands() { return pending.size(); };
+
+private:
+	struct PendingCommand {
+		uint32_t seqNo;
+		string message;					// command as sent, to send it again
+		bool isFrame;
+		bool sent;						// false, if it waits for being sent again
+		uint32_t sendTime;
+		int timeout_ms;
+		int retries;
+		CortexCompletion completion;
+	};
+
+	uint32_t addPending(const string& message, bool isFrame, int timeout_ms, CortexCompletion completion, int retries);
+	void transmit(PendingCommand& cmd);
+	void repeatOrFail(PendingCommand& cmd, const CortexReply& reply);
+	void waitFor(bool& done);
+	void failPending();
+	void reader();
+	bool parseReply(string& buffer, CortexReply& reply);
+	static uint8_t cortexSeqNo(uint32_t seqNo) { return ((seqNo-1) % 255) + 1; };	// number sent to the cortex, 0 is not used
+	static void computeChecksum(const string& s, uint8_t& hash);
+
+	SerialPort& serial;
+	std::deque<PendingCommand> pending;				// commands sent, in order of sending. Execution thread only
+	LockFreeQueue<CortexReply, 16> replies;			// reader thread -> execution thread
+	std::thread* readerThread;
+	std::atomic<bool> readerRunning;
+	std::atomic<bool> resyncRequested;				// reader thread drops what has been received so far
+	uint32_t seqNoCounter;
+	uint32_t dropRepliesUntil;						// without sequence numbers, late replies are dropped until this time
+	bool withChecksum;
+	bool withCRC;
+	bool withSequenceNumbers;
+};
+
+#endif /* CORTEXCHANNEL_H_ */
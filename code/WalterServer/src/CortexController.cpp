@@ -22,6 +22,7 @@
 
 #include "CortexController.h"
 #include "CmdDispatcher.h"
+#include "Telemetry.h"
 
 #include "SerialPort.h"
 #include "logger.h"
@@ -29,8 +30,6 @@
 
 using namespace std;
 
-const string reponseOKStr =">ok\r\n>";	 // reponse code from uC: >ok or >nok(errornumber)
-const string reponseNOKStr =">nok(";
 
 // the following functions are dummys, real functions are used in the uC. Purpose is to have
 // one communication interface header between uC and host containing all commands. uC uses a
@@ -55,6 +54,11 @@ void cmdHELP();
 void cmdINFO(){};
 void cmdPRINT(){};
 void cmdPRINTLN(){};
+void cmdBINARY(){};
+void cmdCHUNK(){};
+void cmdSTATUS(){};
+void cmdTELEMETRY(){};
+void cmdSEQ(){};
 
 
 bool CortexController::microControllerPresent(string cmd) {
@@ -87,15 +91,13 @@ bool CortexController::cmdLED(LEDState state) {
 
 bool CortexController::cmdECHO(string s) {
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::ECHO_CMD);
-		cmd.append(comm->name);
-		cmd.append(" ");
-		cmd.append(s);
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::ECHO_CMD);
+	cmd.append(comm->name);
+	cmd.append(" ");
+	cmd.append(s);
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 
 	return ok;
 }
@@ -105,14 +107,12 @@ bool CortexController::cmdMEMReset() {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::MEM_CMD);
-		cmd.append(comm->name);
-		cmd.append(" reset");
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::MEM_CMD);
+	cmd.append(comm->name);
+	cmd.append(" reset");
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 
 	return ok;
 }
@@ -122,14 +122,12 @@ bool CortexController::cmdMEMList(string& mem) {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::MEM_CMD);
-		cmd.append(comm->name);
-		cmd.append(" list");
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::MEM_CMD);
+	cmd.append(comm->name);
+	cmd.append(" list");
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 	return ok;
 }
 
@@ -138,42 +136,75 @@ bool CortexController::cmdPOWER(bool onOff) {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::POWER_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::POWER_CMD);
 
-		cmd.append(comm->name);
-		if (onOff)
-			cmd.append(" on");
-		else
-			cmd.append(" off");
+	cmd.append(comm->name);
+	if (onOff)
+		cmd.append(" on");
+	else
+		cmd.append(" off");
 
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-		if (ok)
-			powered = onOff;
-	} while (retry(ok));
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
+	if (ok)
+		powered = onOff;
 
 	return ok;
 }
 
-bool CortexController::cmdCHECKSUM(bool onOff) {
+bool CortexController::cmdCHECKSUM(bool onOff, bool crc) {
 	string cmd = "";
 	CommDefType* comm = CommDefType::get(CommDefType::CommandType::CHECKSUM_CMD);
 
 	bool ok = false;
-	do {
-		cmd.append(comm->name);
-		if (onOff)
-			cmd.append(" on");
-		else
-			cmd.append(" off");
+	cmd.append(comm->name);
+	if (onOff)
+		cmd.append(crc?" crc":" on");
+	else
+		cmd.append(" off");
 
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-		if (ok)
-			withChecksum = onOff;
-	} while (retry(ok));
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
+	if (ok)
+		channel.useChecksum(onOff, crc);
+
+	return ok;
+}
+
+bool CortexController::cmdBINARY(bool onOff) {
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::BINARY_CMD);
+
+	bool ok = false;
+	cmd = comm->name;
+	if (onOff)
+		cmd.append(" on");
+	else
+		cmd.append(" off");
+
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
+	if (ok)
+		withBinaryFrames = onOff;
+
+	return ok;
+}
+
+bool CortexController::cmdSEQ(bool onOff) {
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::SEQ_CMD);
+
+	cmd = comm->name;
+	if (onOff)
+		cmd.append(" on");
+	else
+		cmd.append(" off");
+
+	string responseStr;
+	bool ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
+	if (ok)
+		channel.useSequenceNumbers(onOff);
 
 	return ok;
 }
@@ -183,15 +214,13 @@ bool CortexController::cmdSETUP() {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::SETUP_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::SETUP_CMD);
 
-		cmd.append(comm->name);
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-		setup = ok;
-	} while (retry(ok));
+	cmd.append(comm->name);
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
+	setup = ok;
 
 	return ok;
 }
@@ -202,15 +231,13 @@ bool CortexController::cmdDISABLE() {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::DISABLE_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::DISABLE_CMD);
 
-		cmd.append(comm->name);
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-		enabled = false;
-	} while (retry(ok));
+	cmd.append(comm->name);
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
+	enabled = false;
 
 	return ok;
 }
@@ -220,49 +247,165 @@ bool CortexController::cmdENABLE() {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::ENABLE_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::ENABLE_CMD);
 
-		cmd.append(comm->name);
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-		enabled = ok;
-	} while (retry(ok));
+	cmd.append(comm->name);
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
+	enabled = ok;
 
 	return ok;
 }
 
 
+// compose MOVETO as text command and as binary frame. Returns true, if the binary frame is to be used
+bool CortexController::composeMOVETO(JointAngles angle_rad, int duration_ms, string& cmd, uint8_t frame[], int& frameLength) {
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::MOVETO_CMD);
+
+	cmd = comm->name;
+	bool fitsIntoFrame = true;
+	for (int i = 0;i<7;i++) {
+		cmd.append(" ");
+		rational angle_deg = degrees(angle_rad[i]);
+		string angleStr = string_format("%.2f",angle_deg);
+		cmd.append(angleStr);
+		fitsIntoFrame = fitsIntoFrame && (fabs(angle_deg)*FRAME_ANGLE_SCALE < 32767);
+	}
+	cmd.append(" ");
+	cmd.append(std::to_string(duration_ms));
+
+	if (!withBinaryFrames || !fitsIntoFrame)
+		return false;
+
+	// <sync> <length> <cmd> <7 x int16 angle> <uint16 duration> <crc16>
+	int len = 0;
+	frame[len++] = FRAME_SYNC_BYTE;
+	frame[len++] = 1+FRAME_MOVETO_PAYLOAD_LENGTH;
+	frame[len++] = CommDefType::MOVETO_CMD;
+	for (int i = 0;i<7;i++) {
+		int16_t angle = (int16_t)roundl(degrees(angle_rad[i])*FRAME_ANGLE_SCALE);
+		frame[len++] = angle & 0xFF;
+		frame[len++] = (angle >> 8) & 0xFF;
+	}
+	frame[len++] = duration_ms & 0xFF;
+	frame[len++] = (duration_ms >> 8) & 0xFF;
+	uint16_t crc = crc16(&frame[1], len-1);
+	frame[len++] = crc & 0xFF;
+	frame[len++] = (crc >> 8) & 0xFF;
+	frameLength = len;
+	return true;
+}
+
 bool CortexController::cmdMOVETO(JointAngles angle_rad, int duration_ms) {
 	if (!microControllerPresent("cmdMOVETO"))
 		return false;
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::MOVETO_CMD);
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::MOVETO_CMD);
+
+	string cmd;
+	uint8_t frame[3+FRAME_MOVETO_PAYLOAD_LENGTH+2];
+	int frameLength = 0;
+	string responseStr;
+	if (composeMOVETO(angle_rad, duration_ms, cmd, frame, frameLength))
+		ok = callMicroControllerBinary(frame, frameLength, cmd, responseStr, comm->expectedExecutionTime_ms);
+	else
+		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
+	return ok;
+}
+
+// compose CHUNK of the first queued samples as text command and as binary frame. The text command
+// is valid for one sample only, with more samples it is used for logging. Returns true, if the binary frame is to be used
+bool CortexController::composeCHUNK(int samples, string& cmd, uint8_t frame[], int& frameLength) {
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::CHUNK_CMD);
 
-		cmd.append(comm->name);
+	cmd = comm->name;
+	bool fitsIntoFrame = true;
+	for (int s = 0;s<samples;s++) {
 		for (int i = 0;i<7;i++) {
 			cmd.append(" ");
-			rational angle_deg = degrees(angle_rad[i]);
+			rational angle_deg = degrees(queuedSamples[s].angles[i]);
 			string angleStr = string_format("%.2f",angle_deg);
 			cmd.append(angleStr);
+			fitsIntoFrame = fitsIntoFrame && (fabs(angle_deg)*FRAME_ANGLE_SCALE < 32767);
 		}
 		cmd.append(" ");
-		cmd.append(std::to_string(duration_ms));
+		cmd.append(std::to_string(queuedSamples[s].duration_ms));
+	}
+
+	if (!withBinaryFrames || !fitsIntoFrame)
+		return false;
 
+	// <sync> <length> <cmd> <samples> (<7 x int16 angle> <uint16 duration>)* <crc16>
+	int len = 0;
+	frame[len++] = FRAME_SYNC_BYTE;
+	frame[len++] = 2+samples*FRAME_CHUNK_SAMPLE_LENGTH;
+	frame[len++] = CommDefType::CHUNK_CMD;
+	frame[len++] = samples;
+	for (int s = 0;s<samples;s++) {
+		for (int i = 0;i<7;i++) {
+			int16_t angle = (int16_t)roundl(degrees(queuedSamples[s].angles[i])*FRAME_ANGLE_SCALE);
+			frame[len++] = angle & 0xFF;
+			frame[len++] = (angle >> 8) & 0xFF;
+		}
+		int duration_ms = queuedSamples[s].duration_ms;
+		frame[len++] = duration_ms & 0xFF;
+		frame[len++] = (duration_ms >> 8) & 0xFF;
+	}
+	uint16_t crc = crc16(&frame[1], len-1);
+	frame[len++] = crc & 0xFF;
+	frame[len++] = (crc >> 8) & 0xFF;
+	frameLength = len;
+	return true;
+}
+
+// send the first queued samples as one CHUNK without waiting for the reply. Like MOVETO,
+// a failed CHUNK is not repeated, the reply of the next one corrects the timing.
+bool CortexController::cmdCHUNKAsync(int samples) {
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::CHUNK_CMD);
+	string cmd;
+	uint8_t frame[3+FRAME_MAX_LENGTH+2];
+	int frameLength = 0;
+	bool useFrame = composeCHUNK(samples, cmd, frame, frameLength);
+	if (!useFrame && (samples > 1)) {
+		// text command carries one sample only
+		samples = 1;
+		useFrame = composeCHUNK(samples, cmd, frame, frameLength);
+	}
+	queuedSamples.erase(queuedSamples.begin(), queuedSamples.begin()+samples);
+
+	CommandDispatcher::getInstance().addCmdLine(cmd);
+	CortexCompletion completion = [this, cmd](const CortexReply& reply) {
 		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
-	return ok;
+		if (processReply(cmd, reply, responseStr, false)) {
+			// reply is "fill=<samples> ahead=<ms>"
+			size_t aheadIdx = responseStr.find("ahead=");
+			if (aheadIdx != string::npos) {
+				cortexQueueAhead_ms = atoi(responseStr.substr(aheadIdx+6).c_str());
+				cortexQueueReported = true;
+			}
+		}
+	};
+	if (useFrame)
+		channel.sendFrame(frame, frameLength, comm->expectedExecutionTime_ms, completion);
+	else
+		channel.send(cmd, comm->expectedExecutionTime_ms, completion);
+	return true;
 }
 
-bool CortexController::retry(bool replyOk) {
-	if ((!replyOk) && (communicationFailureCounter>=3))
-		LOG(ERROR) << "3.th failed retry. quitting";
+// send queued samples as long as the channel takes commands without blocking. Samples
+// that came in while the channel was busy are collected into one chunk
+void CortexController::sendQueuedSamples() {
+	while (!queuedSamples.empty() && (channel.pendingCommands() < CORTEX_COMMAND_WINDOW)) {
+		int samples = min((int)queuedSamples.size(), withBinaryFrames?FRAME_CHUNK_MAX_SAMPLES:1);
+		cmdCHUNKAsync(samples);
+	}
+}
 
-	return ((!replyOk) && (communicationFailureCounter>0) && (communicationFailureCounter<5));
+void CortexController::resetQueue() {
+	queuedSamples.clear();
+	cortexQueueAhead_ms = 0;
+	cortexQueueReported = false;
 }
 
 bool CortexController::cmdSTEP(int actuatorID, rational incr_rad) {
@@ -270,19 +413,17 @@ bool CortexController::cmdSTEP(int actuatorID, rational incr_rad) {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::STEP_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::STEP_CMD);
 
-		cmd.append(comm->name);
-		cmd.append(" ");
-		cmd.append(std::to_string(actuatorID));
-		cmd.append(" ");
-		cmd.append(to_string(degrees(incr_rad),2));
+	cmd.append(comm->name);
+	cmd.append(" ");
+	cmd.append(std::to_string(actuatorID));
+	cmd.append(" ");
+	cmd.append(to_string(degrees(incr_rad),2));
 
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 	return ok;
 }
 
@@ -291,20 +432,83 @@ bool CortexController::cmdSET(int ActuatorNo, rational minAngle, rational maxAng
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::SET_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::SET_CMD);
 
-		cmd.append(comm->name);
-		cmd.append(" ");
-		cmd.append(to_string(degrees(minAngle),2));
-		cmd.append(" ");
-		cmd.append(to_string(degrees(maxAngle),2));
-		cmd.append(" ");
-		cmd.append(to_string(degrees(nullAngle),2));
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	cmd.append(comm->name);
+	cmd.append(" ");
+	cmd.append(std::to_string(ActuatorNo));
+	cmd.append(" min=");
+	cmd.append(to_string(degrees(minAngle),2));
+	cmd.append(" max=");
+	cmd.append(to_string(degrees(maxAngle),2));
+	cmd.append(" null=");
+	cmd.append(to_string(degrees(nullAngle),2));
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
+	return ok;
+}
+
+void CortexController::composeSTATUS(uint8_t frame[], int& frameLength) {
+	int len = 0;
+	frame[len++] = FRAME_SYNC_BYTE;
+	frame[len++] = 1;
+	frame[len++] = CommDefType::STATUS_CMD;
+	uint16_t crc = crc16(&frame[1], len-1);
+	frame[len++] = crc & 0xFF;
+	frame[len++] = (crc >> 8) & 0xFF;
+	frameLength = len;
+}
+
+// decode the frame of a STATUS reply, returns false if it is corrupted
+bool CortexController::decodeSTATUS(const string& replyFrame, ActuatorStateType actuatorState[]) {
+	const uint8_t* frame = (const uint8_t*)replyFrame.data();
+	if ((replyFrame.length() != 3+FRAME_STATUS_PAYLOAD_LENGTH+2) ||
+		(frame[1] != 1+FRAME_STATUS_PAYLOAD_LENGTH) ||
+		(frame[2] != CommDefType::STATUS_CMD)) {
+		LOG(ERROR) << "status frame invalid";
+		return false;
+	}
+	uint16_t crc = frame[3+FRAME_STATUS_PAYLOAD_LENGTH] | (frame[3+FRAME_STATUS_PAYLOAD_LENGTH+1] << 8);
+	if (crc != crc16(&frame[1], 2+FRAME_STATUS_PAYLOAD_LENGTH)) {
+		LOG(ERROR) << "status frame checksum wrong";
+		return false;
+	}
+
+	for (int i = 0;i<NumberOfActuators;i++) {
+		const uint8_t* p = &frame[3+i*FRAME_STATUS_ACTUATOR_LENGTH];
+		int16_t value[5];
+		for (int j = 0;j<5;j++)
+			value[j] = (int16_t)(p[j*2] | (p[j*2+1] << 8));
+		uint8_t flags = p[10];
+
+		actuatorState[i].currentAngle = radians((rational)value[0]/FRAME_ANGLE_SCALE);
+		actuatorState[i].minAngle = radians((rational)value[1]/FRAME_ANGLE_SCALE);
+		actuatorState[i].maxAngle = radians((rational)value[2]/FRAME_ANGLE_SCALE);
+		actuatorState[i].nullAngle = radians((rational)value[3]/FRAME_ANGLE_SCALE);
+		actuatorState[i].torque = value[4];
+		actuatorState[i].healthy = (flags & FRAME_STATUS_OK);
+		actuatorState[i].enabled = (flags & FRAME_STATUS_ENABLED);
+	}
+	return true;
+}
+
+// fetch the state of all actuators with one binary frame
+bool CortexController::cmdSTATUS(ActuatorStateType actuatorState[]) {
+	if (!microControllerPresent("cmdSTATUS"))
+		return false;
+
+	bool ok = false;
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::STATUS_CMD);
+	uint8_t frame[3+2];
+	int frameLength = 0;
+	composeSTATUS(frame, frameLength);
+
+	string responseStr;
+	string replyFrame;
+	ok = callMicroControllerBinary(frame, frameLength, comm->name, responseStr, comm->expectedExecutionTime_ms, &replyFrame);
+	if (ok)
+		ok = decodeSTATUS(replyFrame, actuatorState);
 	return ok;
 }
 
@@ -312,16 +516,18 @@ bool CortexController::cmdGETall(ActuatorStateType actuatorState[]) {
 	if (!microControllerPresent("cmdGETall"))
 		return false;
 
+	// binary STATUS carries the same and more, and does not need to be parsed
+	if (withBinaryFrames)
+		return cmdSTATUS(actuatorState);
+
 	bool ok = false;
 	string responseStr;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::GET_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::GET_CMD);
 
-		cmd.append(comm->name);
-		cmd.append(" all");
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	cmd.append(comm->name);
+	cmd.append(" all");
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 
 	std::istringstream is(responseStr);
 	string token;
@@ -355,7 +561,9 @@ bool CortexController::cmdGETall(ActuatorStateType actuatorState[]) {
 		actuatorState[i].minAngle = radians(minAngle);
 		actuatorState[i].maxAngle = radians(maxAngle);
 		actuatorState[i].nullAngle = radians(nullAngle);
-
+		actuatorState[i].torque = 0;
+		actuatorState[i].healthy = true;
+		actuatorState[i].enabled = enabled;
 	}
 	return ok;
 
@@ -367,17 +575,15 @@ bool CortexController::cmdGET(int actuatorNo, ActuatorStateType actuatorState) {
 
 	bool ok = false;
 	string reponseStr;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::GET_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::GET_CMD);
 
-		cmd.append(comm->name);
-		cmd.append(" ");
-		cmd.append(std::to_string(actuatorNo));
+	cmd.append(comm->name);
+	cmd.append(" ");
+	cmd.append(std::to_string(actuatorNo));
 
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 
 	// format: 	ang=1.0 min=1.0 max=1.0 null=1.0
 	std::istringstream is(reponseStr);
@@ -405,38 +611,34 @@ bool CortexController::cmdLOGsetup(bool onOff) {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
 
-		cmd.append(comm->name);
-		if (onOff)
-			cmd.append(" setup on");
-		else
-			cmd.append(" setup off");
+	cmd.append(comm->name);
+	if (onOff)
+		cmd.append(" setup on");
+	else
+		cmd.append(" setup off");
 
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 
 	return ok;
 }
 
 bool CortexController::cmdLOGtest(bool onOff) {
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
 
-		cmd.append(comm->name);
-		if (onOff)
-			cmd.append(" test on");
-		else
-			cmd.append(" test off");
+	cmd.append(comm->name);
+	if (onOff)
+		cmd.append(" test on");
+	else
+		cmd.append(" test off");
 
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 
 	return ok;
 }
@@ -446,16 +648,14 @@ bool CortexController::cmdLOGservos(bool onOff) {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
 
-		cmd.append(comm->name);
-		cmd.append(onOff?" servo on":" servo off");
+	cmd.append(comm->name);
+	cmd.append(onOff?" servo on":" servo off");
 
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 	return ok;
 }
 
@@ -464,16 +664,14 @@ bool CortexController::cmdLOGstepper(bool onOff) {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
 
-		cmd.append(comm->name);
-		cmd.append(onOff?" stepper on":" stepper off");
+	cmd.append(comm->name);
+	cmd.append(onOff?" stepper on":" stepper off");
 
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 	return ok;
 }
 bool CortexController::cmdLOGencoder(bool onOff) {
@@ -481,15 +679,29 @@ bool CortexController::cmdLOGencoder(bool onOff) {
 		return false;
 
 	bool ok = false;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
 
-		cmd.append(comm->name);
-		cmd.append(onOff?" encoder on":" encoder off");
-		string responseStr;
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	cmd.append(comm->name);
+	cmd.append(onOff?" encoder on":" encoder off");
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
+
+	return ok;
+}
+
+bool CortexController::cmdLOGprofile(bool onOff) {
+	if (!microControllerPresent("cmdLOGprofile"))
+		return false;
+
+	bool ok = false;
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::LOG_CMD);
+
+	cmd.append(comm->name);
+	cmd.append(onOff?" profile on":" profile off");
+	string responseStr;
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 
 	return ok;
 }
@@ -500,14 +712,12 @@ bool CortexController::cmdINFO(bool &powered, bool& setuped, bool &enabled) {
 
 	bool ok = false;
 	string responseStr;
-	do {
-		string cmd = "";
-		CommDefType* comm = CommDefType::get(CommDefType::CommandType::INFO_CMD);
+	string cmd = "";
+	CommDefType* comm = CommDefType::get(CommDefType::CommandType::INFO_CMD);
 
-		cmd.append(comm->name);
+	cmd.append(comm->name);
 
-		ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
-	} while (retry(ok));
+	ok = callMicroController(cmd, responseStr, comm->expectedExecutionTime_ms);
 
 	LOG(INFO) << "cmdINFO:" << responseStr;
 
@@ -523,15 +733,20 @@ void CortexController::logFetcher() {
 	string str;
 
 	while (true) {
-		int bytesRead = serialLog.receive(str);
+		int bytesRead = serialLog.receive(str, CORTEX_READER_WAKEUP_TIME);
 		if (bytesRead > 0) {
 
 			currentLine.append(str);
+
+			// telemetry frames are interleaved with the log lines, take them out first
+			size_t textEnd = Telemetry::getInstance().extractFrames(currentLine);
+
 			// log full lines only
 			int endOfLineIdx = currentLine.find("\r", 0);
-			if (endOfLineIdx > 0) {
+			while ((endOfLineIdx > 0) && ((size_t)endOfLineIdx < textEnd)) {
 				string line = currentLine.substr(0,endOfLineIdx);
 				currentLine = currentLine.substr(endOfLineIdx+1);
+				textEnd -= endOfLineIdx+1;
 
 				if (line[0] == '\r')
 					line = line.substr(1);
@@ -543,14 +758,18 @@ void CortexController::logFetcher() {
  				if (logMCToConsole)
 					cout << "log>" << line << endl;
 
+				// profile lines are kept for the http API, but are logged as well
+				Telemetry::getInstance().extractProfile(line);
+
  				// push log message to cmd dispatcher
  				CommandDispatcher::getInstance().addLogLine(line);
 
  				LOG(TRACE) << line;
 				logSuckingThreadState = 1; // a log line has been detected, state success!
+
+				endOfLineIdx = currentLine.find("\r", 0);
 			}
-		} else
-			delay(1);
+		}
 	}
 }
 
@@ -568,6 +787,8 @@ bool CortexController::setupCommunication() {
 	}
 
 	// now start command interface
+	channel.stop();
+	resetQueue();
 	serialCmd.disconnect();
 	ok = serialCmd.connect(CORTEX_COMMAND_SERIAL_PORT , CORTEX_COMMAND_BAUD_RATE);
 	if (!ok) {
@@ -576,18 +797,25 @@ bool CortexController::setupCommunication() {
 
 		return false;
 	}
+	channel.start();
 
 	// start log fetching thread
 	if (logSuckingThread == NULL)
 		logSuckingThread = new std::thread(&CortexController::logFetcher, this);
 	delay(1);
 
-	 ok = cmdLOGtest(true); // writes a log entry
+	withBinaryFrames = false;
+	channel.useSequenceNumbers(false);
+	ok = cmdLOGtest(true); // writes a log entry
 	if (!ok) {
 		if (getLastError() == CHECKSUM_EXPECTED) {
 			// try with checksum, uC must have been started earlier with checksum set
-			withChecksum= true;
+			channel.useChecksum(true);
 			ok = cmdLOGtest(true);
+			if (!ok && (getLastError() == CHECKSUM_EXPECTED)) {
+				channel.useChecksum(true, true);
+				ok = cmdLOGtest(true);
+			}
 		}
 	}
 	if (!ok) {
@@ -613,8 +841,13 @@ bool CortexController::setupCommunication() {
 		return false;
 	}
 
-	// switch checksum on
-	ok = cmdCHECKSUM(true);
+	// switch checksum on, crc16 if the cortex knows it already
+	ok = cmdCHECKSUM(true, true);
+	if (!ok) {
+		LOG(WARNING) << "cortex does not support crc, using checksum";
+		resetError();
+		ok = cmdCHECKSUM(true);
+	}
 	if (!ok) {
 		LOG(ERROR) << "switching on checksum to uC failed";
 		return false;
@@ -629,6 +862,19 @@ bool CortexController::setupCommunication() {
 		return false;
 	}
 
+	// number commands to repeat them without being executed twice if a reply gets lost
+	if (!cmdSEQ(true)) {
+		LOG(WARNING) << "cortex does not support sequence numbers, resynchronizing by timeouts";
+		resetError();
+	}
+
+	// MOVETO is sent as binary frame if the cortex supports it, otherwise stay with text protocol
+	withBinaryFrames = false;
+	if (!cmdBINARY(true)) {
+		LOG(WARNING) << "cortex does not support binary frames, using text protocol";
+		resetError();
+	}
+
 	if (logSuckingThreadState != 1) {
 		LOG(ERROR) << "logging interface could not be established";
 		return false;
@@ -645,47 +891,6 @@ bool CortexController::communicationOk() {
 	return (microControllerOk && (communicationFailureCounter < 5));
 }
 
-// reponse code of uC is >ok or >nok(error). Parse this, return true if ok or nok has been parsed,
-// extract the remaining payload (plainReponse) and return a flag weather ok or nok has been parsed
-bool CortexController::checkReponseCode(string &s, string &plainReponse, bool &OkOrNOk) {
-	resetError();
-
-	OkOrNOk = false; // are we able to read ok or nok ?
-	int startOkSearchIdx = s.length()-reponseOKStr.length();
-	if ((startOkSearchIdx >= 0) && (s.compare(startOkSearchIdx, reponseOKStr.length(), reponseOKStr) == 0)) {
-		plainReponse = s.substr(0,s.length()-reponseOKStr.length());
-		OkOrNOk = true;
-		return true;
-	}
-
-	int start = s.length()-reponseNOKStr.length()-5;
-	if (start < 0)
-		start = 0;
-	int errorcodeIdx = s.find(reponseNOKStr,start);
-	if (errorcodeIdx >= 0) {
-		OkOrNOk = false;
-		int errorcodeEndIdx = s.find(")",errorcodeIdx+1);
-		if (errorcodeEndIdx <= errorcodeIdx)
-			errorcodeEndIdx = errorcodeIdx;
-		string errorStr = s.substr(errorcodeIdx+reponseNOKStr.length(),errorcodeEndIdx-errorcodeIdx-reponseNOKStr.length());
-		int code = atoi(errorStr.c_str());
-		setError((ErrorCodeType)code);
-		plainReponse = s.substr(0,errorcodeIdx);
-		return true;
-	}
-	return false;
-}
-
-void CortexController::computeChecksum(string s,uint8_t& hash) {
-	int c;
-
-	int i = 0;
-	while ((c = s[i++])) {
-		if (c != ' ')
-			hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
-	}
-}
-
 void CortexController::setLEDState(LEDState state) {
 	if (state != ledState)
 		ledStatePending = true;
@@ -752,6 +957,39 @@ bool CortexController::move(JointAngles angle_rad, int duration_ms) {
 	return cmdMOVETO(angle_rad, min(9999,duration_ms));
 }
 
+bool CortexController::queueAsync(JointAngles angle_rad, int duration_ms) {
+	if (!microControllerPresent("cmdCHUNK"))
+		return false;
+
+	// correct the duration to keep the cortex' queue CortexQueueLeadTime ahead. Do this once per reply only,
+	// and by half of the deviation, since the reported queue state does not contain the samples sent afterwards
+	if (cortexQueueReported) {
+		int correction = ((int)CortexQueueLeadTime - cortexQueueAhead_ms)/2;
+		duration_ms += constrain(correction, -duration_ms/2, duration_ms);
+		cortexQueueReported = false;
+	}
+	duration_ms = constrain(duration_ms, 1, 9999);
+
+	// if the cortex does not reply, do not pile up samples that are outdated anyway
+	if ((int)queuedSamples.size() >= MOVEMENT_QUEUE_SIZE) {
+		LOG(WARNING) << "cortex queue stalled, dropping sample";
+		queuedSamples.pop_front();
+	}
+
+	QueueSample sample;
+	sample.angles = angle_rad;
+	sample.duration_ms = duration_ms;
+	queuedSamples.push_back(sample);
+
+	sendQueuedSamples();
+	return true;
+}
+
+void CortexController::processReplies() {
+	channel.processReplies();
+	sendQueuedSamples();
+}
+
 void CortexController::directAccess(string cmd, string& response, bool &okOrNOk) {
 	okOrNOk = callMicroController(cmd, response, 5000);
 }
@@ -767,20 +1005,6 @@ void CortexController::loop() {
 	}
 }
 
-void CortexController::sendString(string str) {
-	uint8_t checksum = 0;
-	computeChecksum(str, checksum);
-
-	if (withChecksum) {
-		// add checksum to string
-		str +=" chk=";
-		str += std::to_string(checksum); // ITOS(checksum);
-	}
-
-	serialCmd.sendString(str);
-}
-
-
 bool CortexController::callMicroController(string& cmd, string& response, int timeout_ms) {
 	resetError();
 
@@ -793,80 +1017,58 @@ bool CortexController::callMicroController(string& cmd, string& response, int ti
 			break;
 		}
 	}
-	sendString(cmd);
-	delay(5);
-	bool ok = receive(response, timeout_ms-5);
-	replace (response.begin(), response.end(), '\r' , ' ');
-	// replace (response.begin(), response.end(), '\n' , 'N');
-
-	if (ok) {
-		CommandDispatcher::getInstance().addCmdLine(response);
-		CommandDispatcher::getInstance().updateHeartbeat();
-	}
-	else {
-		if (getLastError() != ABSOLUTELY_NO_ERROR)
-			CommandDispatcher::getInstance().addCmdLine(getLastErrorMessage());
-		else
-			CommandDispatcher::getInstance().addCmdLine("unknown error");
-	}
-	LOG(DEBUG) << "send -> \"" << cmd << " timeout=" << timeout_ms << "-> \"" << response << "\" ok=" << string(ok?"true":"false") << " (" << getLastError() << ")";
-	return ok;
+	CortexReply reply = channel.call(cmd, timeout_ms);
+	return processReply(cmd, reply, response, true);
 }
 
+// send a binary frame, cmdDescription is the same command in text protocol and used for logging only.
+// If replyFrame is passed, it returns the binary frame the reply starts with
+bool CortexController::callMicroControllerBinary(uint8_t frame[], int frameLength, const string& cmdDescription, string& response, int timeout_ms, string* replyFrame) {
+	resetError();
 
-bool CortexController::receive(string& str, int timeout_ms) {
-
-	string response="";
-	string reponsePayload="";
-	unsigned long startTime = millis();
-	int bytesRead;
-	bool replyIsOk = false; // does not necessarily mean that the answer is "ok", we only received a reply which we can read
-	bool okOrNOK = false;
+	CommandDispatcher::getInstance().addCmdLine(cmdDescription);
+	CortexReply reply = channel.callFrame(frame, frameLength, timeout_ms);
+	if (replyFrame != NULL)
+		*replyFrame = reply.frame;
+	return processReply(cmdDescription, reply, response, true);
+}
 
-	// read from serial until "ok" or "nok" has been read or timeout occurs
-	int retryCount= 3;// check at least three times to receive an response with a certain delay in between
-	string rawResponse ="";
-	bool isTimeout = false;
-	do {
-		bytesRead = serialCmd.receive(rawResponse);
-		if (bytesRead > 0) {
-			response += rawResponse;
-			replyIsOk = checkReponseCode(response, reponsePayload,okOrNOK);
-		} else
-			delay(1); // enough to transfer 64 byte
-		retryCount--;
-		isTimeout = (millis() - startTime > (unsigned long)timeout_ms);
-	}
-	while (((retryCount > 0) || !isTimeout) && (!replyIsOk));
+// log the reply and keep track of communication failures. If reportError is set, the error
+// of the reply is set as last error, which is not done for asynchronous commands
+bool CortexController::processReply(const string& cmd, const CortexReply& reply, string& response, bool reportError) {
+	response = reply.payload;
+	replace (response.begin(), response.end(), '\r' , ' ');
 
+	if (!reply.okOrNOk && reportError)
+		setError(reply.error);
 
-	if (replyIsOk) {
+	if (reply.error == CORTEX_NO_RESPONSE) {
+		LOG(WARNING) << "no response to \"" << cmd << "\"";
+		communicationFailureCounter++;
+	}
+	else {
 		communicationFailureCounter = 0; // communication was ok, reset any previous failure
-		str = reponsePayload;
-		if (okOrNOK) {
+		if (reply.okOrNOk) {
 			LOG(DEBUG) << "response \""
-				<< replaceWhiteSpace(reponsePayload)
-				<< "\" & " << (okOrNOK?"OK(":"NOK(") << getLastError() <<  ")";
+				<< replaceWhiteSpace(response)
+				<< "\" & OK(" << reply.error <<  ")";
 		} else {
 			LOG(WARNING) << "response \""
-				<< replaceWhiteSpace(reponsePayload)
-				<< "\" & " << (okOrNOK?"OK(":"NOK(") << getLastError() <<  ")";
+				<< replaceWhiteSpace(response)
+				<< "\" & NOK(" << reply.error <<  ")";
 		}
-	} else {
-		if (isTimeout) {
-			LOG(WARNING) << "no response";
-			setError(CORTEX_NO_RESPONSE);
-			okOrNOK = false;
-		} else {
-			str = "";
-			LOG(WARNING) << "response-error \"" << replaceWhiteSpace(response) << "|" << replaceWhiteSpace(reponsePayload) << "\" not parsed";
-		}
-		// communication received no parsable string, reset any remains in serial buffer
-		serialCmd.clear();
-		delay(10);
-		serialCmd.clear();
-		communicationFailureCounter++;
 	}
 
-	return okOrNOK;
+	if (reply.okOrNOk) {
+		CommandDispatcher::getInstance().addCmdLine(response);
+		CommandDispatcher::getInstance().updateHeartbeat();
+	}
+	else {
+		if (reply.error != ABSOLUTELY_NO_ERROR)
+			CommandDispatcher::getInstance().addCmdLine(getErrorMessage(reply.error));
+		else
+			CommandDispatcher::getInstance().addCmdLine("unknown error");
+	}
+	LOG(DEBUG) << "send -> \"" << cmd << "-> \"" << response << "\" ok=" << string(reply.okOrNOk?"true":"false") << " (" << reply.error << ")";
+	return reply.okOrNOk;
 }
@@ -9,12 +9,14 @@
 #define MICROCONTROLLERINTERFACE_H_
 
 #include <thread>
+#include <deque>
 #include "string.h"
 
 #include "setup.h"
 #include "Util.h"
 #include "spatial.h"
 #include "SerialPort.h"
+#include "CortexChannel.h"
 
 
 using namespace std;
@@ -26,12 +28,12 @@ public:
 	enum LEDState { LED_ON, LED_OFF, LED_BLINKS };
 
 
-	CortexController() {
+	CortexController() : channel(serialCmd) {
 		powerOn = false;
 		ledState = LED_OFF;
 		ledStatePending = true;
 		logSuckingThread= NULL;
-		withChecksum = false;
+		withBinaryFrames = false;
 		logMCToConsole = false;
 		communicationFailureCounter = 0;
 		setup = false;
@@ -77,6 +79,17 @@ public:
 	// requires setupBot and power(true) upfront
 	bool move(JointAngles angle_rad, int duration_ms);
 
+	// append a trajectory sample to the cortex' movement queue. Samples are sent as chunks without waiting
+	// for the reply and played one after the other, so jitter of the caller does not show up in the movement.
+	// The duration is adapted to keep the queue CortexQueueLeadTime ahead.
+	bool queueAsync(JointAngles angle_rad, int duration_ms);
+
+	// number of samples passed to queueAsync that have not yet been sent to the cortex
+	int getUnsentSamples() { return queuedSamples.size(); };
+
+	// process replies of commands sent by queueAsync. Call as often as possible
+	void processReplies();
+
 	void loop();
 
 	bool isCortexCommunicationOk() { return microControllerOk; };
@@ -85,24 +98,30 @@ public:
 private:
 
 
-	bool retry(bool replyOk);
-
 	bool callMicroController(string& cmd, string& response, int timeout_ms);
-	bool receive(string& str, int timeout_ms);
-	bool checkReponseCode(string &s, string& plainResponse, bool &OkOrNOk);
-
-	void sendString(string str);
+	bool callMicroControllerBinary(uint8_t frame[], int frameLength, const string& cmdDescription, string& response, int timeout_ms, string* replyFrame = NULL);
+	bool processReply(const string& cmd, const CortexReply& reply, string& response, bool reportError);
 
 	bool cmdLED(LEDState state);
 	bool cmdECHO(string s);
-	bool cmdCHECKSUM(bool onOff);
+	bool cmdCHECKSUM(bool onOff, bool crc = false);
+	bool cmdBINARY(bool onOff);
+	bool cmdSEQ(bool onOff);
 	bool cmdPOWER(bool onOff);
 	bool cmdSETUP();
 	bool cmdDISABLE();
 	bool cmdENABLE();
 	bool cmdMOVETO(JointAngles angle, int duration_ms);
+	bool composeMOVETO(JointAngles angle_rad, int duration_ms, string& cmd, uint8_t frame[], int& frameLength);
+	bool cmdCHUNKAsync(int samples);
+	bool composeCHUNK(int samples, string& cmd, uint8_t frame[], int& frameLength);
+	void sendQueuedSamples();
+	void resetQueue();
 	bool cmdGET(int actuatorNo, ActuatorStateType actuatorState);
 	bool cmdGETall(ActuatorStateType actuatorState[]);
+	bool cmdSTATUS(ActuatorStateType actuatorState[]);
+	void composeSTATUS(uint8_t frame[], int& frameLength);
+	bool decodeSTATUS(const string& replyFrame, ActuatorStateType actuatorState[]);
 
 	bool cmdSET(int ActuatorNo, rational minAngle, rational maxAngle, rational nullAngle);
 	bool cmdSTEP(int actuatorID, rational incr);
@@ -113,16 +132,17 @@ private:
 	bool cmdLOGservos(bool onOff);
 	bool cmdLOGstepper(bool onOff);
 	bool cmdLOGencoder(bool onOff);
+	bool cmdLOGprofile(bool onOff);
 	bool cmdLOGtest(bool onOff);
 
 	bool cmdINFO(bool &powered, bool& setuped, bool &enabled);
 
-	void computeChecksum(string s,uint8_t& hash);
 	void logFetcher();
 	bool microControllerPresent(string cmd);
 
 
 	SerialPort serialCmd; 			// serial port to transfer commands
+	CortexChannel channel;			// pipelined commands and replies via serialCmd
 	SerialPort serialLog; 			// serial port to suck log output from uC
 
 	LEDState ledState;	 			// current state of LED (not necessarily transfered)
@@ -133,8 +153,16 @@ private:
 	std::thread* logSuckingThread = NULL;	// thread that sucks in all uC logs and merges into our log
 	int logSuckingThreadState;		// status of logging thread
 
+	struct QueueSample {
+		JointAngles angles;
+		int duration_ms;
+	};
+	std::deque<QueueSample> queuedSamples;	// samples not yet sent to the cortex
+	int cortexQueueAhead_ms = 0;			// time until the cortex' queue runs dry, as of the latest CHUNK reply
+	bool cortexQueueReported = false;		// true, if a CHUNK reply came in since the last duration correction
+
 	ActuatorStateType currActState[NumberOfActuators];
-	bool withChecksum;
+	bool withBinaryFrames;			// true, if MOVETO is sent as binary frame
 	bool logMCToConsole = false;
 	bool microControllerOk = false;
 	int communicationFailureCounter = 0;
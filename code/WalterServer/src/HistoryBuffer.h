@@ -0,0 +1,64 @@
+/*
+ * HistoryBuffer.h
+ *
+ * Bounded ring buffer of log, command and alert lines shown in the server view.
+ * Every line gets an increasing sequence id, the slot of a line is its id modulo the capacity,
+ * so the lines since a given id are found without searching. Oldest lines are overwritten.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef HISTORYBUFFER_H_
+#define HISTORYBUFFER_H_
+
+#include <string>
+
+struct HistoryEntry {
+	int id;
+	std::string time;
+	std::string trajectory;		// name of the trajectory node a command belongs to, empty otherwise
+	std::string line;
+};
+
+template<int Size>
+class HistoryBuffer {
+public:
+	HistoryBuffer() {
+		nextId = 0;
+	}
+
+	// add a line and return its id
+	int add(const std::string& time, const std::string& trajectory, const std::string& line) {
+		HistoryEntry& entry = buffer[nextId % Size];
+		entry.id = nextId;
+		entry.time = time;
+		entry.trajectory = trajectory;
+		entry.line = line;
+		return nextId++;
+	}
+
+	// id of the oldest line still available
+	int firstId() const {
+		return (nextId > Size)?nextId-Size:0;
+	}
+
+	// id the next line will get, i.e. number of lines added so far
+	int endId() const {
+		return nextId;
+	}
+
+	bool has(int id) const {
+		return (id >= firstId()) && (id < nextId);
+	}
+
+	// returns the line with the passed id, check with has() before
+	const HistoryEntry& get(int id) const {
+		return buffer[id % Size];
+	}
+
+private:
+	HistoryEntry buffer[Size];
+	int nextId;
+};
+
+#endif /* HISTORYBUFFER_H_ */
@@ -0,0 +1,143 @@
+/*
+ * LockFreeQueue.h
+ *
+ * Bounded queues to pass data between threads without locking.
+ * LockFreeQueue is single-producer/single-consumer and passes requests and responses
+ * between the http thread and the trajectory execution thread. Exactly one thread may call push,
+ * exactly one other thread may call pop.
+ * LockFreeMPSCQueue is multi-producer/single-consumer and collects log lines from
+ * arbitrary threads. Any thread may call push, exactly one thread may call pop.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef LOCKFREEQUEUE_H_
+#define LOCKFREEQUEUE_H_
+
+#include <atomic>
+#include <utility>
+
+template<class T, unsigned Size>
+class LockFreeQueue {
+public:
+	LockFreeQueue() {
+		head = 0;
+		tail = 0;
+	}
+
+	// add an element, returns false if queue is full. Called by producer thread only
+	bool push(T&& element) {
+		unsigned currentTail = tail.load(std::memory_order_relaxed);
+		unsigned nextTail = increment(currentTail);
+		if (nextTail == head.load(std::memory_order_acquire))
+			return false;
+
+		buffer[currentTail] = std::move(element);
+		tail.store(nextTail, std::memory_order_release);
+		return true;
+	}
+
+	bool push(const T& element) {
+		T copy = element;
+		return push(std::move(copy));
+	}
+
+	// take the oldest element, returns false if queue is empty. Called by consumer thread only
+	bool pop(T& element) {
+		unsigned currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead == tail.load(std::memory_order_acquire))
+			return false;
+
+		element = std::move(buffer[currentHead]);
+		head.store(increment(currentHead), std::memory_order_release);
+		return true;
+	}
+
+	// snapshot only, might be outdated when the other thread is active
+	bool isEmpty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+private:
+	// one slot is kept free to distinguish full from empty
+	static const unsigned Capacity = Size+1;
+
+	unsigned increment(unsigned idx) const {
+		return (idx+1) % Capacity;
+	}
+
+	T buffer[Capacity];
+	std::atomic<unsigned> head;
+	std::atomic<unsigned> tail;
+};
+
+// Every slot carries a sequence number telling whether it is free for the producer
+// of a certain round or filled for the consumer. Producers reserve a slot by advancing tail via CAS,
+// so a producer never waits for another one; push fails only if the queue is full.
+// Size needs to be a power of 2 to let the free-running counters wrap around consistently.
+template<class T, unsigned Size>
+class LockFreeMPSCQueue {
+public:
+	LockFreeMPSCQueue() {
+		static_assert((Size >= 2) && ((Size & (Size-1)) == 0), "size of LockFreeMPSCQueue must be a power of 2");
+		for (unsigned i = 0;i<Size;i++)
+			slot[i].sequence.store(i, std::memory_order_relaxed);
+		head = 0;
+		tail = 0;
+	}
+
+	// add an element, returns false if queue is full. Thread-safe, can be called by any thread
+	bool push(T&& element) {
+		unsigned pos = tail.load(std::memory_order_relaxed);
+		Slot* s;
+		while (true) {
+			s = &slot[pos & Mask];
+			unsigned seq = s->sequence.load(std::memory_order_acquire);
+			int diff = (int)seq - (int)pos;
+			if (diff == 0) {
+				// slot is free, try to reserve it
+				if (tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+					break;
+			} else
+				if (diff < 0)
+					return false; // slot not yet consumed, queue is full
+				else
+					pos = tail.load(std::memory_order_relaxed); // another producer has been faster
+		}
+		s->data = std::move(element);
+		s->sequence.store(pos+1, std::memory_order_release);
+		return true;
+	}
+
+	bool push(const T& element) {
+		T copy = element;
+		return push(std::move(copy));
+	}
+
+	// take the oldest element, returns false if queue is empty. Called by consumer thread only
+	bool pop(T& element) {
+		Slot& s = slot[head & Mask];
+		unsigned seq = s.sequence.load(std::memory_order_acquire);
+		if ((int)seq - (int)(head+1) < 0)
+			return false; // empty, or producer has not finished writing the slot yet
+
+		element = std::move(s.data);
+		s.sequence.store(head+Size, std::memory_order_release);
+		head++;
+		return true;
+	}
+
+private:
+	static const unsigned Mask = Size-1;
+
+	struct Slot {
+		std::atomic<unsigned> sequence;
+		T data;
+	};
+
+	Slot slot[Size];
+	unsigned head;					// touched by consumer only
+	std::atomic<unsigned> tail;
+};
+
+#endif /* LOCKFREEQUEUE_H_ */
@@ -43,6 +43,13 @@
 #include <termios.h>
 #include <fcntl.h>
 #include <dirent.h>
+#include <sys/ioctl.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <linux/serial.h>
+#else
+#include <poll.h>
+#endif
 
 #define __USE_SVID // For strdup
 #include <stdlib.h>
@@ -67,6 +74,7 @@
 typedef struct {
     char * port;
     int handle;
+    int epollHandle;    // epoll instance waiting for input on handle, -1 if not open
 } COMDevice;
 
 #define COM_MAXDEVICES        64
@@ -159,18 +167,60 @@ int comOpen(int index, int baudrate)
     cfsetospeed(&config, flag);
     cfsetispeed(&config, flag);
 // Timeouts configuration
-    config.c_cc[VTIME] = 1;
+// Port is opened with O_NDELAY, so read returns immediately and VMIN/VTIME do not apply.
+// Waiting for input is done by comReadTimeout instead
+    config.c_cc[VTIME] = 0;
     config.c_cc[VMIN]  = 0;
-    //fcntl(handle, F_SETFL, FNDELAY);
 // Validate configuration
     if (tcsetattr(handle, TCSANOW, &config) < 0) {
         close(handle);
         return 0;
     }
+#if defined(__linux__)
+    int epollHandle = epoll_create1(0);
+    if (epollHandle >= 0) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = handle;
+        if (epoll_ctl(epollHandle, EPOLL_CTL_ADD, handle, &event) < 0) {
+            close(epollHandle);
+            epollHandle = -1;
+        }
+    }
+    if (epollHandle < 0) {
+        close(handle);
+        return 0;
+    }
+    com->epollHandle = epollHandle;
+#endif
     com->handle = handle;
     return 1;
 }
 
+int comSetLowLatency(int index, int onOff)
+{
+    if (index >= noDevices || index < 0)
+        return 0;
+    if (comDevices[index].handle <= 0)
+        return 0;
+#if defined(__linux__)
+// Without low latency, USB serial drivers like FTDI collect input up to 16ms before passing it on
+    struct serial_struct serial;
+    if (ioctl(comDevices[index].handle, TIOCGSERIAL, &serial) < 0)
+        return 0;
+    if (onOff)
+        serial.flags |= ASYNC_LOW_LATENCY;
+    else
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+    if (ioctl(comDevices[index].handle, TIOCSSERIAL, &serial) < 0)
+        return 0;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
 void comClose(int index)
 {
     if (index >= noDevices || index < 0)
@@ -179,6 +229,10 @@ void comClose(int index)
     if (com->handle < 0) 
         return;
     tcdrain(com->handle);
+    if (com->epollHandle >= 0) {
+        close(com->epollHandle);
+        com->epollHandle = -1;
+    }
     close(com->handle);
     com->handle = -1;
 }
@@ -214,6 +268,36 @@ int comRead(int index, char * buffer, size_t len)
     return res;
 }
 
+int comReadTimeout(int index, char * buffer, size_t len, int timeout)
+{
+    if (index >= noDevices || index < 0)
+        return 0;
+    COMDevice * com = &comDevices[index];
+    if (com->handle <= 0)
+        return 0;
+// Sleep until input arrives or timeout passed, no polling
+#if defined(__linux__)
+    struct epoll_event event;
+    int res = epoll_wait(com->epollHandle, &event, 1, timeout);
+#else
+    struct pollfd event;
+    event.fd = com->handle;
+    event.events = POLLIN;
+    int res = poll(&event, 1, timeout);
+#endif
+    if (res <= 0)
+        return 0;
+    res = comRead(index, buffer, len);
+// Device has gone, do not spin on the permanent hangup event
+#if defined(__linux__)
+    if ((res == 0) && (event.events & (EPOLLHUP | EPOLLERR)))
+#else
+    if ((res == 0) && (event.revents & (POLLHUP | POLLERR)))
+#endif
+        usleep(timeout * 1000);
+    return res;
+}
+
 /*****************************************************************************/
 int _BaudFlag(int BaudRate)
 {
@@ -252,6 +336,7 @@ void _AppendDevices(const char * base)
                 COMDevice * com = &comDevices[noDevices ++];
                 com->port = (char *) strdup(dp->d_name);
                 com->handle = -1;
+                com->epollHandle = -1;
             }
         }
     }
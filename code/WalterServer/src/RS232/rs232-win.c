@@ -279,6 +279,32 @@ int comRead(int index, char * buffer, size_t len)
     return bytes;
 }
 
+int comReadTimeout(int index, char * buffer, size_t len, int timeout)
+{
+    if (index < 0 || index >= noDevices)
+        return 0;
+    COMMTIMEOUTS timeouts;
+    COMDevice * com = &comDevices[index];
+    uint32_t bytes = 0;
+// Return as soon as one byte is received, but wait at most timeout
+    GetCommTimeouts(com->handle, &timeouts);
+    timeouts.ReadIntervalTimeout = MAX_DWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAX_DWORD;
+    timeouts.ReadTotalTimeoutConstant = timeout;
+    SetCommTimeouts(com->handle, &timeouts);
+    ReadFile(com->handle, buffer, len, &bytes, NULL);
+// Back to non-blocking reads
+    timeouts.ReadTotalTimeoutMultiplier = 0;
+    timeouts.ReadTotalTimeoutConstant = 0;
+    SetCommTimeouts(com->handle, &timeouts);
+    return bytes;
+}
+
+int comSetLowLatency(int index, int onOff)
+{
+    return 0;
+}
+
 /*****************************************************************************/
 const char * findPattern(const char * string, const char * pattern, int * value)
 {
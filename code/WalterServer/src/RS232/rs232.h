@@ -148,6 +148,27 @@ extern "C" {
      */                
     int comRead(int index, char * buffer, size_t len);
 
+    /**
+     * \fn int comReadTimeout(int index, char * buffer, size_t len, int timeout)
+     * \brief Read data from the port, wait until data is available (blocking with timeout)
+     * \param[in] index port index
+     * \param[in] buffer pointer to receive buffer
+     * \param[in] len length of receive buffer in bytes
+     * \param[in] timeout max time to wait for data in milliseconds
+     * \return number of bytes transferred, 0 if timeout passed
+     */
+    int comReadTimeout(int index, char * buffer, size_t len, int timeout);
+
+    /**
+     * \fn int comSetLowLatency(int index, int onOff)
+     * \brief Pass received data to the application immediately instead of
+     * \brief collecting it in the driver (Linux only, ASYNC_LOW_LATENCY)
+     * \param[in] index port index
+     * \param[in] onOff 1 to switch on, 0 to switch off
+     * \return 1 if set, 0 if not supported by the driver
+     */
+    int comSetLowLatency(int index, int onOff);
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,6 +36,9 @@ bool SerialPort::connect( string device, int baudRate) {
 		LOG(ERROR) << "port " << device << " found, but connection failed";
 		return false;
 	}
+	// pass bytes immediately instead of collecting them in the USB serial driver
+	if (!comSetLowLatency(_port, 1))
+		LOG(DEBUG) << "port " << device << " does not support low latency";
 	return ok;
 }
 
@@ -52,8 +55,12 @@ int SerialPort::sendArray(char *buffer, int len) {
 	return bytesWritten ;
 }
 
-int SerialPort::getArray (char *buffer, int len) {
-	int bytesRead= comRead(_port, buffer,len);
+int SerialPort::getArray (char *buffer, int len, int timeout_ms) {
+	int bytesRead;
+	if (timeout_ms > 0)
+		bytesRead = comReadTimeout(_port, buffer, len, timeout_ms);
+	else
+		bytesRead = comRead(_port, buffer,len);
 	return bytesRead;
 }
 
@@ -64,7 +71,7 @@ int SerialPort::sendString(string str) {
 }
 
 
-int SerialPort::receive(string& str) {
+int SerialPort::receive(string& str, int timeout_ms) {
 	str = "";
 	int totalBytesRead = 0;
 	int bytesRead= 0;
@@ -72,7 +79,8 @@ int SerialPort::receive(string& str) {
 	char buffer[BufferSize];
 
 	do {
-		bytesRead= getArray(buffer, BufferSize);
+		// wait for the first bytes only
+		bytesRead= getArray(buffer, BufferSize, (totalBytesRead == 0)?timeout_ms:0);
 		if (bytesRead > 0) {
 			totalBytesRead += bytesRead;
 			str += string(buffer, bytesRead);
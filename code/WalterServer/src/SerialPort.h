@@ -25,12 +25,13 @@ public:
 	bool connect (string device, int baudRate);
 	void disconnect(void);
 	int sendString(string str);
-	int receive(string& str);
+	int sendArray(char *buffer, int len);
+	// returns what has been received so far. If nothing is there, waits at most timeout_ms for data
+	int receive(string& str, int timeout_ms = 0);
 
 	void clear();
 private:
-	int sendArray(char *buffer, int len);
-	int getArray (char *buffer, int len);
+	int getArray (char *buffer, int len, int timeout_ms);
 
 	int _port;
 };
@@ -0,0 +1,149 @@
+/*
+ * Telemetry.cpp
+ *
+ * Author: JochenAlt
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include "CommDef.h"
+#include "Telemetry.h"
+#include "Util.h"
+#include "logger.h"
+
+Telemetry telemetry;
+
+Telemetry::Telemetry() {
+	droppedSamples = 0;
+	nextId = 0;
+	for (int i = 0;i<NumberOfProfileSections;i++)
+		profileReceived[i] = false;
+}
+
+Telemetry& Telemetry::getInstance() {
+	return telemetry;
+}
+
+bool Telemetry::decodeFrame(const string& frameStr, TelemetrySample& sample) {
+	const uint8_t* frame = (const uint8_t*)frameStr.data();
+	uint16_t crc = frame[3+FRAME_TELEMETRY_PAYLOAD_LENGTH] | (frame[3+FRAME_TELEMETRY_PAYLOAD_LENGTH+1] << 8);
+	if (crc != crc16(&frame[1], 2+FRAME_TELEMETRY_PAYLOAD_LENGTH))
+		return false;
+
+	const uint8_t* p = &frame[3];
+	sample.cortexTime = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	p += 4;
+	for (int i = 0;i<NumberOfActuators;i++) {
+		TelemetryJoint& joint = sample.joint[i];
+		joint.setpoint = (float)(int16_t)(p[0] | (p[1] << 8))/FRAME_ANGLE_SCALE;
+		joint.measured = (float)(int16_t)(p[2] | (p[3] << 8))/FRAME_ANGLE_SCALE;
+		memcpy(&joint.integral, &p[4], 4);
+		memcpy(&joint.speed, &p[8], 4);
+		joint.torque = (int16_t)(p[12] | (p[13] << 8));
+		p += FRAME_TELEMETRY_JOINT_LENGTH;
+	}
+	return true;
+}
+
+size_t Telemetry::extractFrames(string& received) {
+	// log lines are plain ASCII, so the sync byte can only be the start of a frame
+	size_t frameIdx = received.find((char)FRAME_SYNC_BYTE);
+	while (frameIdx != string::npos) {
+		if (frameIdx+2 > received.length())
+			return frameIdx; // length not yet received
+
+		int frameLength = 2 + (uint8_t)received[frameIdx+1] + 2; // length counts command id and payload
+		if ((frameLength != 3+FRAME_TELEMETRY_PAYLOAD_LENGTH+2) ||
+			((frameIdx+2 < received.length()) && ((uint8_t)received[frameIdx+2] != CommDefType::TELEMETRY_CMD))) {
+			// no telemetry frame, drop the sync byte and resync with the next one
+			received.erase(frameIdx, 1);
+			droppedSamples++;
+		} else {
+			if (frameIdx+frameLength > received.length())
+				return frameIdx; // frame not yet complete
+
+			TelemetrySample sample;
+			if (!decodeFrame(received.substr(frameIdx, frameLength), sample) || !sampleQueue.push(sample))
+				droppedSamples++;
+			received.erase(frameIdx, frameLength);
+		}
+		frameIdx = received.find((char)FRAME_SYNC_BYTE, frameIdx);
+	}
+	return received.length();
+}
+
+void Telemetry::fetchSamples() {
+	TelemetrySample sample;
+	while (sampleQueue.pop(sample)) {
+		// oldest samples are overwritten once the buffer is full
+		sample.id = nextId;
+		samples[nextId % TELEMETRY_MAXSIZE] = sample;
+		nextId++;
+	}
+
+	int dropped = droppedSamples.exchange(0);
+	if (dropped > 0)
+		LOG(WARNING) << dropped << " telemetry samples dropped";
+}
+
+string Telemetry::getSamplesJson(int fromId) {
+	fetchSamples();
+
+	string result = "[";
+	int firstId = (nextId > TELEMETRY_MAXSIZE)?nextId-TELEMETRY_MAXSIZE:0;
+	int startId = std::max(fromId, firstId);
+	for (int id = startId;id<nextId;id++) {
+		const TelemetrySample& sample = samples[id % TELEMETRY_MAXSIZE];
+		if (id > startId)
+			result += ",";
+		result += "{\"id\":" + int_to_string(sample.id) + ",\"time\":" + int_to_string(sample.cortexTime) + ",\"joints\":[";
+		for (int i = 0;i<NumberOfActuators;i++) {
+			const TelemetryJoint& joint = sample.joint[i];
+			if (i > 0)
+				result += ",";
+			result += string_format("[%.2f,%.2f,%.2f,%.1f,%.0f]", joint.setpoint, joint.measured, joint.integral, joint.speed, joint.torque);
+		}
+		result += "]}";
+	}
+	result += "]";
+	return result;
+}
+
+bool Telemetry::extractProfile(const string& line) {
+	ProfileRecord record;
+	if (!parseProfileLine(line.c_str(), record))
+		return false;
+	if (!profileQueue.push(record))
+		LOG(WARNING) << "profile line dropped";
+	return true;
+}
+
+string Telemetry::getProfileJson() {
+	ProfileRecord record;
+	while (profileQueue.pop(record)) {
+		profile[record.section] = record;
+		profileReceived[record.section] = true;
+	}
+
+	string result = "[";
+	bool first = true;
+	for (int i = 0;i<NumberOfProfileSections;i++) {
+		if (!profileReceived[i])
+			continue;
+		const ProfileRecord& p = profile[i];
+		if (!first)
+			result += ",";
+		first = false;
+		result += string("{\"section\":\"") + profileSectionName[i] + "\",\"n\":" + int_to_string(p.count) +
+				  string_format(",\"min\":%.1f,\"avg\":%.1f,\"max\":%.1f,\"hist\":[", p.min_us, p.avg_us, p.max_us);
+		for (int b = 0;b<PROFILE_HISTOGRAM_BINS;b++) {
+			if (b > 0)
+				result += ",";
+			result += int_to_string(p.histogram[b]);
+		}
+		result += "]}";
+	}
+	result += "]";
+	return result;
+}
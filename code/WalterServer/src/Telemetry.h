@@ -0,0 +1,74 @@
+/*
+ * Telemetry.h
+ *
+ * Time series of telemetry samples the cortex emits on its log port (switched on via TELEMETRY <period>).
+ * The log thread takes the binary frames out of the log stream and hands the decoded samples over
+ * to the trajectory execution thread, which keeps the latest TELEMETRY_MAXSIZE samples for the http API.
+ * Same with the profile lines of the cortex' loop (switched on via LOG profile on), of which the latest
+ * report is kept.
+ *
+ * Author: JochenAlt
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <string>
+#include <atomic>
+
+#include "setup.h"
+#include "CommDef.h"
+#include "LockFreeQueue.h"
+
+using namespace std;
+
+struct TelemetryJoint {
+	float setpoint;			// [degree] to-be angle of the interpolated trajectory
+	float measured;			// [degree] angle measured by encoder or servo
+	float integral;			// integral part of the stepper's PI controller
+	float speed;			// [steps/s] stepper speed
+	float torque;			// servo torque, proportional to PWM
+};
+
+struct TelemetrySample {
+	int id;
+	uint32_t cortexTime;	// [ms] time of the cortex when the sample has been taken
+	TelemetryJoint joint[NumberOfActuators];
+};
+
+class Telemetry {
+public:
+	Telemetry();
+	static Telemetry& getInstance();
+
+	// called by log thread only. Decodes and removes all complete telemetry frames out of the received data.
+	// Returns the length of the text in front of an incomplete frame, i.e. the text that can be split into lines
+	size_t extractFrames(string& received);
+
+	// called by trajectory execution thread only. Moves decoded samples into the time series
+	void fetchSamples();
+
+	// called by trajectory execution thread only. Returns all samples starting with fromId as json array
+	string getSamplesJson(int fromId);
+
+	// called by log thread only. Returns true if the line is a profile line, which is handed over then
+	bool extractProfile(const string& line);
+
+	// called by trajectory execution thread only. Returns the latest profile of each section as json array
+	string getProfileJson();
+
+private:
+	bool decodeFrame(const string& frame, TelemetrySample& sample);
+
+	LockFreeQueue<TelemetrySample, 64> sampleQueue;		// log thread -> execution thread
+	std::atomic<int> droppedSamples;					// samples lost due to a full queue or a corrupted frame
+
+	TelemetrySample samples[TELEMETRY_MAXSIZE];			// the slot of a sample is its id modulo the capacity
+	int nextId;
+
+	LockFreeQueue<ProfileRecord, 32> profileQueue;		// log thread -> execution thread
+	ProfileRecord profile[NumberOfProfileSections];
+	bool profileReceived[NumberOfProfileSections];
+};
+
+#endif /* TELEMETRY_H_ */
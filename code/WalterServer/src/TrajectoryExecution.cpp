@@ -74,9 +74,15 @@ bool TrajectoryExecution::setAnglesAsString(string anglesAsString) {
 }
 
 void TrajectoryExecution::loop() {
+	// process replies of cortex commands sent asynchronously
+	CortexController::getInstance().processReplies();
+
 	// take current time, compute IK and store pose and angles every TrajectorySampleRate.
 	// When a new pose is computed, notifyNewPose is called
 	TrajectoryPlayer::loop();
+
+	// push the node that has been held back due to the stream's rate
+	CommandDispatcher::getInstance().streamPendingNode();
 }
 
 
@@ -95,8 +101,9 @@ void TrajectoryExecution::notifyNewPose(const Pose& pPose) {
 			lastLoopInvocation += getSampleRate();
 
 		if (CortexController::getInstance().communicationOk()){
-			int duration = getSampleRate()*200/100; // add 10% in case of timing issues
-			bool ok = CortexController::getInstance().move(pPose.angles, duration);
+			// stream the pose into the cortex' movement queue, which plays it after the previous one.
+			// Do not wait for the reply, trajectory continues while cortex is working
+			bool ok = CortexController::getInstance().queueAsync(pPose.angles, getSampleRate());
 			heartbeatSend = ok;
 		} else
 			heartbeatSend = false; // no heartbeat when communication is down
@@ -104,6 +111,9 @@ void TrajectoryExecution::notifyNewPose(const Pose& pPose) {
 
 	// set the trajectory name for logging
 	CommandDispatcher::getInstance().setOneTimeTrajectoryNodeName (getCurrentTrajectoryNode().getText());
+
+	// push the new node to websocket clients
+	CommandDispatcher::getInstance().streamTrajectoryNode(getCurrentTrajectoryNode());
 }
 
 // return true if a heart beat has been sent. Works only once, if a heart beat has been given,
@@ -10,6 +10,7 @@
 
 #include "core.h"
 #include "CmdDispatcher.h"
+#include "Telemetry.h"
 #include "Util.h"
 #include "setup.h"
 
@@ -17,9 +18,16 @@
 INITIALIZE_EASYLOGGINGPP
 
 static struct mg_serve_http_opts s_http_server_opts;
+static uint32_t requestCounter = 0;
 
 #include <stdlib.h>
 #include <ctype.h>
+#include <thread>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#endif
 
 
 // called when ^C is pressed
@@ -56,6 +64,20 @@ void setupLogger() {
 }
 
 
+// send the response of a dispatched API call
+static void sendResponse(struct mg_connection *nc, bool ok, const string& response) {
+	if (ok) {
+		mg_printf(nc, "HTTP/1.1 200 OK\r\n"
+			"Content-Type: text/plain\r\n"
+			"Content-Length: %d\r\n\r\n%s",
+				(int) response.length(), response.c_str());
+	} else {
+		mg_printf(nc, "HTTP/1.1 500 Server Error\r\n"
+				"Content-Length: %d\r\n\r\n%s",
+				(int) response.length(), response.c_str());
+	}
+}
+
 // Define an event handler function
 static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
 {
@@ -65,35 +87,153 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
     			struct http_message *hm = (struct http_message *) ev_data;
     			string uri(hm->uri.p, hm->uri.len);
     			string query(hm->query_string.p, hm->query_string.len);
-    	        string body(hm->body.p, hm->body.len);
-
-    	        bool ok;
-    			string response;
-    			// if our dispatcher knows the command, it creates a response and returns true.
-    			// Otherwise assume that we deliver static content.
-    			bool processed = CommandDispatcher::getInstance().dispatch(uri, query, body, response, ok);
-    			if (processed) {
-    				if (ok) {
-    					mg_printf(nc, "HTTP/1.1 200 OK\r\n"
-    						"Content-Type: text/plain\r\n"
-    						"Content-Length: %d\r\n\r\n%s",
-    							(int) response.length(), response.c_str());
-    				} else {
-    					mg_printf(nc, "HTTP/1.1 500 Server Error\r\n"
-    							"Content-Length: %d\r\n\r\n%s",
-    							(int) response.length(), response.c_str());
-    				}
+
+    			// API calls are executed by the trajectory execution thread, since they might talk to the cortex.
+    			// The reply is sent when the response comes back. Otherwise assume that we deliver static content.
+    			if (CommandDispatcher::getInstance().isAPIRequest(uri, query)) {
+    				DispatchRequest request;
+    				request.connection = nc;
+    				request.requestId = ++requestCounter;
+    				request.uri = uri;
+    				request.query = query;
+    				request.body = string(hm->body.p, hm->body.len);
+    				nc->user_data = (void*)(intptr_t)request.requestId;
+    				if (!CommandDispatcher::getInstance().queueRequest(request))
+    					sendResponse(nc, false, "too many pending requests");
     			} else {
     				// no API call, serve static content
     				mg_serve_http(nc, (http_message*) ev_data, s_http_server_opts);
     			}
     		break;
     	}
+    	case MG_EV_WEBSOCKET_HANDSHAKE_DONE:
+    		// websocket clients (ws://<host>/stream) get all stream events pushed
+    		CommandDispatcher::getInstance().addStreamSubscriber();
+    		break;
+    	case MG_EV_CLOSE:
+    		if (nc->flags & MG_F_IS_WEBSOCKET)
+    			CommandDispatcher::getInstance().removeStreamSubscriber();
+    		break;
     default:
         break;
     }
 }
 
+// The execution thread wakes up mg_mgr_poll by writing a byte into a socket pair whose other end
+// is polled by the http thread. Unlike mg_broadcast, writing does not wait for the http thread.
+static sock_t wakeupSocket[2] = { INVALID_SOCKET, INVALID_SOCKET };
+
+static void setupWakeup(struct mg_mgr *mgr, mg_event_handler_t handler) {
+	if (!mg_socketpair(wakeupSocket, SOCK_STREAM)) {
+		LOG(ERROR) << "cannot create wakeup socket pair, responses wait for the poll timeout";
+		return;
+	}
+#ifdef _WIN32
+	unsigned long nonBlocking = 1;
+	ioctlsocket(wakeupSocket[0], FIONBIO, &nonBlocking);
+#else
+	fcntl(wakeupSocket[0], F_SETFL, fcntl(wakeupSocket[0], F_GETFL, 0) | O_NONBLOCK);
+#endif
+	mg_add_sock(mgr, wakeupSocket[1], handler);
+}
+
+// called by the execution thread. If the socket's buffer is full, the http thread is woken up already
+static void wakeupHttpThread() {
+	if (wakeupSocket[0] != INVALID_SOCKET)
+		send(wakeupSocket[0], "w", 1, 0);
+}
+
+// called in the http thread when woken up, the bytes carry no information
+static void wakeup_handler(struct mg_connection *nc, int ev, void *) {
+	if (ev == MG_EV_RECV)
+		mbuf_remove(&nc->recv_mbuf, nc->recv_mbuf.len);
+}
+
+// send all responses the trajectory execution thread computed meanwhile.
+// The connection might have been closed in the meantime, so check that it is still there
+static void sendPendingResponses(struct mg_mgr *mgr) {
+	DispatchResponse response;
+	while (CommandDispatcher::getInstance().fetchResponse(response)) {
+		for (struct mg_connection* c = mg_next(mgr, NULL); c != NULL; c = mg_next(mgr, c)) {
+			if ((c == response.connection) && (c->user_data == (void*)(intptr_t)response.requestId)) {
+				if (response.processed)
+					sendResponse(c, response.okOrNOk, response.response);
+				else
+					mg_printf(c, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+				c->user_data = NULL;
+				break;
+			}
+		}
+	}
+}
+
+// send all stream events of the trajectory execution thread to all websocket clients
+static void sendPendingStreamEvents(struct mg_mgr *mgr) {
+	string event;
+	while (CommandDispatcher::getInstance().fetchStreamEvent(event)) {
+		for (struct mg_connection* c = mg_next(mgr, NULL); c != NULL; c = mg_next(mgr, c)) {
+			if (c->flags & MG_F_IS_WEBSOCKET)
+				mg_send_websocket_frame(c, WEBSOCKET_OP_TEXT, event.c_str(), event.length());
+		}
+	}
+}
+
+// give the trajectory execution thread its own core and the highest priority we are allowed to have
+static void setupExecutionThread(std::thread& thread) {
+#ifndef _WIN32
+	int cores = std::thread::hardware_concurrency();
+	if (cores > 1) {
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(cores-1, &cpuset); // last core is one of the big ones on Odroid XU4
+		if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset) != 0)
+			LOG(WARNING) << "pinning execution thread to core " << cores-1 << " failed";
+		else
+			LOG(INFO) << "execution thread runs on core " << cores-1;
+	}
+
+	struct sched_param param;
+	param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+	if (pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param) != 0)
+		LOG(WARNING) << "execution thread runs without real time priority";
+#endif
+}
+
+// trajectory execution thread. Runs the trajectory and is the only one talking to the cortex.
+static void executionLoop() {
+	// initialize communication to cortex
+	bool cortexOk = false;
+
+	int lastTimeCortexSetup = millis();
+	while (true) {
+		if (cortexOk)
+			TrajectoryExecution::getInstance().loop();
+		else {
+			if (millis()> lastTimeCortexSetup+1000 ) {
+				cortexOk = TrajectoryExecution::getInstance().setup(CortexSampleRate);
+				lastTimeCortexSetup = millis();
+				if (cortexOk) {
+					LOG(INFO) << "Cortex initialized successfully";
+				} else {
+					string error = getLastErrorMessage();
+					LOG(ERROR) << "Communication with cortex failed (" << error.c_str();
+					CommandDispatcher::getInstance().addAlert("communication with Walters cortex failed");
+				}
+			}
+		}
+
+		// take over log lines collected by the cortex log thread
+		CommandDispatcher::getInstance().fetchLogLines();
+		Telemetry::getInstance().fetchSamples();
+
+		// process one request per loop only, trajectory has priority
+		if (CommandDispatcher::getInstance().processQueuedRequest())
+			wakeupHttpThread(); // http thread sends the response
+		else
+			delay(1);
+	}
+}
+
 
 int main(void) {
 	struct mg_mgr mgr;
@@ -136,30 +276,17 @@ int main(void) {
 	// initialize kinematics and trajectory compilation
 	Kinematics::getInstance().setup();
 
-	// initialize communication to cortex
-	bool cortexOk = false;
-
 	LOG(INFO) << "Walter's webserver running on port " << SERVER_PORT;
 
-	// ToDo change this loop to two threads running on different cores
-	int lastTimeCortexSetup = millis();
+	// trajectory execution runs in its own thread, this thread serves http requests only
+	setupWakeup(&mgr, wakeup_handler);
+	std::thread executionThread(executionLoop);
+	setupExecutionThread(executionThread);
+
 	while (true) {
-		if (cortexOk)
-			TrajectoryExecution::getInstance().loop();
-		else {
-			if (millis()> lastTimeCortexSetup+1000 ) {
-				cortexOk = TrajectoryExecution::getInstance().setup(CortexSampleRate);
-				lastTimeCortexSetup = millis();
-				if (cortexOk) {
-					LOG(INFO) << "Cortex initialized successfully";
-				} else {
-					string error = getLastErrorMessage();
-					LOG(ERROR) << "Communication with cortex failed (" << error.c_str();
-					CommandDispatcher::getInstance().addAlert("communication with Walters cortex failed");
-				}
-			}
-		}
-		mg_mgr_poll(&mgr, 10); // check every 10ms for incoming requests
+		mg_mgr_poll(&mgr, 10); // returns with incoming requests, a wakeup by the execution thread, or after 10ms
+		sendPendingResponses(&mgr);
+		sendPendingStreamEvents(&mgr);
 	}
 	mg_mgr_free(&mgr);
 